@@ -0,0 +1,549 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  bench/bench.c
+ *  lua-geo
+ *
+ *  standalone benchmark of the C kernels without the Lua bindings.
+ *
+ *  gcc -std=gnu99 -O2 -Isrc -o geo-bench bench/bench.c -lm
+ *  ./geo-bench [-n points] [-r rounds] [-f filter] > bench.json
+ *  ./geo-bench [-n points] -w dir
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "geohash.h"
+#include "distance.h"
+#include "quadkeys.h"
+
+
+#define BENCH_DEFAULT_POINTS    ( 1 << 20 )
+#define BENCH_DEFAULT_ROUNDS    5
+
+// points of a distribution
+typedef struct {
+    const char *name;
+    double *lat;
+    double *lon;
+    // packed lat/lon pairs for the batch kernels
+    double *pairs;
+    size_t len;
+} dataset_t;
+
+typedef struct {
+    const dataset_t *data;
+    // scratch of the benchmark
+    void *out;
+    // result of the benchmark to keep the computation alive
+    double sink;
+} bench_ctx_t;
+
+typedef void (*bench_fn_t)( bench_ctx_t *ctx );
+
+typedef struct {
+    const char *name;
+    // single call or batch kernel
+    const char *kind;
+    bench_fn_t fn;
+} bench_t;
+
+
+// xorshift64* generator to produce the same points on every run.
+static uint64_t RNG_STATE = 0x9E3779B97F4A7C15ULL;
+
+static inline double rng_next( void )
+{
+    RNG_STATE ^= RNG_STATE >> 12;
+    RNG_STATE ^= RNG_STATE << 25;
+    RNG_STATE ^= RNG_STATE >> 27;
+    return (double)( ( RNG_STATE * 0x2545F4914F6CDD1DULL ) >> 11 ) *
+           ( 1.0 / 9007199254740992.0 );
+}
+
+static inline double rng_range( double min, double max )
+{
+    return min + ( max - min ) * rng_next();
+}
+
+// standard normal distribution by the box-muller transform.
+static inline double rng_normal( void )
+{
+    double u = rng_next();
+
+    if( u < 1e-300 ){
+        u = 1e-300;
+    }
+    return sqrt( -2 * log( u ) ) * cos( GEO_PI2 * rng_next() );
+}
+
+
+// uniform on the sphere within the latitude range of the web mercator.
+static void gen_uniform( double *lat, double *lon )
+{
+    double smax = sin( LATITUDE_MAX * GEO_RAD );
+
+    *lat = asin( rng_range( -smax, smax ) ) * GEO_DEG;
+    *lon = rng_range( -180, 180 );
+}
+
+
+// urban points; the clusters of about 5km around the large cities.
+static const double CITIES[][2] = {
+    { 35.681236, 139.767125 },  // tokyo
+    { 40.712776, -74.005974 },  // new york
+    { 51.507351, -0.127758 },   // london
+    { 48.856613, 2.352222 },    // paris
+    { -23.550520, -46.633308 }, // sao paulo
+    { 19.432608, -99.133209 },  // mexico city
+    { 28.613939, 77.209023 },   // delhi
+    { 31.230391, 121.473701 },  // shanghai
+    { -33.868820, 151.209290 }, // sydney
+    { 30.044420, 31.235712 },   // cairo
+    { 55.755826, 37.617300 },   // moscow
+    { 1.352083, 103.819836 },   // singapore
+    { 37.774929, -122.419418 }, // san francisco
+    { -34.603684, -58.381559 }, // buenos aires
+    { 6.524379, 3.379206 },     // lagos
+    { 64.146582, -21.942635 }   // reykjavik
+};
+#define NCITY   ( sizeof( CITIES ) / sizeof( CITIES[0] ) )
+
+static void gen_cities( double *lat, double *lon )
+{
+    const double *c = CITIES[(size_t)( rng_next() * NCITY )];
+
+    *lat = getclip( c[0] + rng_normal() * 0.05, -90, 90 );
+    *lon = getclip( c[1] + rng_normal() * 0.05 / cos( c[0] * GEO_RAD ), -180,
+                    180 );
+}
+
+
+// band of the mid-latitudes where the most of the data are.
+static void gen_midlat( double *lat, double *lon )
+{
+    *lat = rng_range( 30, 60 );
+    *lon = rng_range( -130, 150 );
+}
+
+
+static const struct {
+    const char *name;
+    void (*gen)( double *lat, double *lon );
+} DISTRIBUTIONS[] = {
+    { "uniform", gen_uniform },
+    { "cities", gen_cities },
+    { "midlat", gen_midlat }
+};
+#define NDIST   ( sizeof( DISTRIBUTIONS ) / sizeof( DISTRIBUTIONS[0] ) )
+
+
+// MARK: geohash
+#define BENCH_HASH_PRECISION    12
+
+static void bench_geohash_encode( bench_ctx_t *ctx )
+{
+    const dataset_t *d = ctx->data;
+    char hash[GEO_MAX_HASH_LEN + 1];
+    size_t i = 0;
+
+    for(; i < d->len; i++ ){
+        geo_hash_encode( hash, d->lat[i], d->lon[i], BENCH_HASH_PRECISION );
+        ctx->sink += hash[BENCH_HASH_PRECISION - 1];
+    }
+}
+
+static void bench_geohash_decode( bench_ctx_t *ctx )
+{
+    const dataset_t *d = ctx->data;
+    const char *hash = ctx->out;
+    double lat = 0;
+    double lon = 0;
+    size_t i = 0;
+
+    for(; i < d->len; i++, hash += BENCH_HASH_PRECISION ){
+        geo_hash_decode( hash, BENCH_HASH_PRECISION, &lat, &lon );
+        ctx->sink += lat + lon;
+    }
+}
+
+static void bench_geohash_encode_int( bench_ctx_t *ctx )
+{
+    const dataset_t *d = ctx->data;
+    uint64_t code = 0;
+    size_t i = 0;
+
+    for(; i < d->len; i++ ){
+        geo_hash_encode_int( &code, d->lat[i], d->lon[i], GEO_HASH_INT_BITS );
+        ctx->sink += code & 0xff;
+    }
+}
+
+static void bench_geohash_encode_batch( bench_ctx_t *ctx )
+{
+    const dataset_t *d = ctx->data;
+    geo_coords_t coords = { d->pairs, d->pairs + 1, 2, d->len, NULL };
+
+    ctx->sink += geo_hash_encode_batch( ctx->out, &coords,
+                                        BENCH_HASH_PRECISION );
+}
+
+
+// MARK: quadkeys
+static void bench_quadkeys_encode( bench_ctx_t *ctx )
+{
+    const dataset_t *d = ctx->data;
+    char quadkey[QUADKEY_MAX_LEVEL];
+    size_t i = 0;
+
+    for(; i < d->len; i++ ){
+        int px = 0;
+        int py = 0;
+        int tx = 0;
+        int ty = 0;
+
+        latlon2pixel( d->lat[i], d->lon[i], QUADKEY_MAX_LEVEL, &px, &py );
+        pixel2tile( px, py, &tx, &ty );
+        ctx->sink += tile2quadkey( quadkey, tx, ty, QUADKEY_MAX_LEVEL );
+    }
+}
+
+static void bench_quadkeys_encode_int( bench_ctx_t *ctx )
+{
+    const dataset_t *d = ctx->data;
+    size_t i = 0;
+
+    for(; i < d->len; i++ ){
+        int px = 0;
+        int py = 0;
+        int tx = 0;
+        int ty = 0;
+
+        latlon2pixel( d->lat[i], d->lon[i], QUADKEY_MAX_LEVEL, &px, &py );
+        pixel2tile( px, py, &tx, &ty );
+        ctx->sink += tile2int( tx, ty, QUADKEY_MAX_LEVEL ) & 0xff;
+    }
+}
+
+static void bench_quadkeys_encode_batch( bench_ctx_t *ctx )
+{
+    const dataset_t *d = ctx->data;
+    uint32_t *tx = ctx->out;
+    uint32_t *ty = tx + d->len;
+    size_t i = 0;
+
+    for(; i < d->len; i += TILE_BLOCK_SIZE ){
+        size_t n = d->len - i;
+
+        if( n > TILE_BLOCK_SIZE ){
+            n = TILE_BLOCK_SIZE;
+        }
+        tilekernel( tx + i, ty + i, d->pairs + i * 2, d->pairs + i * 2 + 1, 2,
+                    n, QUADKEY_MAX_LEVEL );
+    }
+    ctx->sink += tx[d->len - 1];
+}
+
+
+// MARK: distance
+// the distance between the consecutive points like the geo.distance.
+static inline void bench_distance( bench_ctx_t *ctx,
+                                   geo_distance_model_e model )
+{
+    const dataset_t *d = ctx->data;
+    size_t i = 1;
+
+    for(; i < d->len; i++ ){
+        double to[2] = { d->lat[i], d->lon[i] };
+        geo_coords_t coords = { to, to + 1, 2, 1, NULL };
+        geo_t from;
+        double dist = 0;
+
+        geo_init( &from, d->lat[i - 1], d->lon[i - 1], 1 );
+        geo_distance_batch( &dist, &from, &coords, model );
+        // the vincenty model returns NaN for the nearly antipodal points
+        if( !isnan( dist ) ){
+            ctx->sink += dist;
+        }
+    }
+}
+
+// the distances from the first point like the geo.distance_many.
+static inline void bench_distance_many( bench_ctx_t *ctx,
+                                        geo_distance_model_e model )
+{
+    const dataset_t *d = ctx->data;
+    geo_coords_t coords = { d->pairs, d->pairs + 1, 2, d->len, NULL };
+    double *dist = ctx->out;
+    geo_t origin;
+
+    geo_init( &origin, d->lat[0], d->lon[0], 1 );
+    geo_distance_batch( dist, &origin, &coords, model );
+    if( !isnan( dist[d->len - 1] ) ){
+        ctx->sink += dist[d->len - 1];
+    }
+}
+
+#define BENCH_DISTANCE(model, MODEL) \
+static void bench_distance_##model( bench_ctx_t *ctx ) \
+{ \
+    bench_distance( ctx, GEO_DISTANCE_##MODEL ); \
+} \
+static void bench_distance_many_##model( bench_ctx_t *ctx ) \
+{ \
+    bench_distance_many( ctx, GEO_DISTANCE_##MODEL ); \
+}
+
+BENCH_DISTANCE( equirect, EQUIRECT )
+BENCH_DISTANCE( haversine, HAVERSINE )
+BENCH_DISTANCE( hubeny, HUBENY )
+BENCH_DISTANCE( vincenty, VINCENTY )
+
+#undef BENCH_DISTANCE
+
+
+static const bench_t BENCHMARKS[] = {
+    { "geohash.encode", "single", bench_geohash_encode },
+    { "geohash.decode", "single", bench_geohash_decode },
+    { "geohash.encode_int", "single", bench_geohash_encode_int },
+    { "geohash.encode_batch", "batch", bench_geohash_encode_batch },
+    { "quadkeys.encode", "single", bench_quadkeys_encode },
+    { "quadkeys.encode_int", "single", bench_quadkeys_encode_int },
+    { "quadkeys.encode_batch", "batch", bench_quadkeys_encode_batch },
+    { "distance.equirect", "single", bench_distance_equirect },
+    { "distance.haversine", "single", bench_distance_haversine },
+    { "distance.hubeny", "single", bench_distance_hubeny },
+    { "distance.vincenty", "single", bench_distance_vincenty },
+    { "distance_many.equirect", "batch", bench_distance_many_equirect },
+    { "distance_many.haversine", "batch", bench_distance_many_haversine },
+    { "distance_many.hubeny", "batch", bench_distance_many_hubeny },
+    { "distance_many.vincenty", "batch", bench_distance_many_vincenty },
+    { NULL, NULL, NULL }
+};
+
+
+static inline double now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+static int dataset_init( dataset_t *d, const char *name,
+                         void (*gen)( double *lat, double *lon ), size_t len )
+{
+    size_t i = 0;
+
+    d->name = name;
+    d->len = len;
+    d->lat = malloc( sizeof( double ) * len * 4 );
+    if( !d->lat ){
+        return -1;
+    }
+    d->lon = d->lat + len;
+    d->pairs = d->lon + len;
+    for(; i < len; i++ ){
+        gen( d->lat + i, d->lon + i );
+        d->pairs[i * 2] = d->lat[i];
+        d->pairs[i * 2 + 1] = d->lon[i];
+    }
+
+    return 0;
+}
+
+
+// writes the packed lat/lon pairs of the dataset to <dir>/<name>.points for
+// the bench/bench.lua.
+static int dataset_write( const dataset_t *d, const char *dir )
+{
+    char path[4096];
+    FILE *fp = NULL;
+    int rc = 0;
+
+    if( (size_t)snprintf( path, sizeof( path ), "%s/%s.points", dir,
+                          d->name ) >= sizeof( path ) ){
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    else if( !( fp = fopen( path, "wb" ) ) ){
+        return -1;
+    }
+    rc = fwrite( d->pairs, sizeof( double ) * 2, d->len, fp ) == d->len ?
+         0 : -1;
+    if( fclose( fp ) != 0 ){
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+static void usage( const char *prog )
+{
+    fprintf( stderr,
+             "usage: %s [-n points] [-r rounds] [-f filter] [-w dir]\n"
+             "  -n  number of points of each distribution (default: %d)\n"
+             "  -r  number of rounds; the best round is reported "
+             "(default: %d)\n"
+             "  -f  run only the benchmarks whose name contains the filter\n"
+             "  -w  write the points of each distribution to "
+             "<dir>/<name>.points\n"
+             "      for the bench/bench.lua, and exit\n",
+             prog, BENCH_DEFAULT_POINTS, BENCH_DEFAULT_ROUNDS );
+}
+
+
+int main( int argc, char *argv[] )
+{
+    size_t len = BENCH_DEFAULT_POINTS;
+    int rounds = BENCH_DEFAULT_ROUNDS;
+    const char *filter = NULL;
+    const char *dir = NULL;
+    dataset_t data[NDIST];
+    void *out = NULL;
+    int first = 1;
+    size_t i = 0;
+    int opt = 0;
+
+    while( ( opt = getopt( argc, argv, "n:r:f:w:h" ) ) != -1 )
+    {
+        switch( opt ){
+            case 'n':
+                len = strtoul( optarg, NULL, 10 );
+            break;
+            case 'r':
+                rounds = atoi( optarg );
+            break;
+            case 'f':
+                filter = optarg;
+            break;
+            case 'w':
+                dir = optarg;
+            break;
+            default:
+                usage( argv[0] );
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if( len < 2 || rounds < 1 ){
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    geo_hash_kernel_init();
+    geo_distance_kernel_init();
+    tilekernel_init();
+
+    // scratch for the largest output; hashes, tiles or distances
+    out = malloc( len * ( BENCH_HASH_PRECISION > 8 ?
+                          BENCH_HASH_PRECISION : 8 ) + 1 );
+    if( !out ){
+        perror( "malloc" );
+        return EXIT_FAILURE;
+    }
+    for(; i < NDIST; i++ ){
+        if( dataset_init( data + i, DISTRIBUTIONS[i].name,
+                          DISTRIBUTIONS[i].gen, len ) != 0 ){
+            perror( "malloc" );
+            return EXIT_FAILURE;
+        }
+        else if( dir && dataset_write( data + i, dir ) != 0 ){
+            perror( "dataset_write" );
+            return EXIT_FAILURE;
+        }
+    }
+    if( dir ){
+        return EXIT_SUCCESS;
+    }
+
+    printf( "{\n"
+            "  \"driver\": \"c\",\n"
+            "  \"points\": %zu,\n"
+            "  \"rounds\": %d,\n"
+            "  \"kernels\": { \"geohash\": \"%s\", \"quadkeys\": \"%s\", "
+            "\"distance\": \"%s\" },\n"
+            "  \"results\": [",
+            len, rounds, geo_hash_kernel_name, tilekernel_name,
+            geo_distance_kernel_name );
+
+    for( i = 0; BENCHMARKS[i].name; i++ )
+    {
+        const bench_t *b = BENCHMARKS + i;
+        size_t j = 0;
+
+        if( filter && !strstr( b->name, filter ) ){
+            continue;
+        }
+        for(; j < NDIST; j++ )
+        {
+            bench_ctx_t ctx = { data + j, out, 0 };
+            double best = HUGE_VAL;
+            double checksum = 0;
+            double ns = 0;
+            int r = 0;
+
+            // the decoder reads the hashes of the points
+            if( b->fn == bench_geohash_decode ){
+                geo_coords_t coords = {
+                    data[j].pairs, data[j].pairs + 1, 2, len, NULL
+                };
+                geo_hash_encode_batch( out, &coords, BENCH_HASH_PRECISION );
+            }
+            // warm up the caches and the branch predictors, and take the
+            // checksum of the outputs to detect the change of the results
+            b->fn( &ctx );
+            checksum = ctx.sink;
+            for(; r < rounds; r++ ){
+                double t = now();
+
+                b->fn( &ctx );
+                t = now() - t;
+                if( t < best ){
+                    best = t;
+                }
+            }
+
+            ns = best * 1e9 / (double)len;
+            printf( "%s\n    { \"name\": \"%s\", \"kind\": \"%s\", "
+                    "\"distribution\": \"%s\", \"ns_per_op\": %.3f, "
+                    "\"mpoints_per_sec\": %.3f, \"checksum\": %.17g }",
+                    first ? "" : ",", b->name, b->kind, data[j].name, ns,
+                    1e3 / ns, checksum );
+            fprintf( stderr, "%-24s %-7s %-8s %10.3f ns/op %10.3f Mpts/s\n",
+                     b->name, b->kind, data[j].name, ns, 1e3 / ns );
+            first = 0;
+        }
+    }
+    printf( "\n  ]\n}\n" );
+
+    for( i = 0; i < NDIST; i++ ){
+        free( data[i].lat );
+    }
+    free( out );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+--
+-- benchmark of the Lua bindings.
+-- it reads the points that written by the bench/bench.c, so the difference of
+-- the results of both drivers is the overhead of the bindings.
+--
+--  ./geo-bench -n 262144 -w bench-points
+--  lua bench/bench.lua bench-points [rounds [filter]] > bench.json
+--
+local geo = require('geo');
+local geohash = require('geo.geohash');
+local quadkeys = require('geo.quadkeys');
+local args = arg or {};
+local DIR = args[1] or '.';
+local NROUNDS = tonumber( args[2] ) or 5;
+local FILTER = args[3];
+local PRECISION = 12;
+local LEVEL = 23;
+local MODELS = { 'equirect', 'haversine', 'hubeny', 'vincenty' };
+local DISTRIBUTIONS = { 'uniform', 'cities', 'midlat' };
+local NPOINTS;
+
+
+-- reads the packed lat/lon pairs of the distribution
+local function dataset( name )
+    local path = DIR .. '/' .. name .. '.points';
+    local f = assert( io.open( path, 'rb' ) );
+    local coords = f:read( '*a' );
+    local lat, lon, hashes = {}, {}, {};
+    local buf = geo.buffer();
+
+    f:close();
+    assert( #coords > 16 and #coords % 16 == 0, path .. ': invalid points' );
+    assert( buf:append( coords ) );
+    if NPOINTS and NPOINTS ~= #buf then
+        error( path .. ': number of points differs' );
+    end
+    NPOINTS = #buf;
+    for i = 1, NPOINTS do
+        lat[i], lon[i] = buf:get( i );
+        hashes[i] = geo.encode( lat[i], lon[i], PRECISION );
+    end
+
+    return {
+        name = name,
+        lat = lat,
+        lon = lon,
+        hashes = hashes,
+        coords = coords,
+        buffer = buf,
+        packed = table.concat( hashes )
+    };
+end
+
+
+local BENCHMARKS = {
+    { 'geo.encode', 'single', function( d )
+        local encode, lat, lon = geo.encode, d.lat, d.lon;
+        for i = 1, NPOINTS do
+            encode( lat[i], lon[i], PRECISION );
+        end
+    end },
+    { 'geo.decode', 'single', function( d )
+        local decode, hashes = geo.decode, d.hashes;
+        for i = 1, NPOINTS do
+            decode( hashes[i] );
+        end
+    end },
+    { 'geohash.encode', 'single', function( d )
+        local encode, lat, lon = geohash.encode, d.lat, d.lon;
+        for i = 1, NPOINTS do
+            encode( lat[i], lon[i], PRECISION );
+        end
+    end },
+    { 'geohash.decode', 'single', function( d )
+        local decode, hashes = geohash.decode, d.hashes;
+        for i = 1, NPOINTS do
+            decode( hashes[i] );
+        end
+    end },
+    { 'geohash.encode_int', 'single', function( d )
+        local encode, lat, lon = geohash.encode_int, d.lat, d.lon;
+        for i = 1, NPOINTS do
+            encode( lat[i], lon[i] );
+        end
+    end },
+    { 'geohash.encode_batch', 'batch', function( d )
+        geohash.encode_batch( d.coords, PRECISION );
+    end },
+    { 'geohash.encode_batch.buffer', 'batch', function( d )
+        geohash.encode_batch( d.buffer, PRECISION );
+    end },
+    { 'geohash.decode_batch', 'batch', function( d )
+        geohash.decode_batch( d.packed, PRECISION );
+    end },
+    { 'quadkeys.encode', 'single', function( d )
+        local encode, lat, lon = quadkeys.encode, d.lat, d.lon;
+        for i = 1, NPOINTS do
+            encode( lat[i], lon[i], LEVEL );
+        end
+    end },
+    { 'quadkeys.encode_int', 'single', function( d )
+        local encode, lat, lon = quadkeys.encode_int, d.lat, d.lon;
+        for i = 1, NPOINTS do
+            encode( lat[i], lon[i], LEVEL );
+        end
+    end },
+    { 'quadkeys.encode_batch', 'batch', function( d )
+        quadkeys.encode_batch( d.coords, LEVEL );
+    end },
+    { 'quadkeys.encode_batch.buffer', 'batch', function( d )
+        quadkeys.encode_batch( d.buffer, LEVEL );
+    end },
+};
+
+for _, model in ipairs( MODELS ) do
+    BENCHMARKS[#BENCHMARKS + 1] = { 'distance.' .. model, 'single',
+        function( d )
+            local distance, lat, lon = geo.distance, d.lat, d.lon;
+            -- the distance between the consecutive points
+            for i = 2, NPOINTS do
+                distance( lat[i - 1], lon[i - 1], lat[i], lon[i], model );
+            end
+        end
+    };
+end
+for _, model in ipairs( MODELS ) do
+    BENCHMARKS[#BENCHMARKS + 1] = { 'distance_many.' .. model, 'batch',
+        function( d )
+            geo.distance_many( d.lat[1], d.lon[1], d.buffer, model );
+        end
+    };
+end
+
+
+local function run( fn, d )
+    local best = math.huge;
+
+    -- warm up
+    fn( d );
+    for _ = 1, NROUNDS do
+        local t;
+
+        collectgarbage('collect');
+        t = os.clock();
+        fn( d );
+        t = os.clock() - t;
+        if t < best then
+            best = t;
+        end
+    end
+
+    return best * 1e9 / NPOINTS;
+end
+
+
+local data = {};
+for i, name in ipairs( DISTRIBUTIONS ) do
+    data[i] = dataset( name );
+end
+
+local results = {};
+for _, b in ipairs( BENCHMARKS ) do
+    local name, kind, fn = b[1], b[2], b[3];
+
+    if not FILTER or name:find( FILTER, 1, true ) then
+        for _, d in ipairs( data ) do
+            local ns = run( fn, d );
+
+            results[#results + 1] = string.format(
+                '    { "name": "%s", "kind": "%s", "distribution": "%s", ' ..
+                '"ns_per_op": %.3f, "mpoints_per_sec": %.3f }',
+                name, kind, d.name, ns, 1e3 / ns
+            );
+            io.stderr:write( string.format(
+                '%-30s %-7s %-8s %10.3f ns/op %10.3f Mpts/s\n',
+                name, kind, d.name, ns, 1e3 / ns
+            ) );
+        end
+    end
+end
+
+io.write( string.format(
+    '{\n' ..
+    '  "driver": "lua",\n' ..
+    '  "version": "%s",\n' ..
+    '  "points": %d,\n' ..
+    '  "rounds": %d,\n' ..
+    '  "kernels": { "geohash": "%s", "quadkeys": "%s", "distance": "%s" },\n' ..
+    '  "results": [\n%s\n  ]\n}\n',
+    _VERSION, NPOINTS, NROUNDS, geohash.kernel, quadkeys.kernel,
+    geo.distance_kernel, table.concat( results, ',\n' )
+) );
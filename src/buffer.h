@@ -0,0 +1,208 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/buffer.h
+ *  lua-geo
+ *
+ *  growable structure of arrays of the coordinates and the identifiers.
+ */
+
+#ifndef geo_buffer_h
+#define geo_buffer_h
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "geo.h"
+
+
+// name of the metatable of the buffer userdata
+#define GEO_BUFFER_MT           "geo.buffer"
+// alignment of the arrays in bytes
+#define GEO_BUFFER_ALIGN        64
+// minimum capacity of the allocated arrays
+#define GEO_BUFFER_MIN_CAP      16
+
+typedef struct {
+    double *lat;
+    double *lon;
+    // NULL if the buffer has no identifiers
+    int64_t *ids;
+    size_t len;
+    size_t cap;
+    int with_ids;
+} geo_buffer_t;
+
+
+static inline void geo_buffer_free( geo_buffer_t *buf )
+{
+    free( buf->lat );
+    free( buf->lon );
+    free( buf->ids );
+    buf->lat = buf->lon = NULL;
+    buf->ids = NULL;
+    buf->len = buf->cap = 0;
+}
+
+
+// allocates the aligned memory of the cap elements of the size.
+static inline void *geo_buffer_alloc( size_t size, size_t cap )
+{
+    void *mem = NULL;
+    int rc = posix_memalign( &mem, GEO_BUFFER_ALIGN, size * cap );
+
+    if( rc != 0 ){
+        errno = rc;
+        return NULL;
+    }
+
+    return mem;
+}
+
+
+// grows the capacity of the buffer to at least cap elements.
+// the capacity is doubled to amortize the cost of the appends.
+static inline int geo_buffer_reserve( geo_buffer_t *buf, size_t cap )
+{
+    size_t newcap = buf->cap ? buf->cap : GEO_BUFFER_MIN_CAP;
+    double *lat = NULL;
+    double *lon = NULL;
+    int64_t *ids = NULL;
+
+    if( cap <= buf->cap ){
+        return 0;
+    }
+    while( newcap < cap ){
+        if( newcap > SIZE_MAX / 2 / sizeof( double ) ){
+            errno = ENOMEM;
+            return -1;
+        }
+        newcap *= 2;
+    }
+
+    if( !( lat = geo_buffer_alloc( sizeof( double ), newcap ) ) ||
+        !( lon = geo_buffer_alloc( sizeof( double ), newcap ) ) ||
+        ( buf->with_ids &&
+          !( ids = geo_buffer_alloc( sizeof( int64_t ), newcap ) ) ) ){
+        free( lat );
+        free( lon );
+        return -1;
+    }
+    memcpy( lat, buf->lat, sizeof( double ) * buf->len );
+    memcpy( lon, buf->lon, sizeof( double ) * buf->len );
+    free( buf->lat );
+    free( buf->lon );
+    buf->lat = lat;
+    buf->lon = lon;
+    if( ids ){
+        memcpy( ids, buf->ids, sizeof( int64_t ) * buf->len );
+        free( buf->ids );
+        buf->ids = ids;
+    }
+    buf->cap = newcap;
+
+    return 0;
+}
+
+
+// changes the number of elements. the new elements are filled with zero.
+static inline int geo_buffer_resize( geo_buffer_t *buf, size_t len )
+{
+    if( geo_buffer_reserve( buf, len ) != 0 ){
+        return -1;
+    }
+    else if( len > buf->len ){
+        size_t n = len - buf->len;
+
+        memset( buf->lat + buf->len, 0, sizeof( double ) * n );
+        memset( buf->lon + buf->len, 0, sizeof( double ) * n );
+        if( buf->ids ){
+            memset( buf->ids + buf->len, 0, sizeof( int64_t ) * n );
+        }
+    }
+    buf->len = len;
+
+    return 0;
+}
+
+
+static inline int geo_buffer_push( geo_buffer_t *buf, double lat, double lon,
+                                   int64_t id )
+{
+    if( buf->len == buf->cap &&
+        geo_buffer_reserve( buf, buf->len + 1 ) != 0 ){
+        return -1;
+    }
+    buf->lat[buf->len] = lat;
+    buf->lon[buf->len] = lon;
+    if( buf->ids ){
+        buf->ids[buf->len] = id;
+    }
+    buf->len++;
+
+    return 0;
+}
+
+
+// appends the coordinates and their identifiers.
+// the identifiers are filled with zero if the coords has no identifiers.
+static inline int geo_buffer_append( geo_buffer_t *buf,
+                                     const geo_coords_t *coords )
+{
+    geo_coords_t src = *coords;
+    // the buffer itself is moved by the reallocation
+    int self = src.lat == buf->lat;
+    size_t len = buf->len;
+    size_t i = 0;
+
+    if( geo_buffer_resize( buf, len + src.len ) != 0 ){
+        return -1;
+    }
+    else if( self ){
+        src.lat = buf->lat;
+        src.lon = buf->lon;
+        src.ids = buf->ids;
+    }
+    for(; i < src.len; i++ ){
+        buf->lat[len + i] = src.lat[i * src.stride];
+        buf->lon[len + i] = src.lon[i * src.stride];
+    }
+    if( buf->ids && src.ids ){
+        memcpy( buf->ids + len, src.ids, sizeof( int64_t ) * src.len );
+    }
+
+    return 0;
+}
+
+
+// makes the view of the coordinates of the buffer.
+static inline void geo_buffer_coords( const geo_buffer_t *buf,
+                                      geo_coords_t *coords )
+{
+    coords->lat = buf->lat;
+    coords->lon = buf->lon;
+    coords->stride = 1;
+    coords->len = buf->len;
+    coords->ids = buf->ids;
+}
+
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/cache.h
+ *  lua-geo
+ *
+ *  bounded cache of the results that derived from the integer geohash.
+ */
+
+#ifndef geo_cache_h
+#define geo_cache_h
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+
+// name of the metatable of the cache userdata
+#define GEO_CACHE_MT        "geo.cache"
+// number of the slots of the set. the keys of the set fill a cache line.
+#define GEO_CACHE_WAYS      4
+// alignment of the keys in bytes
+#define GEO_CACHE_ALIGN     64
+// default number of the entries
+#define GEO_CACHE_SIZE      4096
+// default precision of the cells of the point
+#define GEO_CACHE_PRECISION 8
+
+// operations of the cached results. the tag of the entry is the operation
+// and the auxiliary value such as the number of bits of the code.
+enum {
+    GEO_CACHE_NEIGHBORS = 1,
+    GEO_CACHE_BBOX,
+    GEO_CACHE_POLYGON
+};
+#define GEO_CACHE_TAG(op,aux)   ( (uint64_t)(op) << 48 | (uint64_t)(aux) )
+// reference bit of the CLOCK eviction
+#define GEO_CACHE_REF           ( (uint64_t)1 << 63 )
+
+// the tag of the empty slot is 0
+typedef struct {
+    uint64_t code;
+    uint64_t tag;
+} geo_cache_key_t;
+
+// cached result of a cache line
+typedef union {
+    int64_t codes[8];
+    double v[8];
+    int cls;
+} geo_cache_value_t;
+
+// set-associative table that the key is placed in one of the slots of the set
+// that selected by the hash of the key, so the lookup reads only a cache line
+// of the keys. the victim of the set is selected by the CLOCK algorithm.
+typedef struct {
+    geo_cache_key_t *keys;
+    geo_cache_value_t *values;
+    // clock hand of each set
+    uint8_t *hands;
+    size_t setmask;
+    size_t len;
+    uint8_t precision;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} geo_cache_t;
+
+
+static inline void geo_cache_free( geo_cache_t *c )
+{
+    free( c->keys );
+    free( c->values );
+    free( c->hands );
+    *c = (geo_cache_t){ 0 };
+}
+
+
+static inline void geo_cache_clear( geo_cache_t *c )
+{
+    memset( c->keys, 0,
+            sizeof( geo_cache_key_t ) * GEO_CACHE_WAYS * ( c->setmask + 1 ) );
+    memset( c->hands, 0, c->setmask + 1 );
+    c->len = 0;
+    c->hits = c->misses = c->evictions = 0;
+}
+
+
+// size: max number of the entries. it is rounded up to the power of 2.
+static inline int geo_cache_init( geo_cache_t *c, size_t size,
+                                  uint8_t precision )
+{
+    size_t nset = 1;
+    void *keys = NULL;
+    int rc = 0;
+
+    *c = (geo_cache_t){ .precision = precision };
+    while( nset * GEO_CACHE_WAYS < size ){
+        if( nset > SIZE_MAX / 2 / sizeof( geo_cache_value_t ) /
+                   GEO_CACHE_WAYS ){
+            errno = ENOMEM;
+            return -1;
+        }
+        nset *= 2;
+    }
+
+    if( ( rc = posix_memalign( &keys, GEO_CACHE_ALIGN,
+                               sizeof( geo_cache_key_t ) * GEO_CACHE_WAYS *
+                               nset ) ) != 0 ){
+        errno = rc;
+        return -1;
+    }
+    c->keys = keys;
+    c->setmask = nset - 1;
+    if( !( c->values = malloc( sizeof( geo_cache_value_t ) * GEO_CACHE_WAYS *
+                               nset ) ) ||
+        !( c->hands = malloc( nset ) ) ){
+        geo_cache_free( c );
+        return -1;
+    }
+    geo_cache_clear( c );
+
+    return 0;
+}
+
+
+static inline size_t geo_cache_set( const geo_cache_t *c, uint64_t code,
+                                    uint64_t tag )
+{
+    uint64_t h = ( code ^ ( tag * 0xC2B2AE3D27D4EB4FULL ) ) *
+                 0x9E3779B97F4A7C15ULL;
+
+    return (size_t)( h >> 32 ) & c->setmask;
+}
+
+
+// returns the cached result of the key, or NULL.
+static inline geo_cache_value_t *geo_cache_get( geo_cache_t *c, uint64_t code,
+                                                uint64_t tag )
+{
+    size_t set = geo_cache_set( c, code, tag ) * GEO_CACHE_WAYS;
+    geo_cache_key_t *keys = c->keys + set;
+    int i = 0;
+
+    for(; i < GEO_CACHE_WAYS; i++ ){
+        if( keys[i].code == code && ( keys[i].tag & ~GEO_CACHE_REF ) == tag ){
+            keys[i].tag |= GEO_CACHE_REF;
+            c->hits++;
+            return c->values + set + i;
+        }
+    }
+    c->misses++;
+
+    return NULL;
+}
+
+
+// returns the slot to store the result of the key that is not in the cache.
+// the new entry is not referenced yet, so the entries that used only once are
+// evicted before the entries that used repeatedly.
+static inline geo_cache_value_t *geo_cache_put( geo_cache_t *c, uint64_t code,
+                                                uint64_t tag )
+{
+    size_t set = geo_cache_set( c, code, tag );
+    geo_cache_key_t *keys = c->keys + set * GEO_CACHE_WAYS;
+    int i = 0;
+
+    for(; i < GEO_CACHE_WAYS && keys[i].tag; i++ ){}
+    if( i < GEO_CACHE_WAYS ){
+        c->len++;
+    }
+    else
+    {
+        // the hand clears the reference bits until the unreferenced entry
+        uint8_t hand = c->hands[set];
+
+        while( keys[hand].tag & GEO_CACHE_REF ){
+            keys[hand].tag &= ~GEO_CACHE_REF;
+            hand = ( hand + 1 ) % GEO_CACHE_WAYS;
+        }
+        i = hand;
+        c->hands[set] = ( hand + 1 ) % GEO_CACHE_WAYS;
+        c->evictions++;
+    }
+    keys[i] = (geo_cache_key_t){ code, tag };
+
+    return c->values + set * GEO_CACHE_WAYS + i;
+}
+
+
+#endif
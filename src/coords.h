@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2013-2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/coords.h
+ *  lua-geo
+ *
+ *  coordinate arguments of the batch functions.
+ */
+
+#ifndef geo_coords_h
+#define geo_coords_h
+
+#include "lauxhlib.h"
+#include "buffer.h"
+
+
+// size of a packed lat/lon pair
+#define GEO_COORD_SIZE  ( sizeof( double ) * 2 )
+
+#if LUA_VERSION_NUM < 502
+#define lua_rawlen(L,idx)   lua_objlen(L,idx)
+#endif
+
+
+// checks the packed lat/lon pairs of native doubles that stored in the
+// string or userdata, or the geo.buffer userdata at the specified index.
+static inline void geo_checkcoords( lua_State *L, int idx,
+                                    geo_coords_t *coords )
+{
+    const double *ptr = NULL;
+    size_t len = 0;
+
+    switch( lua_type( L, idx ) ){
+        case LUA_TSTRING:
+            ptr = (const double*)lua_tolstring( L, idx, &len );
+        break;
+
+        case LUA_TUSERDATA:
+            if( lua_getmetatable( L, idx ) )
+            {
+                int isbuf = 0;
+
+                luaL_getmetatable( L, GEO_BUFFER_MT );
+                isbuf = lua_rawequal( L, -1, -2 );
+                lua_pop( L, 2 );
+                if( isbuf ){
+                    geo_buffer_coords( lua_touserdata( L, idx ), coords );
+                    return;
+                }
+            }
+            ptr = (const double*)lua_touserdata( L, idx );
+            len = lua_rawlen( L, idx );
+        break;
+
+        default:
+            luaL_argerror( L, idx, "string or userdata expected" );
+    }
+
+    lauxh_argcheck(
+        L, len % GEO_COORD_SIZE == 0, idx,
+        "packed lat/lon pairs expected, got a size of %d bytes", (int)len
+    );
+
+    coords->lat = ptr;
+    coords->lon = ptr + 1;
+    coords->stride = 2;
+    coords->len = len / GEO_COORD_SIZE;
+    coords->ids = NULL;
+}
+
+
+#endif
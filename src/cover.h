@@ -0,0 +1,143 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/cover.h
+ *  lua-geo
+ *
+ *  cover of the region by the cells of the hierarchical grid.
+ */
+
+#ifndef geo_cover_h
+#define geo_cover_h
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+
+// classification of the cell against the region
+typedef enum {
+    GEO_COVER_OUTSIDE = 0,
+    GEO_COVER_PARTIAL,
+    GEO_COVER_INSIDE
+} geo_cover_e;
+
+// max number of the children of a cell
+#define GEO_COVER_MAX_FANOUT    32
+// max size of a cell in bytes
+#define GEO_COVER_MAX_CELL_SIZE 32
+
+// hierarchical grid that each cell is divided into the fanout children of the
+// next level. the root cell is the zero-filled cell of level 0.
+typedef struct {
+    // size of the cell and the offset of its uint8_t level
+    size_t size;
+    size_t lvoff;
+    int fanout;
+    // stores the i-th child of the cell
+    void (*child)( void *child, const void *cell, int i );
+    // classifies the cell against the region.
+    // it must never return GEO_COVER_OUTSIDE for the cell that intersects the
+    // region.
+    geo_cover_e (*classify)( const void *region, const void *cell );
+    // compares the cells in the order of the result
+    int (*cmp)( const void *a, const void *b );
+} geo_cover_grid_t;
+
+
+// number of cells that required to compute the cover of max_cells.
+// the number of the settled and the queued cells never exceeds the larger of
+// the max_cells and the cells of level 1.
+#define GEO_COVER_SIZE(max_cells,fanout)    ( ( (max_cells) + (fanout) ) * 2 )
+
+// computes the cells that cover the region.
+// the cells that partially intersect the region are subdivided in the
+// breadth-first order while the number of cells does not exceed the
+// max_cells, so the cells inside the region are kept as coarse as possible.
+// at least the cells of level 1 that intersect the region are returned even
+// if their number exceeds the max_cells.
+// cells: array of GEO_COVER_SIZE( max_cells, grid->fanout ) cells to store
+//        the result in the order of grid->cmp.
+// level: max level of the cells.
+// returns the number of cells.
+static inline size_t geo_cover( void *cells, size_t max_cells, uint8_t level,
+                                const geo_cover_grid_t *grid,
+                                const void *region )
+{
+    // cells that partially intersect the region are queued in the ring
+    // buffer that placed at the second half of the array, and the settled
+    // cells are stored at the first half of the array.
+    size_t size = grid->size;
+    size_t qsize = GEO_COVER_SIZE( max_cells, grid->fanout ) / 2;
+    char *settled = (char*)cells;
+    char *queue = settled + qsize * size;
+    uint64_t cell[GEO_COVER_MAX_CELL_SIZE / 8];
+    uint64_t child[GEO_COVER_MAX_FANOUT][GEO_COVER_MAX_CELL_SIZE / 8];
+    geo_cover_e cls[GEO_COVER_MAX_FANOUT];
+    size_t head = 0;
+    size_t nqueue = 1;
+    size_t ncell = 0;
+
+    memset( queue, 0, size );
+    while( nqueue )
+    {
+        uint8_t lv = 0;
+        size_t nchild = 0;
+        size_t i = 0;
+
+        memcpy( cell, queue + head * size, size );
+        head = ( head + 1 ) % qsize;
+        nqueue--;
+        lv = ( (const uint8_t*)cell )[grid->lvoff];
+        if( lv < level )
+        {
+            for(; i < (size_t)grid->fanout; i++ ){
+                grid->child( child[nchild], cell, (int)i );
+                cls[nchild] = grid->classify( region, child[nchild] );
+                nchild += cls[nchild] != GEO_COVER_OUTSIDE;
+            }
+
+            // subdivide if the number of cells does not exceed the limit
+            if( lv == 0 || ncell + nqueue + nchild <= max_cells )
+            {
+                for( i = 0; i < nchild; i++ )
+                {
+                    if( cls[i] == GEO_COVER_INSIDE || lv + 1 == level ){
+                        memcpy( settled + ncell++ * size, child[i], size );
+                    }
+                    else {
+                        memcpy( queue + ( ( head + nqueue++ ) % qsize ) * size,
+                                child[i], size );
+                    }
+                }
+                continue;
+            }
+        }
+        memcpy( settled + ncell++ * size, cell, size );
+    }
+
+    qsort( cells, ncell, size, grid->cmp );
+
+    return ncell;
+}
+
+
+#endif
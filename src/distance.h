@@ -0,0 +1,465 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/distance.h
+ *  lua-geo
+ *
+ *  one-to-many distance kernels of the distance models.
+ */
+
+#ifndef geo_distance_h
+#define geo_distance_h
+
+#include "geo.h"
+#if defined(__x86_64__) && ( defined(__GNUC__) || defined(__clang__) ) && \
+    !defined(GEO_DISTANCE_NO_SIMD)
+#define GEO_DISTANCE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+// number of distances to be computed at once by the batch kernel
+#define GEO_DISTANCE_BLOCK_SIZE 64
+
+// distance models in ascending order of the accuracy and the cost
+typedef enum {
+    // equirectangular projection at the latitude of the origin
+    GEO_DISTANCE_EQUIRECT = 0,
+    // great circle on the sphere of the mean radius
+    GEO_DISTANCE_HAVERSINE,
+    // hubeny's formula on the WGS84 ellipsoid
+    GEO_DISTANCE_HUBENY,
+    // vincenty's inverse formula on the WGS84 ellipsoid
+    GEO_DISTANCE_VINCENTY,
+    GEO_DISTANCE_NMODEL
+} geo_distance_model_e;
+
+static const char *const GEO_DISTANCE_MODEL_NAMES[] = {
+    "equirect", "haversine", "hubeny", "vincenty", NULL
+};
+
+// mean radius of the WGS84 ellipsoid ( 2a + b ) / 3
+#define GEO_MEAN_RADIUS     6371008.771415
+// flattening of the WGS84 ellipsoid
+#define GEO_FLATTENING      ( 1 / 298.257223563 )
+// max number of iterations of the vincenty's formula
+#define GEO_VINCENTY_MAX_ITER   200
+#define GEO_VINCENTY_EPSILON    1e-12
+
+// computes the distances from the origin to the validated coordinates in
+// degrees.
+typedef void (*geo_distance_kernel_t)( double *dist, const geo_t *origin,
+                                       const double *lat, const double *lon,
+                                       size_t stride, size_t len );
+
+
+// returns the longitude difference in the range of -pi to pi.
+static inline double geo_distance_dlon( double lon1, double lon2 )
+{
+    double dlon = lon1 - lon2;
+
+    if( dlon > M_PI ){
+        return dlon - GEO_PI2;
+    }
+    else if( dlon < -M_PI ){
+        return dlon + GEO_PI2;
+    }
+    return dlon;
+}
+
+
+// cosine of the angle in the range of -pi/2 to pi/2 by the taylor series.
+// the error is less than 2e-17, and it consists only of the multiplications
+// and the additions to be vectorized.
+#define GEO_COS_C1  ( -1.0 / 2 )
+#define GEO_COS_C2  ( 1.0 / 24 )
+#define GEO_COS_C3  ( -1.0 / 720 )
+#define GEO_COS_C4  ( 1.0 / 40320 )
+#define GEO_COS_C5  ( -1.0 / 3628800 )
+#define GEO_COS_C6  ( 1.0 / 479001600 )
+#define GEO_COS_C7  ( -1.0 / 87178291200 )
+#define GEO_COS_C8  ( 1.0 / 20922789888000 )
+#define GEO_COS_C9  ( -1.0 / 6402373705728000 )
+#define GEO_COS_C10 ( 1.0 / 2432902008176640000 )
+
+static inline double geo_distance_cos( double x )
+{
+    double z = x * x;
+
+    return 1.0 + z * ( GEO_COS_C1 + z * ( GEO_COS_C2 + z * ( GEO_COS_C3 +
+           z * ( GEO_COS_C4 + z * ( GEO_COS_C5 + z * ( GEO_COS_C6 +
+           z * ( GEO_COS_C7 + z * ( GEO_COS_C8 + z * ( GEO_COS_C9 +
+           z * GEO_COS_C10 ) ) ) ) ) ) ) ) );
+}
+
+
+// hubeny's formula.
+// it is the same formula as the geo_get_distance.
+static inline double geo_distance_hubeny( const geo_t *origin, double lat,
+                                          double lon )
+{
+    double c = geo_distance_cos( ( origin->lat_rad + lat ) * 0.5 );
+    double w2 = 1 - GEO_ECCENTRICITY * ( 1 - c * c );
+    double w = sqrt( w2 );
+    double dlat = ( origin->lat_rad - lat ) * ( GEO_MERIDIAN_NUM / ( w2 * w ) );
+    double dlon = geo_distance_dlon( origin->lon_rad, lon ) *
+                  ( GEO_WGS84MAJOR / w * c );
+
+    return sqrt( dlat * dlat + dlon * dlon );
+}
+
+
+// equirectangular approximation.
+// the origin must be initialized with the math.
+static inline double geo_distance_equirect( const geo_t *origin, double lat,
+                                            double lon )
+{
+    double dlat = origin->lat_rad - lat;
+    double dlon = geo_distance_dlon( origin->lon_rad, lon ) *
+                  origin->lat_cos;
+
+    return GEO_MEAN_RADIUS * sqrt( dlat * dlat + dlon * dlon );
+}
+
+
+// haversine formula.
+// the origin must be initialized with the math.
+static inline double geo_distance_haversine( const geo_t *origin, double lat,
+                                             double lon )
+{
+    double slat = sin( ( lat - origin->lat_rad ) * 0.5 );
+    double slon = sin( geo_distance_dlon( lon, origin->lon_rad ) * 0.5 );
+    double h = slat * slat + origin->lat_cos * cos( lat ) * slon * slon;
+
+    return 2 * GEO_MEAN_RADIUS * asin( sqrt( fmin( h, 1 ) ) );
+}
+
+
+// vincenty's inverse formula.
+// returns NaN if it does not converge for the nearly antipodal points.
+static inline double geo_distance_vincenty( const geo_t *origin, double lat,
+                                            double lon )
+{
+    const double f = GEO_FLATTENING;
+    const double b = GEO_WGS84MAJOR * ( 1 - f );
+    double L = geo_distance_dlon( lon, origin->lon_rad );
+    double u1 = atan( ( 1 - f ) * tan( origin->lat_rad ) );
+    double u2 = atan( ( 1 - f ) * tan( lat ) );
+    double u1_sin = sin( u1 ), u1_cos = cos( u1 );
+    double u2_sin = sin( u2 ), u2_cos = cos( u2 );
+    double lambda = L;
+    double sigma = 0, sigma_sin = 0, sigma_cos = 0;
+    double alpha_cos2 = 0, sigma_m2_cos = 0;
+    double u, A, B, dsigma;
+    int i = 0;
+
+    for(; i < GEO_VINCENTY_MAX_ITER; i++ )
+    {
+        double lambda_sin = sin( lambda );
+        double lambda_cos = cos( lambda );
+        double x = u2_cos * lambda_sin;
+        double y = u1_cos * u2_sin - u1_sin * u2_cos * lambda_cos;
+        double alpha_sin, C, prev;
+
+        sigma_sin = sqrt( x * x + y * y );
+        if( sigma_sin == 0 ){
+            // coincident points
+            return 0;
+        }
+        sigma_cos = u1_sin * u2_sin + u1_cos * u2_cos * lambda_cos;
+        sigma = atan2( sigma_sin, sigma_cos );
+        alpha_sin = u1_cos * u2_cos * lambda_sin / sigma_sin;
+        alpha_cos2 = 1 - alpha_sin * alpha_sin;
+        // equatorial line if alpha_cos2 is 0
+        sigma_m2_cos = alpha_cos2 != 0 ?
+                       sigma_cos - 2 * u1_sin * u2_sin / alpha_cos2 : 0;
+        C = f / 16 * alpha_cos2 * ( 4 + f * ( 4 - 3 * alpha_cos2 ) );
+        prev = lambda;
+        lambda = L + ( 1 - C ) * f * alpha_sin *
+                 ( sigma + C * sigma_sin *
+                   ( sigma_m2_cos + C * sigma_cos *
+                     ( -1 + 2 * sigma_m2_cos * sigma_m2_cos ) ) );
+        if( fabs( lambda - prev ) < GEO_VINCENTY_EPSILON ){
+            break;
+        }
+    }
+    if( i == GEO_VINCENTY_MAX_ITER ){
+        return NAN;
+    }
+
+    u = alpha_cos2 * ( GEO_WGS84MAJOR * GEO_WGS84MAJOR - b * b ) / ( b * b );
+    A = 1 + u / 16384 * ( 4096 + u * ( -768 + u * ( 320 - 175 * u ) ) );
+    B = u / 1024 * ( 256 + u * ( -128 + u * ( 74 - 47 * u ) ) );
+    dsigma = B * sigma_sin *
+             ( sigma_m2_cos + B / 4 *
+               ( sigma_cos * ( -1 + 2 * sigma_m2_cos * sigma_m2_cos ) -
+                 B / 6 * sigma_m2_cos * ( -3 + 4 * sigma_sin * sigma_sin ) *
+                 ( -3 + 4 * sigma_m2_cos * sigma_m2_cos ) ) );
+
+    return b * A * ( sigma - dsigma );
+}
+
+
+// defines the batch kernel of the model.
+// the distance function is inlined into the loop, so the loop has no
+// branch to select the model.
+#define GEO_DISTANCE_KERNEL(model) \
+static inline void geo_distance_kernel_##model( double *dist, \
+                                                const geo_t *origin, \
+                                                const double *lat, \
+                                                const double *lon, \
+                                                size_t stride, size_t len ) \
+{ \
+    size_t i = 0; \
+    for(; i < len; i++ ){ \
+        dist[i] = geo_distance_##model( origin, lat[i * stride] * GEO_RAD, \
+                                        lon[i * stride] * GEO_RAD ); \
+    } \
+}
+
+GEO_DISTANCE_KERNEL( equirect )
+GEO_DISTANCE_KERNEL( haversine )
+GEO_DISTANCE_KERNEL( hubeny )
+GEO_DISTANCE_KERNEL( vincenty )
+
+#undef GEO_DISTANCE_KERNEL
+
+
+#if defined(GEO_DISTANCE_X86_SIMD)
+
+// the following functions are the vectorized version of the distance
+// functions. they use the same operations in the same order, so the
+// distances differ from the scalar kernels only if the compiler contracts
+// the scalar operations into the fused multiply-add.
+
+__attribute__((target("avx2")))
+static inline __m256d geo_distance_dlon_avx2( __m256d lon1, __m256d lon2 )
+{
+    const __m256d pi = _mm256_set1_pd( M_PI );
+    const __m256d pi2 = _mm256_set1_pd( GEO_PI2 );
+    __m256d dlon = _mm256_sub_pd( lon1, lon2 );
+
+    dlon = _mm256_sub_pd( dlon, _mm256_and_pd(
+        _mm256_cmp_pd( dlon, pi, _CMP_GT_OQ ), pi2
+    ));
+    return _mm256_add_pd( dlon, _mm256_and_pd(
+        _mm256_cmp_pd( dlon, _mm256_sub_pd( _mm256_setzero_pd(), pi ),
+                       _CMP_LT_OQ ), pi2
+    ));
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256d geo_distance_equirect_avx2( const geo_t *origin,
+                                                  __m256d lat, __m256d lon )
+{
+    __m256d dlat = _mm256_sub_pd( _mm256_set1_pd( origin->lat_rad ), lat );
+    __m256d dlon = _mm256_mul_pd(
+        geo_distance_dlon_avx2( _mm256_set1_pd( origin->lon_rad ), lon ),
+        _mm256_set1_pd( origin->lat_cos )
+    );
+
+    return _mm256_mul_pd(
+        _mm256_set1_pd( GEO_MEAN_RADIUS ),
+        _mm256_sqrt_pd( _mm256_add_pd( _mm256_mul_pd( dlat, dlat ),
+                                       _mm256_mul_pd( dlon, dlon ) ) )
+    );
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256d geo_distance_hubeny_avx2( const geo_t *origin,
+                                                __m256d lat, __m256d lon )
+{
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    const __m256d olat = _mm256_set1_pd( origin->lat_rad );
+    __m256d x = _mm256_mul_pd( _mm256_add_pd( olat, lat ),
+                               _mm256_set1_pd( 0.5 ) );
+    __m256d z = _mm256_mul_pd( x, x );
+    __m256d c = _mm256_set1_pd( GEO_COS_C10 );
+    __m256d w2, w, dlat, dlon;
+
+    // taylor series of the cosine
+#define GEO_COS_STEP(k) \
+    c = _mm256_add_pd( _mm256_set1_pd( GEO_COS_C##k ), _mm256_mul_pd( z, c ) )
+    GEO_COS_STEP(9);
+    GEO_COS_STEP(8);
+    GEO_COS_STEP(7);
+    GEO_COS_STEP(6);
+    GEO_COS_STEP(5);
+    GEO_COS_STEP(4);
+    GEO_COS_STEP(3);
+    GEO_COS_STEP(2);
+    GEO_COS_STEP(1);
+#undef GEO_COS_STEP
+    c = _mm256_add_pd( one, _mm256_mul_pd( z, c ) );
+
+    w2 = _mm256_sub_pd( one, _mm256_mul_pd(
+        _mm256_set1_pd( GEO_ECCENTRICITY ),
+        _mm256_sub_pd( one, _mm256_mul_pd( c, c ) )
+    ));
+    w = _mm256_sqrt_pd( w2 );
+    dlat = _mm256_mul_pd(
+        _mm256_sub_pd( olat, lat ),
+        _mm256_div_pd( _mm256_set1_pd( GEO_MERIDIAN_NUM ),
+                       _mm256_mul_pd( w2, w ) )
+    );
+    dlon = _mm256_mul_pd(
+        geo_distance_dlon_avx2( _mm256_set1_pd( origin->lon_rad ), lon ),
+        _mm256_mul_pd( _mm256_div_pd( _mm256_set1_pd( GEO_WGS84MAJOR ), w ),
+                       c )
+    );
+
+    return _mm256_sqrt_pd( _mm256_add_pd( _mm256_mul_pd( dlat, dlat ),
+                                          _mm256_mul_pd( dlon, dlon ) ) );
+}
+
+
+// defines the AVX2 batch kernel of the model.
+// the remaining coordinates are computed by the scalar kernel.
+#define GEO_DISTANCE_KERNEL_AVX2(model) \
+__attribute__((target("avx2"))) \
+static inline void geo_distance_kernel_##model##_avx2( double *dist, \
+                                                       const geo_t *origin, \
+                                                       const double *lat, \
+                                                       const double *lon, \
+                                                       size_t stride, \
+                                                       size_t len ) \
+{ \
+    const __m256d rad = _mm256_set1_pd( GEO_RAD ); \
+    size_t i = 0; \
+    if( stride == 1 || stride == 2 ){ \
+        for(; i + 4 <= len; i += 4 ){ \
+            __m256d vlat, vlon; \
+            if( stride == 1 ){ \
+                vlat = _mm256_loadu_pd( lat + i ); \
+                vlon = _mm256_loadu_pd( lon + i ); \
+            } \
+            else { \
+                /* [lat0 lon0 lat1 lon1] [lat2 lon2 lat3 lon3] */ \
+                __m256d a = _mm256_loadu_pd( lat + i * 2 ); \
+                __m256d b = _mm256_loadu_pd( lat + i * 2 + 4 ); \
+                /* [lat0 lat2 lat1 lat3] -> [lat0 lat1 lat2 lat3] */ \
+                vlat = _mm256_permute4x64_pd( _mm256_unpacklo_pd( a, b ), \
+                                              0xD8 ); \
+                vlon = _mm256_permute4x64_pd( _mm256_unpackhi_pd( a, b ), \
+                                              0xD8 ); \
+            } \
+            _mm256_storeu_pd( dist + i, geo_distance_##model##_avx2( \
+                origin, _mm256_mul_pd( vlat, rad ), \
+                _mm256_mul_pd( vlon, rad ) \
+            )); \
+        } \
+    } \
+    geo_distance_kernel_##model( dist + i, origin, lat + i * stride, \
+                                 lon + i * stride, stride, len - i ); \
+}
+
+GEO_DISTANCE_KERNEL_AVX2( equirect )
+GEO_DISTANCE_KERNEL_AVX2( hubeny )
+
+#undef GEO_DISTANCE_KERNEL_AVX2
+
+#endif
+
+
+// kernels of each model.
+// the equirect and hubeny kernels are replaced by the SIMD kernels in the
+// geo_distance_kernel_init.
+static geo_distance_kernel_t geo_distance_kernels[GEO_DISTANCE_NMODEL] = {
+    geo_distance_kernel_equirect,
+    geo_distance_kernel_haversine,
+    geo_distance_kernel_hubeny,
+    geo_distance_kernel_vincenty
+};
+static const char *geo_distance_kernel_name = "scalar";
+
+static inline void geo_distance_kernel_init( void )
+{
+#if defined(GEO_DISTANCE_X86_SIMD)
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) ){
+        geo_distance_kernels[GEO_DISTANCE_EQUIRECT] =
+            geo_distance_kernel_equirect_avx2;
+        geo_distance_kernels[GEO_DISTANCE_HUBENY] =
+            geo_distance_kernel_hubeny_avx2;
+        geo_distance_kernel_name = "avx2";
+    }
+#endif
+}
+
+
+// computes the distances from the origin to the coordinates by the model.
+// the origin must be initialized with the math.
+// returns the number of computed distances. it is less than the number of
+// coordinates if the coordinate at the returned position is out of range
+// (EINVAL), or the vincenty's formula does not converge for it (EDOM).
+static inline size_t geo_distance_batch( double *dist, const geo_t *origin,
+                                         const geo_coords_t *coords,
+                                         geo_distance_model_e model )
+{
+    geo_distance_kernel_t kernel = geo_distance_kernels[model];
+    size_t i = 0;
+
+    while( i < coords->len )
+    {
+        const double *lat = coords->lat + i * coords->stride;
+        const double *lon = coords->lon + i * coords->stride;
+        size_t n = coords->len - i;
+        size_t j = 0;
+        int valid = 1;
+
+        if( n > GEO_DISTANCE_BLOCK_SIZE ){
+            n = GEO_DISTANCE_BLOCK_SIZE;
+        }
+        for(; j < n; j++ ){
+            valid &= GEO_IS_LATLON_RANGE( lat[j * coords->stride],
+                                          lon[j * coords->stride] );
+        }
+        if( !valid ){
+            // compute the valid coordinates before the invalid one
+            for( j = 0; GEO_IS_LATLON_RANGE( lat[j * coords->stride],
+                                             lon[j * coords->stride] ); j++ ){}
+            n = j;
+        }
+
+        kernel( dist + i, origin, lat, lon, coords->stride, n );
+        if( model == GEO_DISTANCE_VINCENTY ){
+            for( j = 0; j < n; j++ ){
+                if( isnan( dist[i + j] ) ){
+                    errno = EDOM;
+                    return i + j;
+                }
+            }
+        }
+        i += n;
+
+        if( !valid ){
+            errno = EINVAL;
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+#endif
@@ -38,6 +38,10 @@
 #include "lauxlib.h"
 #include "lualib.h"
 #include "lua.h"
+#include "distance.h"
+#include "geohash.h"
+#include "coords.h"
+#include "reader.h"
 
 // helper macros for lua_State
 #define lstate_fn2tbl(L,k,v) do{ \
@@ -54,58 +58,6 @@
 
 
 
-#define GEO_MAX_HASH_LEN    16
-#define GEO_MAX_PRECISION_RANGE     16
-#define GEO_IS_PRECISION_RANGE(p)   ( p > 0 && p < 17 )
-#define GEO_IS_LAT_RANGE(l)         ( l >= -90 && l <= 90 )
-#define GEO_IS_LON_RANGE(l)         ( l >= -180 && l <= 180 )
-#define GEO_IS_LATLON_RANGE(la,lo) \
-    ( GEO_IS_LAT_RANGE(la) && GEO_IS_LON_RANGE( la ) )
-
-// semi-major axis of ellipse
-#define GEO_WGS84MAJOR  6378137.0
-// semi-minor axis of ellipse
-#define GEO_WGS84MINOR  6356752.314245
-
-// eccentricity
-// ( GEO_WGS84MAJOR^2 - GEO_WGS84MINOR^2 ) / GEO_WGS84MAJOR^2 = 0.006694379990197
-#define GEO_ECCENTRICITY    0.006694379990197
-
-// meridian numerator
-//    = GEO_WGS84MAJOR * ( 1 - GEO_ECCENTRICITY )
-//    = 6378137.0 * 1- 0.006694379990197
-//    = 6335439.327292464877011
-#define GEO_MERIDIAN_NUM    6335439.327292464877011
-
-// lat_ave = ( org_lat_rad + dst_lat_rad ) / 2;
-// W = sqrt( 1 - GEO_ECCENTRICITY * lat_ave_sin^2 )
-// meridian curvature: GEO_MERIDIAN_NUM / pow( W, 3 )
-#define GEO_MERIDIAN(w)     (GEO_MERIDIAN_NUM/pow(w,3))
-// prime vertical: GEO_WGS84MAJOR / W
-#define GEO_PRIME_VERT(w)   (GEO_WGS84MAJOR/w)
-
-static const double GEO_RAD = M_PI/180;
-static const double GEO_DEG = 180/M_PI;
-static const double GEO_PI2 = M_PI*2;
-
-#define GEO_DEG2RAD(d)  (d*GEO_RAD)
-#define GEO_RAD2DEG(r)  (r/GEO_DEG)
-
-static const uint8_t GEO_BITMASK[5] = { 16, 8, 4, 2, 1 };
-
-
-typedef struct {
-    double lat;
-    double lon;
-    double lat_rad;
-    double lon_rad;
-    double lat_sin;
-    double lat_cos;
-    double lon_sin;
-    double lon_cos;
-} geo_t;
-
-
 typedef struct {
     double lat;
     double lon;
@@ -116,31 +68,17 @@ typedef struct {
     double dist_cos;
     double angle;
     double angle_rad;
+    double angle_sin;
+    double angle_cos;
+    // terms that depend on the pivot and the distance
+    // pivot_dist_cs: pivot->lat_cos * dist_sin
+    // pivot_dist_sc: pivot->lat_sin * dist_cos
+    double pivot_dist_cs;
+    double pivot_dist_sc;
     geo_t *pivot;
 } geodest_t;
 
 
-static int geo_init( geo_t *geo, double lat, double lon, int with_math )
-{
-    if( GEO_IS_LATLON_RANGE( lat, lon ) )
-    {
-        geo->lat = lat;
-        geo->lon = lon;
-        geo->lat_rad = GEO_DEG2RAD(lat);
-        geo->lon_rad = GEO_DEG2RAD(lon);
-        if( with_math ){
-            geo->lat_sin = sin( geo->lat_rad );
-            geo->lat_cos = cos( geo->lat_rad );
-            geo->lon_sin = sin( geo->lon_rad );
-            geo->lon_cos = cos( geo->lon_rad );
-        }
-        return 0;
-    }
-
-    errno = EINVAL;
-    return -1;
-}
-
 static int geo_init_by_tokyo( geo_t *geo, double lat, double lon, int with_math )
 {
     return geo_init( geo,
@@ -149,28 +87,21 @@ static int geo_init_by_tokyo( geo_t *geo, double lat, double lon, int with_math
                      with_math );
 }
 
-// merter
-static double geo_get_distance( geo_t *from, geo_t *dest )
-{
-    double lat_ave = ( from->lat_rad + dest->lat_rad ) / 2;
-    double W = sqrt( 1 - GEO_ECCENTRICITY * pow( sin( lat_ave ), 2 ) );
-
-    return sqrt( pow( ( from->lat_rad - dest->lat_rad ) * GEO_MERIDIAN(W), 2 ) +
-                 pow( ( from->lon_rad - dest->lon_rad ) * GEO_PRIME_VERT(W) *
-                      cos( lat_ave ), 2 ) );
-}
-
+// computes the destination from the cached terms.
+// the pivot must be initialized with the math.
 static void geo_dest_update( geodest_t *dest )
 {
-    double platc_ds = dest->pivot->lat_cos * dest->dist_sin;
+    double lat_sin = dest->pivot_dist_sc +
+                     dest->pivot_dist_cs * dest->angle_cos;
 
-    dest->lat_rad = asin( dest->pivot->lat_sin * dest->dist_cos +
-                          platc_ds * cos( dest->angle_rad ) );
-    dest->lon_rad = fmod( dest->pivot->lon_rad +
-                          atan2( platc_ds * sin( dest->angle_rad ),
-                                 dest->dist_cos -
-                                 pow( dest->pivot->lat_sin, 2 ) ) +
-                          M_PI, GEO_PI2 ) - M_PI;
+    // clip the rounding error at the poles
+    lat_sin = fmin( fmax( lat_sin, -1 ), 1 );
+    dest->lat_rad = asin( lat_sin );
+    dest->lon_rad = remainder( dest->pivot->lon_rad +
+                               atan2( dest->pivot_dist_cs * dest->angle_sin,
+                                      dest->dist_cos -
+                                      dest->pivot->lat_sin * lat_sin ),
+                               GEO_PI2 );
 
     dest->lat = dest->lat_rad * GEO_DEG;
     dest->lon = dest->lon_rad * GEO_DEG;
@@ -180,6 +111,8 @@ static void geo_set_angle( geodest_t *dest, double angle, int update )
 {
     dest->angle = angle;
     dest->angle_rad = angle * GEO_RAD;
+    dest->angle_sin = sin( dest->angle_rad );
+    dest->angle_cos = cos( dest->angle_rad );
 
     if( update ){
         geo_dest_update( dest );
@@ -191,6 +124,19 @@ static void geo_set_distance( geodest_t *dest, double dist, int update )
     dest->dist = dist / GEO_WGS84MAJOR;
     dest->dist_sin = sin( dest->dist );
     dest->dist_cos = cos( dest->dist );
+    dest->pivot_dist_cs = dest->pivot->lat_cos * dest->dist_sin;
+    dest->pivot_dist_sc = dest->pivot->lat_sin * dest->dist_cos;
+
+    if( update ){
+        geo_dest_update( dest );
+    }
+}
+
+static void geo_set_pivot( geodest_t *dest, geo_t *pivot, int update )
+{
+    dest->pivot = pivot;
+    dest->pivot_dist_cs = pivot->lat_cos * dest->dist_sin;
+    dest->pivot_dist_sc = pivot->lat_sin * dest->dist_cos;
 
     if( update ){
         geo_dest_update( dest );
@@ -206,105 +152,45 @@ static void geo_get_dest( geodest_t *dest, geo_t *from, double dist, double angl
 }
 
 
-static char *geo_hash_encode( char *hash, double lat, double lon, uint8_t precision )
-{
-    if( !GEO_IS_PRECISION_RANGE( precision ) ||
-        !GEO_IS_LATLON_RANGE( lat, lon ) ){
-        errno = EINVAL;
-        return NULL;
-    }
-    else
-    {
-        static const char geobase32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
-        double latlon[2][2] = { { -90.0, 90.0 }, { -180.0, 180.0 } };
-        double latlon_org[2] = { lat, lon };
-        int is_lon = 1;
-        double mid;
-        int bit = 0;
-        uint8_t idx = 0;
-        int i = 0;
-
-        // precision: 1 - 16
-        while( i < precision )
-        {
-            mid = ( latlon[is_lon][0] + latlon[is_lon][1] ) / 2;
-            if( latlon_org[is_lon] >= mid ){
-                idx |= GEO_BITMASK[bit];
-                latlon[is_lon][0] = mid;
-            }
-            else{
-                latlon[is_lon][1] = mid;
-            }
-            is_lon = !is_lon;
-
-            if( bit < 4 ){
-                bit++;
-            }
-            else {
-                hash[i++] = geobase32[idx];
-                bit = 0;
-                idx = 0;
-            }
-        }
-        hash[i] = '\0';
-    }
-
-    return hash;
-}
-
+// number of bearings of the ring that rotated incrementally before the
+// bearing is computed again to cancel the accumulated rounding error.
+#define GEO_DEST_RING_SYNC  64
 
-static int geo_hash_decode( const char *hash, size_t len, double *lat, double *lon )
+// computes the destinations of n bearings at regular intervals starting from
+// the current bearing into the packed lat/lon pairs.
+// the bearings are rotated by the angle addition formula, so the pivot and
+// the distance terms are computed only once.
+static void geo_dest_ring( geodest_t *dest, double *coords, size_t n )
 {
-    if( GEO_IS_PRECISION_RANGE( len ) )
+    double step = GEO_PI2 / n;
+    double step_sin = sin( step );
+    double step_cos = cos( step );
+    double angle_rad = dest->angle_rad;
+    double angle_sin = dest->angle_sin;
+    double angle_cos = dest->angle_cos;
+    size_t i = 0;
+
+    for(; i < n; i++ )
     {
-        static const unsigned char geohash32code[256] = {
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0,
-        //  0  1  2  3  4  5  6  7  8  9
-            1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
-            0, 0, 0, 0, 0, 0, 0, 0,
-        //  B   C   D   E   F   G   H      J   K      M   N      P   Q   R   S
-            11, 12, 13, 14, 15, 16, 17, 0, 18, 19, 0, 20, 21, 0, 22, 23, 24, 25,
-        //  T   U   V   W   X   Y   Z
-            26, 27, 28, 29, 30, 31, 32,
-            0
-        };
-        const unsigned char *code = (const unsigned char*)hash;
-        double latlon[2][2] = { { -90.0, 90.0 }, { -180.0, 180.0 } };
-        uint8_t c;
-        int is_lon = 1;
-        int mask = 0;
-        size_t i, j;
-
-        for( i = 0; i < len; i++ )
-        {
-            // to uppercase
-            c = ( code[i] > '`' && code[i] < '{' ) ? code[i] - 32 : code[i];
-            c = geohash32code[c];
-            // invalid charcode
-            if( !c ){
-                errno = EINVAL;
-                return -1;
-            }
-            // decode
-            for( j = 0; j < 5; j++ ){
-                mask = ( c - 1 ) & GEO_BITMASK[j];
-                latlon[is_lon][!mask] = ( latlon[is_lon][0] + latlon[is_lon][1] ) / 2;
-                is_lon = !is_lon;
-            }
+        if( i % GEO_DEST_RING_SYNC == 0 ){
+            dest->angle_sin = sin( angle_rad + step * i );
+            dest->angle_cos = cos( angle_rad + step * i );
         }
+        else {
+            double s = dest->angle_sin;
 
-        *lat = ( latlon[0][0] + latlon[0][1] ) / 2;
-        *lon = ( latlon[1][0] + latlon[1][1] ) / 2;
-
-        return 0;
-    }
-    else {
-        errno = EOVERFLOW;
+            dest->angle_sin = s * step_cos + dest->angle_cos * step_sin;
+            dest->angle_cos = dest->angle_cos * step_cos - s * step_sin;
+        }
+        geo_dest_update( dest );
+        coords[i * 2] = dest->lat;
+        coords[i * 2 + 1] = dest->lon;
     }
 
-    return -1;
+    // restore the current bearing
+    dest->angle_sin = angle_sin;
+    dest->angle_cos = angle_cos;
+    geo_dest_update( dest );
 }
 
 
@@ -354,20 +240,825 @@ static int decode_lua( lua_State *L )
 }
 
 
+// decodes the geohash into the fields of the table or the element of the
+// geo.buffer in place, so that the repeated decoding does not allocate.
+static int decode_into_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *hash = luaL_checklstring( L, 1, &len );
+    double lat = 0;
+    double lon = 0;
+
+    if( lua_istable( L, 2 ) )
+    {
+        lua_settop( L, 2 );
+        if( geo_hash_decode( hash, len, &lat, &lon ) != 0 ){
+            goto FAILED;
+        }
+        lstate_num2tbl( L, "lat", lat );
+        lstate_num2tbl( L, "lon", lon );
+    }
+    else
+    {
+        geo_buffer_t *buf = luaL_checkudata( L, 2, GEO_BUFFER_MT );
+        lua_Integer idx = luaL_optinteger( L, 3, buf->len + 1 );
+
+        luaL_argcheck(
+            L, idx >= 1 && (size_t)idx <= buf->len + 1, 3,
+            "index out of range"
+        );
+        lua_settop( L, 2 );
+        if( geo_hash_decode( hash, len, &lat, &lon ) != 0 ){
+            goto FAILED;
+        }
+        else if( (size_t)idx <= buf->len ){
+            buf->lat[idx - 1] = lat;
+            buf->lon[idx - 1] = lon;
+        }
+        // the capacity of the cleared buffer is reused
+        else if( geo_buffer_push( buf, lat, lon, 0 ) != 0 ){
+            goto FAILED;
+        }
+    }
+
+    return 1;
+
+FAILED:
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    return 2;
+}
+
+
+static int distance_lua( lua_State *L )
+{
+    geo_distance_model_e model = luaL_checkoption( L, 5, "hubeny",
+                                                   GEO_DISTANCE_MODEL_NAMES );
+    geo_t from;
+    double to[2] = { luaL_checknumber( L, 3 ), luaL_checknumber( L, 4 ) };
+    geo_coords_t coords = { to, to + 1, 2, 1, NULL };
+    double dist = 0;
+
+    if( geo_init( &from, luaL_checknumber( L, 1 ), luaL_checknumber( L, 2 ),
+                  1 ) == 0 &&
+        geo_distance_batch( &dist, &from, &coords, model ) == 1 ){
+        lua_pushnumber( L, dist );
+        return 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int distance_many_lua( lua_State *L )
+{
+    double lat = luaL_checknumber( L, 1 );
+    double lon = luaL_checknumber( L, 2 );
+    geo_distance_model_e model = luaL_checkoption( L, 4, "hubeny",
+                                                   GEO_DISTANCE_MODEL_NAMES );
+    geo_coords_t coords;
+    geo_t origin;
+    double dist[GEO_DISTANCE_BLOCK_SIZE];
+    size_t i = 0;
+
+    geo_checkcoords( L, 3, &coords );
+    if( geo_init( &origin, lat, lon, 1 ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+
+    lua_createtable( L, coords.len, 0 );
+    while( i < coords.len )
+    {
+        geo_coords_t blk = coords;
+        size_t n = coords.len - i;
+        size_t j = 0;
+
+        if( n > GEO_DISTANCE_BLOCK_SIZE ){
+            n = GEO_DISTANCE_BLOCK_SIZE;
+        }
+        blk.lat += i * coords.stride;
+        blk.lon += i * coords.stride;
+        blk.len = n;
+        n = geo_distance_batch( dist, &origin, &blk, model );
+        for(; j < n; j++ ){
+            lua_pushnumber( L, dist[j] );
+            lua_rawseti( L, -2, i + j + 1 );
+        }
+        i += n;
+        if( n != blk.len ){
+            // got error
+            lua_pushnil( L );
+            lua_pushstring( L, strerror( errno ) );
+            lua_pushinteger( L, (lua_Integer)i + 1 );
+            return 3;
+        }
+    }
+
+    return 1;
+}
+
+
+// MARK: geo.dest
+#define GEO_DEST_MT "geo.dest"
+
+typedef struct {
+    geo_t pivot;
+    geodest_t dest;
+} geo_dest_t;
+
+
+static int dest_pushlatlon( lua_State *L, geodest_t *dest )
+{
+    lua_pushnumber( L, dest->lat );
+    lua_pushnumber( L, dest->lon );
+
+    return 2;
+}
+
+
+static int dest_set_pivot_lua( lua_State *L )
+{
+    geo_dest_t *d = luaL_checkudata( L, 1, GEO_DEST_MT );
+    double lat = luaL_checknumber( L, 2 );
+    double lon = luaL_checknumber( L, 3 );
+
+    if( geo_init( &d->pivot, lat, lon, 1 ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    geo_set_pivot( &d->dest, &d->pivot, 1 );
+
+    return dest_pushlatlon( L, &d->dest );
+}
+
+
+static int dest_set_angle_lua( lua_State *L )
+{
+    geo_dest_t *d = luaL_checkudata( L, 1, GEO_DEST_MT );
+
+    geo_set_angle( &d->dest, luaL_checknumber( L, 2 ), 1 );
+
+    return dest_pushlatlon( L, &d->dest );
+}
+
+
+static int dest_set_distance_lua( lua_State *L )
+{
+    geo_dest_t *d = luaL_checkudata( L, 1, GEO_DEST_MT );
+
+    geo_set_distance( &d->dest, luaL_checknumber( L, 2 ), 1 );
+
+    return dest_pushlatlon( L, &d->dest );
+}
+
+
+static int dest_get_lua( lua_State *L )
+{
+    geo_dest_t *d = luaL_checkudata( L, 1, GEO_DEST_MT );
+
+    dest_pushlatlon( L, &d->dest );
+    lua_pushnumber( L, d->dest.dist * GEO_WGS84MAJOR );
+    lua_pushnumber( L, d->dest.angle );
+
+    return 4;
+}
+
+
+static int dest_ring_lua( lua_State *L )
+{
+    geo_dest_t *d = luaL_checkudata( L, 1, GEO_DEST_MT );
+    lua_Integer n = luaL_checkinteger( L, 2 );
+    double *coords = NULL;
+
+    luaL_argcheck( L, n > 0 && n <= INT32_MAX, 2, "positive integer expected" );
+    coords = lua_newuserdata( L, sizeof( double ) * 2 * n );
+    geo_dest_ring( &d->dest, coords, n );
+    lua_pushlstring( L, (const char*)coords, sizeof( double ) * 2 * n );
+
+    return 1;
+}
+
+
+static int dest_tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, GEO_DEST_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+static int dest_lua( lua_State *L )
+{
+    double lat = luaL_checknumber( L, 1 );
+    double lon = luaL_checknumber( L, 2 );
+    double dist = luaL_optnumber( L, 3, 0 );
+    double angle = luaL_optnumber( L, 4, 0 );
+    geo_dest_t *d = lua_newuserdata( L, sizeof( geo_dest_t ) );
+
+    if( geo_init( &d->pivot, lat, lon, 1 ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    geo_get_dest( &d->dest, &d->pivot, dist, angle );
+    luaL_getmetatable( L, GEO_DEST_MT );
+    lua_setmetatable( L, -2 );
+
+    return 1;
+}
+
+
+// MARK: geo.buffer
+static geo_buffer_t *buffer_check( lua_State *L, lua_Integer *idx, int arg )
+{
+    geo_buffer_t *buf = luaL_checkudata( L, 1, GEO_BUFFER_MT );
+
+    if( idx ){
+        *idx = luaL_checkinteger( L, arg );
+        luaL_argcheck(
+            L, *idx >= 1 && (size_t)*idx <= buf->len, arg,
+            "index out of range"
+        );
+    }
+
+    return buf;
+}
+
+
+static int buffer_pusherror( lua_State *L )
+{
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    return 2;
+}
+
+
+static int buffer_push_lua( lua_State *L )
+{
+    geo_buffer_t *buf = buffer_check( L, NULL, 0 );
+    double lat = luaL_checknumber( L, 2 );
+    double lon = luaL_checknumber( L, 3 );
+    lua_Integer id = luaL_optinteger( L, 4, 0 );
+
+    if( geo_buffer_push( buf, lat, lon, id ) != 0 ){
+        return buffer_pusherror( L );
+    }
+    lua_pushinteger( L, (lua_Integer)buf->len );
+
+    return 1;
+}
+
+
+static int buffer_append_lua( lua_State *L )
+{
+    geo_buffer_t *buf = buffer_check( L, NULL, 0 );
+    geo_coords_t coords;
+
+    geo_checkcoords( L, 2, &coords );
+    if( geo_buffer_append( buf, &coords ) != 0 ){
+        return buffer_pusherror( L );
+    }
+    lua_pushinteger( L, (lua_Integer)buf->len );
+
+    return 1;
+}
+
+
+static int buffer_get_lua( lua_State *L )
+{
+    lua_Integer idx = 0;
+    geo_buffer_t *buf = buffer_check( L, &idx, 2 );
+
+    lua_pushnumber( L, buf->lat[idx - 1] );
+    lua_pushnumber( L, buf->lon[idx - 1] );
+    if( buf->ids ){
+        lua_pushinteger( L, (lua_Integer)buf->ids[idx - 1] );
+        return 3;
+    }
+
+    return 2;
+}
+
+
+static int buffer_set_lua( lua_State *L )
+{
+    lua_Integer idx = 0;
+    geo_buffer_t *buf = buffer_check( L, &idx, 2 );
+
+    buf->lat[idx - 1] = luaL_checknumber( L, 3 );
+    buf->lon[idx - 1] = luaL_checknumber( L, 4 );
+    if( buf->ids && !lua_isnoneornil( L, 5 ) ){
+        buf->ids[idx - 1] = luaL_checkinteger( L, 5 );
+    }
+
+    return 0;
+}
+
+
+static int buffer_reserve_lua( lua_State *L )
+{
+    geo_buffer_t *buf = buffer_check( L, NULL, 0 );
+    lua_Integer cap = luaL_checkinteger( L, 2 );
+
+    luaL_argcheck( L, cap >= 0, 2, "unsigned integer expected" );
+    if( geo_buffer_reserve( buf, cap ) != 0 ){
+        return buffer_pusherror( L );
+    }
+    lua_pushboolean( L, 1 );
+
+    return 1;
+}
+
+
+static int buffer_resize_lua( lua_State *L )
+{
+    geo_buffer_t *buf = buffer_check( L, NULL, 0 );
+    lua_Integer len = luaL_checkinteger( L, 2 );
+
+    luaL_argcheck( L, len >= 0, 2, "unsigned integer expected" );
+    if( geo_buffer_resize( buf, len ) != 0 ){
+        return buffer_pusherror( L );
+    }
+    lua_pushboolean( L, 1 );
+
+    return 1;
+}
+
+
+static int buffer_clear_lua( lua_State *L )
+{
+    buffer_check( L, NULL, 0 )->len = 0;
+    return 0;
+}
+
+
+static int buffer_pointers_lua( lua_State *L )
+{
+    geo_buffer_t *buf = buffer_check( L, NULL, 0 );
+
+    lua_pushlightuserdata( L, buf->lat );
+    lua_pushlightuserdata( L, buf->lon );
+    if( buf->ids ){
+        lua_pushlightuserdata( L, buf->ids );
+        return 3;
+    }
+
+    return 2;
+}
+
+
+static int buffer_len_lua( lua_State *L )
+{
+    lua_pushinteger( L, (lua_Integer)buffer_check( L, NULL, 0 )->len );
+    return 1;
+}
+
+
+static int buffer_cap_lua( lua_State *L )
+{
+    lua_pushinteger( L, (lua_Integer)buffer_check( L, NULL, 0 )->cap );
+    return 1;
+}
+
+
+static int buffer_gc_lua( lua_State *L )
+{
+    geo_buffer_free( lua_touserdata( L, 1 ) );
+    return 0;
+}
+
+
+static int buffer_tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, GEO_BUFFER_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+// pushes the new buffer of the capacity.
+static geo_buffer_t *buffer_new( lua_State *L, size_t cap, int with_ids )
+{
+    geo_buffer_t *buf = lua_newuserdata( L, sizeof( geo_buffer_t ) );
+
+    *buf = (geo_buffer_t){ .with_ids = with_ids };
+    luaL_getmetatable( L, GEO_BUFFER_MT );
+    lua_setmetatable( L, -2 );
+    if( geo_buffer_reserve( buf, cap ) != 0 ){
+        return NULL;
+    }
+
+    return buf;
+}
+
+
+static int buffer_lua( lua_State *L )
+{
+    lua_Integer cap = luaL_optinteger( L, 1, 0 );
+    int with_ids = lua_toboolean( L, 2 );
+
+    luaL_argcheck( L, cap >= 0, 1, "unsigned integer expected" );
+    if( !buffer_new( L, cap, with_ids ) ){
+        return buffer_pusherror( L );
+    }
+
+    return 1;
+}
+
+
+// MARK: geo.reader
+#define GEO_READER_MT "geo.reader"
+
+// default number of rows of the buffer
+#define GEO_READER_ROWS     65536
+// default size of the read buffer of the file descriptor
+#define GEO_READER_BUFSIZE  65536
+
+typedef struct {
+    geo_reader_t parser;
+    // source file descriptor, or -1 if the source is the string
+    int fd;
+    int eof;
+    // source string or the read buffer of the file descriptor
+    const char *str;
+    size_t len;
+    size_t pos;
+    char *mem;
+    size_t memsize;
+    size_t rows;
+    // references of the source string and the buffer of the rows
+    int ref_str;
+    int ref_buf;
+} geo_reader_ud_t;
+
+
+// reads the next rows into the buffer.
+// returns the buffer that has no rows at the end of the source.
+static geo_buffer_t *reader_read( lua_State *L, geo_reader_ud_t *r )
+{
+    geo_buffer_t *buf = NULL;
+
+    lua_rawgeti( L, LUA_REGISTRYINDEX, r->ref_buf );
+    buf = lua_touserdata( L, -1 );
+    buf->len = 0;
+
+    while( buf->len < r->rows )
+    {
+        const char *p = r->fd == -1 ? r->str : r->mem;
+        ssize_t n = geo_reader_parse( &r->parser, buf, r->rows, p + r->pos,
+                                      r->len - r->pos, r->fd == -1 || r->eof );
+
+        r->pos += n;
+        if( r->parser.invalid )
+        {
+            // the rows before the invalid line are returned first, and the
+            // invalid line that skipped is reported by the next call
+            r->parser.invalid = 0;
+            if( !buf->len ){
+                errno = EINVAL;
+                return NULL;
+            }
+            break;
+        }
+        else if( buf->len == r->rows || r->fd == -1 || r->eof ){
+            break;
+        }
+
+        // move the incomplete line to the head and read the next chunk
+        memmove( r->mem, r->mem + r->pos, r->len - r->pos );
+        r->len -= r->pos;
+        r->pos = 0;
+        if( r->len == r->memsize ){
+            // the line is longer than the read buffer
+            errno = ENOBUFS;
+            return NULL;
+        }
+        while( ( n = read( r->fd, r->mem + r->len,
+                           r->memsize - r->len ) ) == -1 ){
+            if( errno != EINTR ){
+                return NULL;
+            }
+        }
+        r->len += n;
+        r->eof = n == 0;
+    }
+
+    return buf;
+}
+
+
+static int reader_read_lua( lua_State *L )
+{
+    geo_reader_ud_t *r = luaL_checkudata( L, 1, GEO_READER_MT );
+    geo_buffer_t *buf = reader_read( L, r );
+
+    if( !buf ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushinteger( L, (lua_Integer)r->parser.lineno );
+        return 3;
+    }
+    else if( !buf->len ){
+        lua_pushnil( L );
+    }
+
+    return 1;
+}
+
+
+static int reader_call_lua( lua_State *L )
+{
+    geo_reader_ud_t *r = luaL_checkudata( L, 1, GEO_READER_MT );
+    geo_buffer_t *buf = reader_read( L, r );
+
+    if( !buf ){
+        return luaL_error( L, "%s at line %d", strerror( errno ),
+                           (int)r->parser.lineno );
+    }
+    else if( !buf->len ){
+        lua_pushnil( L );
+    }
+
+    return 1;
+}
+
+
+static int reader_lineno_lua( lua_State *L )
+{
+    geo_reader_ud_t *r = luaL_checkudata( L, 1, GEO_READER_MT );
+
+    lua_pushinteger( L, (lua_Integer)r->parser.lineno );
+    return 1;
+}
+
+
+static int reader_gc_lua( lua_State *L )
+{
+    geo_reader_ud_t *r = lua_touserdata( L, 1 );
+
+    free( r->mem );
+    r->mem = NULL;
+    luaL_unref( L, LUA_REGISTRYINDEX, r->ref_str );
+    luaL_unref( L, LUA_REGISTRYINDEX, r->ref_buf );
+    r->ref_str = r->ref_buf = LUA_NOREF;
+
+    return 0;
+}
+
+
+static int reader_tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, GEO_READER_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+// gets the integer option of the field.
+static lua_Integer reader_optinteger( lua_State *L, const char *k,
+                                      lua_Integer def )
+{
+    lua_Integer v = def;
+
+    lua_getfield( L, 2, k );
+    if( !lua_isnil( L, -1 ) ){
+        if( lua_type( L, -1 ) != LUA_TNUMBER ){
+            luaL_argerror( L, 2, lua_pushfstring( L, "%s must be integer", k ) );
+        }
+        v = lua_tointeger( L, -1 );
+    }
+    lua_pop( L, 1 );
+
+    return v;
+}
+
+
+static void reader_setkey( lua_State *L, geo_reader_ud_t *r, int field,
+                           const char *k, const char *def )
+{
+    const char *name = def;
+    size_t len = strlen( def );
+
+    lua_getfield( L, 2, k );
+    if( lua_type( L, -1 ) == LUA_TSTRING ){
+        name = lua_tolstring( L, -1, &len );
+    }
+    // the id field can be disabled
+    else if( field == GEO_READER_ID && lua_type( L, -1 ) == LUA_TBOOLEAN &&
+             !lua_toboolean( L, -1 ) ){
+        len = 0;
+    }
+    else if( !lua_isnil( L, -1 ) ){
+        luaL_argerror( L, 2, lua_pushfstring( L, "%s must be string", k ) );
+    }
+    luaL_argcheck(
+        L, len <= GEO_READER_MAX_KEYLEN, 2, "key name is too long"
+    );
+    memcpy( r->parser.keys[field], name, len );
+    r->parser.keys[field][len] = 0;
+    lua_pop( L, 1 );
+}
+
+
+static int reader_lua( lua_State *L )
+{
+    static const char *const formats[] = { "csv", "ndjson", NULL };
+    int fd = -1;
+    geo_reader_ud_t *r = NULL;
+    lua_Integer rows = GEO_READER_ROWS;
+    lua_Integer memsize = GEO_READER_BUFSIZE;
+
+    if( lua_type( L, 1 ) == LUA_TNUMBER ){
+        lua_Integer v = lua_tointeger( L, 1 );
+
+        luaL_argcheck( L, v >= 0 && v <= INT32_MAX, 1,
+                       "file descriptor expected" );
+        fd = (int)v;
+    }
+    else {
+        luaL_checktype( L, 1, LUA_TSTRING );
+    }
+    if( lua_isnoneornil( L, 2 ) ){
+        lua_settop( L, 1 );
+        lua_newtable( L );
+    }
+    luaL_checktype( L, 2, LUA_TTABLE );
+
+    r = lua_newuserdata( L, sizeof( geo_reader_ud_t ) );
+    *r = (geo_reader_ud_t){
+        .fd = fd,
+        .ref_str = LUA_NOREF,
+        .ref_buf = LUA_NOREF
+    };
+    luaL_getmetatable( L, GEO_READER_MT );
+    lua_setmetatable( L, -2 );
+
+    lua_getfield( L, 2, "format" );
+    if( !lua_isnil( L, -1 ) )
+    {
+        const char *fmt = lua_tostring( L, -1 );
+
+        while( fmt && formats[r->parser.format] &&
+               strcmp( formats[r->parser.format], fmt ) != 0 ){
+            r->parser.format++;
+        }
+        luaL_argcheck(
+            L, fmt && formats[r->parser.format], 2,
+            "format must be 'csv' or 'ndjson'"
+        );
+    }
+    lua_pop( L, 1 );
+    if( r->parser.format == GEO_READER_CSV ){
+        r->parser.cols[GEO_READER_ID] = reader_optinteger( L, "id", 1 );
+        r->parser.cols[GEO_READER_LAT] = reader_optinteger( L, "lat", 2 );
+        r->parser.cols[GEO_READER_LON] = reader_optinteger( L, "lon", 3 );
+        luaL_argcheck(
+            L, r->parser.cols[GEO_READER_ID] >= 0 &&
+               r->parser.cols[GEO_READER_LAT] > 0 &&
+               r->parser.cols[GEO_READER_LON] > 0, 2,
+            "column number must be positive integer"
+        );
+    }
+    else {
+        reader_setkey( L, r, GEO_READER_ID, "id", "id" );
+        reader_setkey( L, r, GEO_READER_LAT, "lat", "lat" );
+        reader_setkey( L, r, GEO_READER_LON, "lon", "lon" );
+        luaL_argcheck(
+            L, r->parser.keys[GEO_READER_LAT][0] &&
+               r->parser.keys[GEO_READER_LON][0], 2,
+            "key name must not be empty"
+        );
+    }
+    lua_getfield( L, 2, "header" );
+    r->parser.header = lua_toboolean( L, -1 );
+    lua_pop( L, 1 );
+    rows = reader_optinteger( L, "rows", rows );
+    memsize = reader_optinteger( L, "bufsize", memsize );
+    luaL_argcheck(
+        L, rows > 0 && rows <= INT32_MAX && memsize > 0 &&
+           memsize <= INT32_MAX, 2, "rows and bufsize must be positive integer"
+    );
+    r->rows = rows;
+
+    if( fd == -1 ){
+        r->str = lua_tolstring( L, 1, &r->len );
+        lua_pushvalue( L, 1 );
+        r->ref_str = luaL_ref( L, LUA_REGISTRYINDEX );
+    }
+    else if( !( r->mem = malloc( memsize ) ) ){
+        return buffer_pusherror( L );
+    }
+    r->memsize = memsize;
+
+    if( !buffer_new( L, rows, 1 ) ){
+        return buffer_pusherror( L );
+    }
+    r->ref_buf = luaL_ref( L, LUA_REGISTRYINDEX );
+
+    return 1;
+}
+
+
 LUALIB_API int luaopen_geo( lua_State *L )
 {
     static struct luaL_Reg method[] = {
         { "encode", encode_lua },
         { "decode", decode_lua },
+        { "decode_into", decode_into_lua },
+        { "distance", distance_lua },
+        { "distance_many", distance_many_lua },
+        { "dest", dest_lua },
+        { "buffer", buffer_lua },
+        { "reader", reader_lua },
         { NULL, NULL }
     };
-    struct luaL_Reg *ptr = method;
+    static struct luaL_Reg dest_method[] = {
+        { "set_pivot", dest_set_pivot_lua },
+        { "set_angle", dest_set_angle_lua },
+        { "set_distance", dest_set_distance_lua },
+        { "get", dest_get_lua },
+        { "ring", dest_ring_lua },
+        { NULL, NULL }
+    };
+    static struct luaL_Reg buffer_method[] = {
+        { "push", buffer_push_lua },
+        { "append", buffer_append_lua },
+        { "get", buffer_get_lua },
+        { "set", buffer_set_lua },
+        { "reserve", buffer_reserve_lua },
+        { "resize", buffer_resize_lua },
+        { "clear", buffer_clear_lua },
+        { "pointers", buffer_pointers_lua },
+        { "len", buffer_len_lua },
+        { "cap", buffer_cap_lua },
+        { NULL, NULL }
+    };
+    static struct luaL_Reg reader_method[] = {
+        { "read", reader_read_lua },
+        { "lineno", reader_lineno_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg *ptr = dest_method;
+
+    geo_distance_kernel_init();
+
+    // create metatable of geo.dest
+    luaL_newmetatable( L, GEO_DEST_MT );
+    lstate_fn2tbl( L, "__tostring", dest_tostring_lua );
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    while( ptr->name ){
+        lstate_fn2tbl( L, ptr->name, ptr->func );
+        ptr++;
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    // create metatable of geo.buffer
+    ptr = buffer_method;
+    luaL_newmetatable( L, GEO_BUFFER_MT );
+    lstate_fn2tbl( L, "__gc", buffer_gc_lua );
+    lstate_fn2tbl( L, "__tostring", buffer_tostring_lua );
+    lstate_fn2tbl( L, "__len", buffer_len_lua );
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    while( ptr->name ){
+        lstate_fn2tbl( L, ptr->name, ptr->func );
+        ptr++;
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    // create metatable of geo.reader
+    ptr = reader_method;
+    luaL_newmetatable( L, GEO_READER_MT );
+    lstate_fn2tbl( L, "__gc", reader_gc_lua );
+    lstate_fn2tbl( L, "__tostring", reader_tostring_lua );
+    lstate_fn2tbl( L, "__call", reader_call_lua );
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    while( ptr->name ){
+        lstate_fn2tbl( L, ptr->name, ptr->func );
+        ptr++;
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    ptr = method;
 
     lua_newtable( L );
     while( ptr->name ){
         lstate_fn2tbl( L, ptr->name, ptr->func );
         ptr++;
     }
+    // name of the distance kernel selected for this cpu
+    lua_pushstring( L, "distance_kernel" );
+    lua_pushstring( L, geo_distance_kernel_name );
+    lua_rawset( L, -3 );
 
     return 1;
 }
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2013-2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/geo.h
+ *  lua-geo
+ *
+ *  common definitions of the geographic coordinates and the distance on the
+ *  WGS84 ellipsoid.
+ */
+
+#ifndef geo_h
+#define geo_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+
+
+#define GEO_IS_LAT_RANGE(l)         ( l >= -90 && l <= 90 )
+#define GEO_IS_LON_RANGE(l)         ( l >= -180 && l <= 180 )
+#define GEO_IS_LATLON_RANGE(la,lo) \
+    ( GEO_IS_LAT_RANGE(la) && GEO_IS_LON_RANGE( lo ) )
+
+// semi-major axis of ellipse
+#define GEO_WGS84MAJOR  6378137.0
+// semi-minor axis of ellipse
+#define GEO_WGS84MINOR  6356752.314245
+
+// eccentricity
+// ( GEO_WGS84MAJOR^2 - GEO_WGS84MINOR^2 ) / GEO_WGS84MAJOR^2 = 0.006694379990197
+#define GEO_ECCENTRICITY    0.006694379990197
+
+// meridian numerator
+//    = GEO_WGS84MAJOR * ( 1 - GEO_ECCENTRICITY )
+//    = 6378137.0 * 1- 0.006694379990197
+//    = 6335439.327292464877011
+#define GEO_MERIDIAN_NUM    6335439.327292464877011
+
+// lat_ave = ( org_lat_rad + dst_lat_rad ) / 2;
+// W = sqrt( 1 - GEO_ECCENTRICITY * lat_ave_sin^2 )
+// meridian curvature: GEO_MERIDIAN_NUM / pow( W, 3 )
+#define GEO_MERIDIAN(w)     (GEO_MERIDIAN_NUM/pow(w,3))
+// prime vertical: GEO_WGS84MAJOR / W
+#define GEO_PRIME_VERT(w)   (GEO_WGS84MAJOR/w)
+
+static const double GEO_RAD = M_PI/180;
+static const double GEO_DEG = 180/M_PI;
+static const double GEO_PI2 = M_PI*2;
+
+#define GEO_DEG2RAD(d)  (d*GEO_RAD)
+
+
+typedef struct {
+    double lat;
+    double lon;
+    double lat_rad;
+    double lon_rad;
+    double lat_sin;
+    double lat_cos;
+    double lon_sin;
+    double lon_cos;
+} geo_t;
+
+
+
+// view of the coordinates to be processed by the batch functions
+typedef struct {
+    const double *lat;
+    const double *lon;
+    // distance between consecutive elements in number of doubles
+    size_t stride;
+    size_t len;
+    // identifiers of the points or NULL
+    const int64_t *ids;
+} geo_coords_t;
+
+
+static inline int geo_init( geo_t *geo, double lat, double lon, int with_math )
+{
+    if( GEO_IS_LATLON_RANGE( lat, lon ) )
+    {
+        geo->lat = lat;
+        geo->lon = lon;
+        geo->lat_rad = GEO_DEG2RAD(lat);
+        geo->lon_rad = GEO_DEG2RAD(lon);
+        if( with_math ){
+            geo->lat_sin = sin( geo->lat_rad );
+            geo->lat_cos = cos( geo->lat_rad );
+            geo->lon_sin = sin( geo->lon_rad );
+            geo->lon_cos = cos( geo->lon_rad );
+        }
+        return 0;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+// merter
+static inline double geo_get_distance( const geo_t *from, const geo_t *dest )
+{
+    double lat_ave = ( from->lat_rad + dest->lat_rad ) / 2;
+    double W = sqrt( 1 - GEO_ECCENTRICITY * pow( sin( lat_ave ), 2 ) );
+    // shorter way around the antimeridian
+    double dlon = remainder( from->lon_rad - dest->lon_rad, GEO_PI2 );
+
+    return sqrt( pow( ( from->lat_rad - dest->lat_rad ) * GEO_MERIDIAN(W), 2 ) +
+                 pow( dlon * GEO_PRIME_VERT(W) * cos( lat_ave ), 2 ) );
+}
+
+
+#endif
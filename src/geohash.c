@@ -35,134 +35,221 @@
 #include <math.h>
 #include <errno.h>
 #include <string.h>
-#include "lauxhlib.h"
+#include "geohash.h"
+#include "coords.h"
+#include "pool.h"
+#include "cache.h"
 
 
-#define GEO_MAX_HASH_LEN    16
-#define GEO_IS_PRECISION_RANGE(p)   ( p > 0 && p < 17 )
-#define GEO_IS_LAT_RANGE(l)         ( l >= -90 && l <= 90 )
-#define GEO_IS_LON_RANGE(l)         ( l >= -180 && l <= 180 )
-#define GEO_IS_LATLON_RANGE(la,lo) \
-    ( GEO_IS_LAT_RANGE(la) && GEO_IS_LON_RANGE( la ) )
+// MARK: lua binding
+static int encode_lua( lua_State *L )
+{
+    int rc = 0;
+    double lat = luaL_checknumber( L, 1 );
+    double lon = luaL_checknumber( L, 2 );
+    uint8_t precision = (uint8_t)luaL_checknumber( L, 3 );
+    char hash[GEO_MAX_HASH_LEN+1] = {0};
 
+    // encode
+    if( geo_hash_encode( hash, lat, lon, precision ) ){
+        lua_pushstring( L, hash );
+        return 1;
+    }
 
-static const uint8_t GEO_BITMASK[5] = { 16, 8, 4, 2, 1 };
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
 
 
-static char *geo_hash_encode( char *hash, double lat, double lon, uint8_t precision )
+static int decode_lua( lua_State *L )
 {
-    if( !GEO_IS_PRECISION_RANGE( precision ) ||
-        !GEO_IS_LATLON_RANGE( lat, lon ) ){
-        errno = EINVAL;
-        return NULL;
+    size_t len = 0;
+    const char *hash = luaL_checklstring( L, 1, &len );
+    double lat = 0;
+    double lon = 0;
+
+    // decode
+    if( geo_hash_decode( hash, len, &lat, &lon ) == 0 ){
+        lua_pushnumber( L, lat );
+        lua_pushnumber( L, lon );
+        return 2;
     }
-    else
-    {
-        static const char geobase32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
-        double latlon[2][2] = { { -90.0, 90.0 }, { -180.0, 180.0 } };
-        double latlon_org[2] = { lat, lon };
-        int is_lon = 1;
-        double mid;
-        int bit = 0;
-        uint8_t idx = 0;
-        int i = 0;
-
-        // precision: 1 - 16
-        while( i < precision )
-        {
-            mid = ( latlon[is_lon][0] + latlon[is_lon][1] ) / 2;
-            if( latlon_org[is_lon] >= mid ){
-                idx |= GEO_BITMASK[bit];
-                latlon[is_lon][0] = mid;
-            }
-            else{
-                latlon[is_lon][1] = mid;
-            }
-            is_lon = !is_lon;
-
-            if( bit < 4 ){
-                bit++;
-            }
-            else {
-                hash[i++] = geobase32[idx];
-                bit = 0;
-                idx = 0;
-            }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 3;
+}
+
+
+static int decode_bbox_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *hash = luaL_checklstring( L, 1, &len );
+    double bbox[4];
+    double err[2];
+    int i = 0;
+
+    if( geo_hash_decode_bbox( hash, len, bbox, err ) != 0 ){
+        // got error
+        for(; i < 6; i++ ){
+            lua_pushnil( L );
         }
-        hash[i] = '\0';
+        lua_pushstring( L, strerror( errno ) );
+        return 7;
     }
+    for(; i < 4; i++ ){
+        lua_pushnumber( L, bbox[i] );
+    }
+    lua_pushnumber( L, err[0] );
+    lua_pushnumber( L, err[1] );
 
-    return hash;
+    return 6;
 }
 
 
-static int geo_hash_decode( const char *hash, size_t len, double *lat, double *lon )
+// job of the batch encoding.
+typedef struct {
+    geo_coords_t coords;
+    uint8_t precision;
+    char *hash;
+    // position of the first invalid coordinate
+    size_t err;
+} encode_batch_t;
+
+
+static void encode_batch_job( void *ctx, size_t head, size_t tail )
 {
-    if( GEO_IS_PRECISION_RANGE( len ) )
+    encode_batch_t *job = (encode_batch_t*)ctx;
+    geo_coords_t blk = job->coords;
+    size_t n = 0;
+
+    blk.lat += head * blk.stride;
+    blk.lon += head * blk.stride;
+    blk.len = tail - head;
+    n = geo_hash_encode_batch( job->hash + head * job->precision, &blk,
+                               job->precision );
+    if( n != blk.len ){
+        geo_pool_min( &job->err, head + n );
+    }
+}
+
+
+static int encode_batch_lua( lua_State *L )
+{
+    encode_batch_t job;
+    lua_Integer precision = lauxh_checkinteger( L, 2 );
+    int nthreads = geo_pool_checkthreads( L, 3 );
+
+    geo_checkcoords( L, 1, &job.coords );
+    lauxh_argcheck(
+        L, GEO_IS_PRECISION_RANGE( precision ), 2,
+        "1-16 expected, got an out of range value"
+    );
+
+    job.precision = (uint8_t)precision;
+    job.hash = lua_newuserdata( L, job.coords.len * precision + 1 );
+    job.err = SIZE_MAX;
+    geo_pool_run( nthreads, job.coords.len, GEO_POOL_CHUNK_SIZE,
+                  encode_batch_job, &job );
+    if( job.err != SIZE_MAX ){
+        // got error
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( EINVAL ) );
+        lua_pushinteger( L, (lua_Integer)job.err + 1 );
+        return 3;
+    }
+    lua_pushlstring( L, job.hash, job.coords.len * precision );
+
+    return 1;
+}
+
+
+// job of the batch decoding.
+typedef struct {
+    const char *hash;
+    size_t precision;
+    double *latlon;
+    // position of the first invalid hash
+    size_t err;
+} decode_batch_t;
+
+
+static void decode_batch_job( void *ctx, size_t head, size_t tail )
+{
+    decode_batch_t *job = (decode_batch_t*)ctx;
+    const char *hash = job->hash + head * job->precision;
+    double *latlon = job->latlon + head * 2;
+
+    for(; head < tail; head++ )
     {
-        static const unsigned char geohash32code[256] = {
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0,
-        //  0  1  2  3  4  5  6  7  8  9
-            1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
-            0, 0, 0, 0, 0, 0, 0, 0,
-        //  B   C   D   E   F   G   H      J   K      M   N      P   Q   R   S
-            11, 12, 13, 14, 15, 16, 17, 0, 18, 19, 0, 20, 21, 0, 22, 23, 24, 25,
-        //  T   U   V   W   X   Y   Z
-            26, 27, 28, 29, 30, 31, 32,
-            0
-        };
-        const unsigned char *code = (const unsigned char*)hash;
-        double latlon[2][2] = { { -90.0, 90.0 }, { -180.0, 180.0 } };
-        uint8_t c;
-        int is_lon = 1;
-        int mask = 0;
-        size_t i, j;
-
-        for( i = 0; i < len; i++ )
-        {
-            // to uppercase
-            c = ( code[i] > '`' && code[i] < '{' ) ? code[i] - 32 : code[i];
-            c = geohash32code[c];
-            // invalid charcode
-            if( !c ){
-                errno = EINVAL;
-                return -1;
-            }
-            // decode
-            for( j = 0; j < 5; j++ ){
-                mask = ( c - 1 ) & GEO_BITMASK[j];
-                latlon[is_lon][!mask] = ( latlon[is_lon][0] + latlon[is_lon][1] ) / 2;
-                is_lon = !is_lon;
-            }
+        if( geo_hash_decode( hash, job->precision, latlon, latlon + 1 ) != 0 ){
+            geo_pool_min( &job->err, head );
+            return;
         }
+        hash += job->precision;
+        latlon += 2;
+    }
+}
 
-        *lat = ( latlon[0][0] + latlon[0][1] ) / 2;
-        *lon = ( latlon[1][0] + latlon[1][1] ) / 2;
 
-        return 0;
-    }
-    else {
-        errno = EOVERFLOW;
+static int decode_batch_lua( lua_State *L )
+{
+    decode_batch_t job;
+    size_t len = 0;
+    lua_Integer precision = 0;
+    int nthreads = 0;
+
+    job.hash = lauxh_checklstring( L, 1, &len );
+    precision = lauxh_checkinteger( L, 2 );
+    nthreads = geo_pool_checkthreads( L, 3 );
+    lauxh_argcheck(
+        L, GEO_IS_PRECISION_RANGE( precision ), 2,
+        "1-16 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, len % precision == 0, 1,
+        "fixed-width hashes of length %d expected", (int)precision
+    );
+
+    len /= precision;
+    job.precision = precision;
+    job.latlon = lua_newuserdata( L, len * GEO_COORD_SIZE + 1 );
+    job.err = SIZE_MAX;
+    geo_pool_run( nthreads, len, GEO_POOL_CHUNK_SIZE, decode_batch_job, &job );
+    if( job.err != SIZE_MAX ){
+        // got error
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( EINVAL ) );
+        lua_pushinteger( L, (lua_Integer)job.err + 1 );
+        return 3;
     }
+    lua_pushlstring( L, (const char*)job.latlon, len * GEO_COORD_SIZE );
 
-    return -1;
+    return 1;
 }
 
 
-// MARK: lua binding
-static int encode_lua( lua_State *L )
+static int encode_int_lua( lua_State *L )
 {
-    int rc = 0;
-    double lat = luaL_checknumber( L, 1 );
-    double lon = luaL_checknumber( L, 2 );
-    uint8_t precision = (uint8_t)luaL_checknumber( L, 3 );
-    char hash[GEO_MAX_HASH_LEN+1] = {0};
+    double lat = lauxh_checknumber( L, 1 );
+    double lon = lauxh_checknumber( L, 2 );
+    lua_Integer bits = lauxh_optinteger( L, 3, GEO_HASH_INT_BITS );
+    uint64_t code = 0;
+
+    lauxh_argcheck(
+        L, GEO_IS_INT_BITS_RANGE( bits ), 3,
+        "1-62 expected, got an out of range value"
+    );
 
     // encode
-    if( geo_hash_encode( hash, lat, lon, precision ) ){
-        lua_pushstring( L, hash );
+    if( geo_hash_encode_int( &code, lat, lon, (uint8_t)bits ) == 0 ){
+        lua_pushinteger( L, (lua_Integer)code );
         return 1;
     }
 
@@ -174,34 +261,793 @@ static int encode_lua( lua_State *L )
 }
 
 
-static int decode_lua( lua_State *L )
+static int decode_int_lua( lua_State *L )
 {
-    size_t len = 0;
-    const char *hash = luaL_checklstring( L, 1, &len );
+    uint64_t code = (uint64_t)lauxh_checkinteger( L, 1 );
+    lua_Integer bits = lauxh_optinteger( L, 2, GEO_HASH_INT_BITS );
     double lat = 0;
     double lon = 0;
 
-    // decode
-    if( geo_hash_decode( hash, len, &lat, &lon ) == 0 ){
-        lua_pushnumber( L, lat );
-        lua_pushnumber( L, lon );
-        return 2;
+    lauxh_argcheck(
+        L, GEO_IS_INT_BITS_RANGE( bits ), 2,
+        "1-62 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, code >> bits == 0, 1, "%d bits code expected", (int)bits
+    );
+
+    geo_hash_decode_int( code, (uint8_t)bits, &lat, &lon );
+    lua_pushnumber( L, lat );
+    lua_pushnumber( L, lon );
+
+    return 2;
+}
+
+
+static int int2hash_lua( lua_State *L )
+{
+    uint64_t code = (uint64_t)lauxh_checkinteger( L, 1 );
+    lua_Integer bits = lauxh_optinteger( L, 2, GEO_HASH_INT_BITS );
+    char hash[GEO_MAX_HASH_LEN+1] = {0};
+
+    lauxh_argcheck(
+        L, GEO_IS_INT_BITS_RANGE( bits ) && bits % 5 == 0, 2,
+        "multiple of 5 in the range of 5-60 expected, got %d", (int)bits
+    );
+    lauxh_argcheck(
+        L, code >> bits == 0, 1, "%d bits code expected", (int)bits
+    );
+
+    geo_hash_format( hash, code << ( 64 - bits ), 0, (uint8_t)( bits / 5 ) );
+    lua_pushlstring( L, hash, bits / 5 );
+
+    return 1;
+}
+
+
+static int hash2int_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *hash = lauxh_checklstring( L, 1, &len );
+    uint64_t code = 0;
+    size_t i = 0;
+
+    lauxh_argcheck(
+        L, len > 0 && len * 5 <= GEO_HASH_INT_MAX_BITS, 1,
+        "length between 1 and 12 expected, got an out of range value"
+    );
+
+    for(; i < len; i++ )
+    {
+        uint8_t c = GEO_BASE32_CODE[(unsigned char)hash[i]];
+
+        // invalid charcode
+        if( !c ){
+            lua_pushnil( L );
+            lua_pushnil( L );
+            lua_pushstring( L, strerror( EINVAL ) );
+            return 3;
+        }
+        code = ( code << 5 ) | ( c - 1 );
+    }
+
+    lua_pushinteger( L, (lua_Integer)code );
+    lua_pushinteger( L, (lua_Integer)( len * 5 ) );
+
+    return 2;
+}
+
+
+// pushes the hash of the adjacent cell, or nil if it is beyond the pole.
+static void push_adjacent( lua_State *L, uint64_t qlat, uint64_t qlon,
+                           size_t len, geo_hash_dir_e dir )
+{
+    uint8_t nlat = len * 5 / 2;
+    uint64_t hi, lo;
+
+    if( geo_hash_adjacent( &qlat, &qlon, nlat, len * 5 - nlat, dir ) == 0 ){
+        char hash[GEO_MAX_HASH_LEN+1] = {0};
+
+        geo_hash_interleave( qlat, qlon, &hi, &lo );
+        geo_hash_format( hash, hi, lo, (uint8_t)len );
+        lua_pushlstring( L, hash, len );
+        return;
+    }
+    lua_pushnil( L );
+}
+
+
+static int neighbors_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *hash = lauxh_checklstring( L, 1, &len );
+    uint64_t qlat, qlon;
+    int dir = 0;
+
+    if( geo_hash_parse( hash, len, &qlat, &qlon ) == 0 ){
+        for(; dir < GEO_HASH_NDIR; dir++ ){
+            push_adjacent( L, qlat, qlon, len, dir );
+        }
+        return GEO_HASH_NDIR;
     }
 
     // got error
     lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int adjacent_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *hash = lauxh_checklstring( L, 1, &len );
+    int dir = luaL_checkoption( L, 2, NULL, GEO_HASH_DIR_NAMES );
+    uint64_t qlat, qlon;
+
+    if( geo_hash_parse( hash, len, &qlat, &qlon ) == 0 ){
+        push_adjacent( L, qlat, qlon, len, dir );
+        return 1;
+    }
+
+    // got error
     lua_pushnil( L );
     lua_pushstring( L, strerror( errno ) );
 
+    return 2;
+}
+
+
+// computes the codes of the adjacent cells of the cell of the specified bits.
+// the code of the cell beyond the pole is -1.
+static void adjacent_codes( int64_t *codes, uint64_t qlat, uint64_t qlon,
+                            uint8_t bits )
+{
+    uint8_t nlat = bits / 2;
+    int dir = 0;
+
+    for(; dir < GEO_HASH_NDIR; dir++ )
+    {
+        uint64_t alat = qlat;
+        uint64_t alon = qlon;
+        uint64_t hi, lo;
+
+        codes[dir] = -1;
+        if( geo_hash_adjacent( &alat, &alon, nlat, bits - nlat, dir ) == 0 ){
+            geo_hash_interleave( alat, alon, &hi, &lo );
+            codes[dir] = (int64_t)( hi >> ( 64 - bits ) );
+        }
+    }
+}
+
+
+static int push_codes( lua_State *L, const int64_t *codes )
+{
+    int dir = 0;
+
+    for(; dir < GEO_HASH_NDIR; dir++ ){
+        if( codes[dir] < 0 ){
+            lua_pushnil( L );
+        }
+        else {
+            lua_pushinteger( L, (lua_Integer)codes[dir] );
+        }
+    }
+
+    return GEO_HASH_NDIR;
+}
+
+
+static uint8_t checkcode( lua_State *L, int idx, uint64_t *code )
+{
+    lua_Integer bits = lauxh_optinteger( L, idx + 1, GEO_HASH_INT_BITS );
+
+    *code = (uint64_t)lauxh_checkinteger( L, idx );
+    lauxh_argcheck(
+        L, GEO_IS_INT_BITS_RANGE( bits ), idx + 1,
+        "1-62 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, *code >> bits == 0, idx, "%d bits code expected", (int)bits
+    );
+
+    return (uint8_t)bits;
+}
+
+
+static int neighbors_int_lua( lua_State *L )
+{
+    uint64_t code = 0;
+    uint8_t bits = checkcode( L, 1, &code );
+    uint64_t qlat, qlon;
+    int64_t codes[GEO_HASH_NDIR];
+
+    geo_hash_int2axis( code, bits, &qlat, &qlon );
+    adjacent_codes( codes, qlat, qlon, bits );
+
+    return push_codes( L, codes );
+}
+
+
+// pushes the array of the hashes of the cells that cover the region.
+static int push_cover( lua_State *L, size_t max_cells, uint8_t precision,
+                       geo_cover_classify_t classify, const void *region )
+{
+    geo_hash_cell_t *cells = lua_newuserdata(
+        L, sizeof( geo_hash_cell_t ) * GEO_HASH_COVER_SIZE( max_cells )
+    );
+    size_t ncell = geo_hash_cover( cells, max_cells, precision, classify,
+                                   region );
+    size_t i = 0;
+
+    lua_createtable( L, ncell, 0 );
+    for(; i < ncell; i++ )
+    {
+        char hash[GEO_MAX_HASH_LEN+1] = {0};
+        uint64_t hi, lo;
+
+        geo_hash_interleave( cells[i].qlat, cells[i].qlon, &hi, &lo );
+        geo_hash_format( hash, hi, lo, cells[i].len );
+        lua_pushlstring( L, hash, cells[i].len );
+        lua_rawseti( L, -2, i + 1 );
+    }
+
+    return 1;
+}
+
+
+static int cover_lua( lua_State *L )
+{
+    geo_bbox_t bbox = {
+        lauxh_checknumber( L, 1 ),
+        lauxh_checknumber( L, 2 ),
+        lauxh_checknumber( L, 3 ),
+        lauxh_checknumber( L, 4 )
+    };
+    lua_Integer max_cells = lauxh_checkinteger( L, 5 );
+    lua_Integer precision = lauxh_optinteger( L, 6, 12 );
+
+    lauxh_argcheck(
+        L, GEO_IS_LAT_RANGE( bbox.minlat ), 1,
+        "-90 to 90 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_LON_RANGE( bbox.minlon ), 2,
+        "-180 to 180 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_LAT_RANGE( bbox.maxlat ) && bbox.maxlat >= bbox.minlat, 3,
+        "minlat to 90 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_LON_RANGE( bbox.maxlon ), 4,
+        "-180 to 180 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, max_cells > 0 && max_cells <= INT32_MAX, 5,
+        "positive integer expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_PRECISION_RANGE( precision ), 6,
+        "1-16 expected, got an out of range value"
+    );
+
+    return push_cover( L, max_cells, precision, geo_bbox_classify, &bbox );
+}
+
+
+static int cover_radius_lua( lua_State *L )
+{
+    double lat = lauxh_checknumber( L, 1 );
+    double lon = lauxh_checknumber( L, 2 );
+    double radius = lauxh_checknumber( L, 3 );
+    lua_Integer max_cells = lauxh_checkinteger( L, 4 );
+    lua_Integer precision = lauxh_optinteger( L, 5, 12 );
+    geo_circle_t circle;
+
+    lauxh_argcheck(
+        L, GEO_IS_LAT_RANGE( lat ), 1,
+        "-90 to 90 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_LON_RANGE( lon ), 2,
+        "-180 to 180 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, radius >= 0, 3, "non-negative number expected, got %f", radius
+    );
+    lauxh_argcheck(
+        L, max_cells > 0 && max_cells <= INT32_MAX, 4,
+        "positive integer expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_PRECISION_RANGE( precision ), 5,
+        "1-16 expected, got an out of range value"
+    );
+
+    geo_circle_init( &circle, lat, lon, radius );
+    return push_cover( L, max_cells, precision, geo_circle_classify, &circle );
+}
+
+
+// MARK: geo.cache
+static int cache_neighbors_lua( lua_State *L )
+{
+    geo_cache_t *c = luaL_checkudata( L, 1, GEO_CACHE_MT );
+    size_t len = 0;
+    const char *hash = lauxh_checklstring( L, 2, &len );
+    uint8_t bits = len * 5;
+    uint64_t qlat, qlon, hi, lo;
+    geo_cache_value_t *v = NULL;
+    int dir = 0;
+
+    if( geo_hash_parse( hash, len, &qlat, &qlon ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    // the code of the longer hash does not fit in the key
+    else if( bits > GEO_HASH_INT_MAX_BITS ){
+        for(; dir < GEO_HASH_NDIR; dir++ ){
+            push_adjacent( L, qlat, qlon, len, dir );
+        }
+        return GEO_HASH_NDIR;
+    }
+
+    geo_hash_interleave( qlat, qlon, &hi, &lo );
+    hi >>= 64 - bits;
+    if( !( v = geo_cache_get( c, hi, GEO_CACHE_TAG( GEO_CACHE_NEIGHBORS,
+                                                     bits ) ) ) ){
+        v = geo_cache_put( c, hi, GEO_CACHE_TAG( GEO_CACHE_NEIGHBORS, bits ) );
+        adjacent_codes( v->codes, qlat, qlon, bits );
+    }
+    for(; dir < GEO_HASH_NDIR; dir++ )
+    {
+        char adj[GEO_MAX_HASH_LEN+1];
+
+        if( v->codes[dir] < 0 ){
+            lua_pushnil( L );
+            continue;
+        }
+        geo_hash_format( adj, (uint64_t)v->codes[dir] << ( 64 - bits ), 0,
+                         (uint8_t)len );
+        lua_pushlstring( L, adj, len );
+    }
+
+    return GEO_HASH_NDIR;
+}
+
+
+static int cache_neighbors_int_lua( lua_State *L )
+{
+    geo_cache_t *c = luaL_checkudata( L, 1, GEO_CACHE_MT );
+    uint64_t code = 0;
+    uint8_t bits = checkcode( L, 2, &code );
+    geo_cache_value_t *v = geo_cache_get(
+        c, code, GEO_CACHE_TAG( GEO_CACHE_NEIGHBORS, bits )
+    );
+
+    if( !v ){
+        uint64_t qlat, qlon;
+
+        v = geo_cache_put( c, code, GEO_CACHE_TAG( GEO_CACHE_NEIGHBORS,
+                                                   bits ) );
+        geo_hash_int2axis( code, bits, &qlat, &qlon );
+        adjacent_codes( v->codes, qlat, qlon, bits );
+    }
+
+    return push_codes( L, v->codes );
+}
+
+
+static int cache_decode_bbox_lua( lua_State *L )
+{
+    geo_cache_t *c = luaL_checkudata( L, 1, GEO_CACHE_MT );
+    size_t len = 0;
+    const char *hash = lauxh_checklstring( L, 2, &len );
+    uint8_t bits = len * 5;
+    uint64_t qlat, qlon, hi, lo;
+    geo_cache_value_t *v = NULL;
+    geo_cache_value_t tmp;
+    int i = 0;
+
+    if( geo_hash_parse( hash, len, &qlat, &qlon ) != 0 ){
+        for(; i < 6; i++ ){
+            lua_pushnil( L );
+        }
+        lua_pushstring( L, strerror( errno ) );
+        return 7;
+    }
+    // the code of the longer hash does not fit in the key
+    else if( bits > GEO_HASH_INT_MAX_BITS ){
+        v = &tmp;
+        geo_hash_decode_bbox( hash, len, v->v, v->v + 4 );
+    }
+    else
+    {
+        geo_hash_interleave( qlat, qlon, &hi, &lo );
+        hi >>= 64 - bits;
+        if( !( v = geo_cache_get( c, hi, GEO_CACHE_TAG( GEO_CACHE_BBOX,
+                                                         bits ) ) ) ){
+            v = geo_cache_put( c, hi, GEO_CACHE_TAG( GEO_CACHE_BBOX, bits ) );
+            geo_hash_decode_bbox( hash, len, v->v, v->v + 4 );
+        }
+    }
+    for(; i < 6; i++ ){
+        lua_pushnumber( L, v->v[i] );
+    }
+
+    return 6;
+}
+
+
+static int cache_stats_lua( lua_State *L )
+{
+    geo_cache_t *c = luaL_checkudata( L, 1, GEO_CACHE_MT );
+
+    lua_pushinteger( L, (lua_Integer)c->hits );
+    lua_pushinteger( L, (lua_Integer)c->misses );
+    lua_pushinteger( L, (lua_Integer)c->evictions );
+
     return 3;
 }
 
 
+static int cache_clear_lua( lua_State *L )
+{
+    geo_cache_clear( luaL_checkudata( L, 1, GEO_CACHE_MT ) );
+    return 0;
+}
+
+
+static int cache_len_lua( lua_State *L )
+{
+    geo_cache_t *c = luaL_checkudata( L, 1, GEO_CACHE_MT );
+
+    lua_pushinteger( L, (lua_Integer)c->len );
+
+    return 1;
+}
+
+
+static int cache_gc_lua( lua_State *L )
+{
+    geo_cache_free( lua_touserdata( L, 1 ) );
+    return 0;
+}
+
+
+static int cache_tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, GEO_CACHE_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+static int cache_lua( lua_State *L )
+{
+    lua_Integer size = lauxh_optinteger( L, 1, GEO_CACHE_SIZE );
+    lua_Integer precision = lauxh_optinteger( L, 2, GEO_CACHE_PRECISION );
+    geo_cache_t *c = NULL;
+
+    lauxh_argcheck(
+        L, size > 0 && size <= INT32_MAX, 1,
+        "positive integer expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, precision > 0 && precision * 5 <= GEO_HASH_INT_MAX_BITS, 2,
+        "1-12 expected, got an out of range value"
+    );
+
+    c = lua_newuserdata( L, sizeof( geo_cache_t ) );
+    *c = (geo_cache_t){ 0 };
+    luaL_getmetatable( L, GEO_CACHE_MT );
+    lua_setmetatable( L, -2 );
+    if( geo_cache_init( c, size, (uint8_t)precision ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+
+    return 1;
+}
+
+
+// MARK: geohash.buffer
+#define HASHBUF_MT  "geo.geohash.buffer"
+
+// growable array of the fixed-width hashes. the hashes are written in place,
+// so the repeated encoding does not create the strings.
+typedef struct {
+    char *hash;
+    size_t len;
+    size_t cap;
+    uint8_t precision;
+} hashbuf_t;
+
+
+static hashbuf_t *hashbuf_check( lua_State *L, lua_Integer *idx, int arg,
+                                 size_t max )
+{
+    hashbuf_t *hb = luaL_checkudata( L, 1, HASHBUF_MT );
+
+    if( idx ){
+        *idx = lauxh_optinteger( L, arg, hb->len + 1 );
+        lauxh_argcheck(
+            L, *idx >= 1 && (size_t)*idx <= hb->len + max, arg,
+            "index out of range"
+        );
+    }
+
+    return hb;
+}
+
+
+// grows the capacity of the buffer to at least cap hashes.
+static int hashbuf_reserve( hashbuf_t *hb, size_t cap )
+{
+    size_t newcap = hb->cap ? hb->cap : 16;
+    char *hash = NULL;
+
+    if( cap <= hb->cap ){
+        return 0;
+    }
+    while( newcap < cap ){
+        if( newcap > SIZE_MAX / 2 / GEO_MAX_HASH_LEN ){
+            errno = ENOMEM;
+            return -1;
+        }
+        newcap *= 2;
+    }
+    if( !( hash = realloc( hb->hash, newcap * hb->precision ) ) ){
+        return -1;
+    }
+    hb->hash = hash;
+    hb->cap = newcap;
+
+    return 0;
+}
+
+
+static int hashbuf_pusherror( lua_State *L )
+{
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    return 2;
+}
+
+
+static int hashbuf_encode_lua( lua_State *L )
+{
+    lua_Integer idx = 0;
+    hashbuf_t *hb = hashbuf_check( L, &idx, 4, 1 );
+    double lat = lauxh_checknumber( L, 2 );
+    double lon = lauxh_checknumber( L, 3 );
+    char hash[GEO_MAX_HASH_LEN+1];
+
+    if( !geo_hash_encode( hash, lat, lon, hb->precision ) ||
+        hashbuf_reserve( hb, idx ) != 0 ){
+        return hashbuf_pusherror( L );
+    }
+    memcpy( hb->hash + ( idx - 1 ) * hb->precision, hash, hb->precision );
+    if( (size_t)idx > hb->len ){
+        hb->len = idx;
+    }
+    lua_pushinteger( L, idx );
+
+    return 1;
+}
+
+
+static int hashbuf_encode_batch_lua( lua_State *L )
+{
+    hashbuf_t *hb = hashbuf_check( L, NULL, 0, 0 );
+    geo_coords_t coords;
+    size_t n = 0;
+
+    geo_checkcoords( L, 2, &coords );
+    if( hashbuf_reserve( hb, hb->len + coords.len ) != 0 ){
+        return hashbuf_pusherror( L );
+    }
+    n = geo_hash_encode_batch( hb->hash + hb->len * hb->precision, &coords,
+                               hb->precision );
+    hb->len += n;
+    if( n != coords.len ){
+        // got error
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushinteger( L, (lua_Integer)n + 1 );
+        return 3;
+    }
+    lua_pushinteger( L, (lua_Integer)hb->len );
+
+    return 1;
+}
+
+
+static int hashbuf_get_lua( lua_State *L )
+{
+    lua_Integer idx = 0;
+    hashbuf_t *hb = hashbuf_check( L, &idx, 2, 0 );
+
+    lua_pushlstring( L, hb->hash + ( idx - 1 ) * hb->precision,
+                     hb->precision );
+
+    return 1;
+}
+
+
+static int hashbuf_decode_lua( lua_State *L )
+{
+    lua_Integer idx = 0;
+    hashbuf_t *hb = hashbuf_check( L, &idx, 2, 0 );
+    double lat = 0;
+    double lon = 0;
+
+    // the hashes in the buffer are always valid
+    geo_hash_decode( hb->hash + ( idx - 1 ) * hb->precision, hb->precision,
+                     &lat, &lon );
+    lua_pushnumber( L, lat );
+    lua_pushnumber( L, lon );
+
+    return 2;
+}
+
+
+static int hashbuf_data_lua( lua_State *L )
+{
+    hashbuf_t *hb = hashbuf_check( L, NULL, 0, 0 );
+
+    lua_pushlstring( L, hb->hash ? hb->hash : "", hb->len * hb->precision );
+
+    return 1;
+}
+
+
+static int hashbuf_pointer_lua( lua_State *L )
+{
+    lua_pushlightuserdata( L, hashbuf_check( L, NULL, 0, 0 )->hash );
+    return 1;
+}
+
+
+static int hashbuf_clear_lua( lua_State *L )
+{
+    hashbuf_check( L, NULL, 0, 0 )->len = 0;
+    return 0;
+}
+
+
+static int hashbuf_len_lua( lua_State *L )
+{
+    lua_pushinteger( L, (lua_Integer)hashbuf_check( L, NULL, 0, 0 )->len );
+    return 1;
+}
+
+
+static int hashbuf_gc_lua( lua_State *L )
+{
+    free( ( (hashbuf_t*)lua_touserdata( L, 1 ) )->hash );
+    return 0;
+}
+
+
+static int hashbuf_tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, HASHBUF_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+static int hashbuf_lua( lua_State *L )
+{
+    lua_Integer precision = lauxh_checkinteger( L, 1 );
+    lua_Integer cap = lauxh_optinteger( L, 2, 0 );
+    hashbuf_t *hb = NULL;
+
+    lauxh_argcheck(
+        L, GEO_IS_PRECISION_RANGE( precision ), 1,
+        "1-16 expected, got an out of range value"
+    );
+    lauxh_argcheck( L, cap >= 0, 2, "unsigned integer expected" );
+
+    hb = lua_newuserdata( L, sizeof( hashbuf_t ) );
+    *hb = (hashbuf_t){ .precision = (uint8_t)precision };
+    luaL_getmetatable( L, HASHBUF_MT );
+    lua_setmetatable( L, -2 );
+    if( hashbuf_reserve( hb, cap ) != 0 ){
+        return hashbuf_pusherror( L );
+    }
+
+    return 1;
+}
+
+
 LUALIB_API int luaopen_geo_geohash( lua_State *L )
 {
-    lua_createtable( L, 0, 2 );
+    struct luaL_Reg mmethod[] = {
+        { "__gc", hashbuf_gc_lua },
+        { "__tostring", hashbuf_tostring_lua },
+        { "__len", hashbuf_len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "encode", hashbuf_encode_lua },
+        { "encode_batch", hashbuf_encode_batch_lua },
+        { "get", hashbuf_get_lua },
+        { "decode", hashbuf_decode_lua },
+        { "data", hashbuf_data_lua },
+        { "pointer", hashbuf_pointer_lua },
+        { "clear", hashbuf_clear_lua },
+        { "len", hashbuf_len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg cache_mmethod[] = {
+        { "__gc", cache_gc_lua },
+        { "__tostring", cache_tostring_lua },
+        { "__len", cache_len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg cache_method[] = {
+        { "neighbors", cache_neighbors_lua },
+        { "neighbors_int", cache_neighbors_int_lua },
+        { "decode_bbox", cache_decode_bbox_lua },
+        { "stats", cache_stats_lua },
+        { "clear", cache_clear_lua },
+        { "len", cache_len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg *ptr = mmethod;
+
+    geo_hash_kernel_init();
+    geo_pool_open( L );
+
+    // create metatable of geohash.buffer
+    luaL_newmetatable( L, HASHBUF_MT );
+    for(; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    for( ptr = method; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    // create metatable of geo.cache
+    luaL_newmetatable( L, GEO_CACHE_MT );
+    for( ptr = cache_mmethod; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    for( ptr = cache_method; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    lua_createtable( L, 0, 17 );
     lauxh_pushfn2tbl( L, "encode", encode_lua );
     lauxh_pushfn2tbl( L, "decode", decode_lua );
+    lauxh_pushfn2tbl( L, "encode_batch", encode_batch_lua );
+    lauxh_pushfn2tbl( L, "decode_batch", decode_batch_lua );
+    lauxh_pushfn2tbl( L, "encode_int", encode_int_lua );
+    lauxh_pushfn2tbl( L, "decode_bbox", decode_bbox_lua );
+    lauxh_pushfn2tbl( L, "decode_int", decode_int_lua );
+    lauxh_pushfn2tbl( L, "int2hash", int2hash_lua );
+    lauxh_pushfn2tbl( L, "hash2int", hash2int_lua );
+    lauxh_pushfn2tbl( L, "neighbors", neighbors_lua );
+    lauxh_pushfn2tbl( L, "adjacent", adjacent_lua );
+    lauxh_pushfn2tbl( L, "neighbors_int", neighbors_int_lua );
+    lauxh_pushfn2tbl( L, "cover", cover_lua );
+    lauxh_pushfn2tbl( L, "cover_radius", cover_radius_lua );
+    lauxh_pushfn2tbl( L, "buffer", hashbuf_lua );
+    lauxh_pushfn2tbl( L, "cache", cache_lua );
+    // name of the batch kernel selected for this cpu
+    lauxh_pushstr2tbl( L, "kernel", geo_hash_kernel_name );
 
     return 1;
 }
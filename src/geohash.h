@@ -0,0 +1,1073 @@
+/*
+ *  Copyright (C) 2013-2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/geohash.h
+ *  lua-geo
+ *
+ *  geohash kernels shared by the modules.
+ */
+
+#ifndef geo_geohash_h
+#define geo_geohash_h
+
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <string.h>
+#include "geo.h"
+#include "cover.h"
+#if defined(__x86_64__) && ( defined(__GNUC__) || defined(__clang__) ) && \
+    !defined(GEO_HASH_NO_SIMD)
+#define GEO_HASH_X86_SIMD
+#include <immintrin.h>
+#elif defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+
+#define GEO_MAX_HASH_LEN    16
+#define GEO_IS_PRECISION_RANGE(p)   ( p > 0 && p < 17 )
+
+
+// number of bits of the quantized latitude and longitude.
+// 40 bits of each axis are enough to represent the 16 characters hash.
+#define GEO_HASH_AXIS_BITS  40
+#define GEO_HASH_AXIS_CELLS ( (uint64_t)1 << GEO_HASH_AXIS_BITS )
+// max number of bits of the integer geohash.
+// it is limited to 62 bits to keep the code as a positive lua_Integer.
+#define GEO_HASH_INT_MAX_BITS   62
+#define GEO_HASH_INT_BITS       60
+#define GEO_IS_INT_BITS_RANGE(b)    ( b > 0 && b <= GEO_HASH_INT_MAX_BITS )
+
+static const char GEO_BASE32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+// base32 character code to the 5 bits value plus 1. 0 is an invalid character.
+static const unsigned char GEO_BASE32_CODE[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0,
+//  0  1  2  3  4  5  6  7  8  9
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+    0, 0, 0, 0, 0, 0, 0, 0,
+//  B   C   D   E   F   G   H      J   K      M   N      P   Q   R   S
+    11, 12, 13, 14, 15, 16, 17, 0, 18, 19, 0, 20, 21, 0, 22, 23, 24, 25,
+//  T   U   V   W   X   Y   Z
+    26, 27, 28, 29, 30, 31, 32,
+    0, 0, 0, 0, 0, 0, 0,
+//  b   c   d   e   f   g   h      j   k      m   n      p   q   r   s
+    11, 12, 13, 14, 15, 16, 17, 0, 18, 19, 0, 20, 21, 0, 22, 23, 24, 25,
+//  t   u   v   w   x   y   z
+    26, 27, 28, 29, 30, 31, 32,
+    0
+};
+
+
+// quantizes the value into the index of the GEO_HASH_AXIS_CELLS cells of the
+// specified range.
+// the result is equivalent to the bisection of the range, that is, the index
+// of the last cell whose lower bound is less than or equal to the value.
+static inline uint64_t geo_hash_quantize( double v, double vmin, double vrange )
+{
+    // the cell size and its boundaries are exactly representable.
+    double unit = vrange / GEO_HASH_AXIS_CELLS;
+    double q = floor( ( v - vmin ) / unit );
+    double lower = 0;
+
+    // correct the rounding error of the subtraction
+    lower = q * unit + vmin;
+    q -= ( v < lower );
+    q += ( v >= lower + unit );
+
+    return (uint64_t)fmin( fmax( q, 0 ), GEO_HASH_AXIS_CELLS - 1 );
+}
+
+
+// spreads the 32 bits value to the even bits of the 64 bits value.
+static inline uint64_t geo_hash_spread( uint32_t v )
+{
+#if defined(__BMI2__)
+    return _pdep_u64( v, 0x5555555555555555ULL );
+#else
+    uint64_t x = v;
+
+    x = ( x | ( x << 16 ) ) & 0x0000FFFF0000FFFFULL;
+    x = ( x | ( x << 8 ) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x | ( x << 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+    x = ( x | ( x << 2 ) ) & 0x3333333333333333ULL;
+    x = ( x | ( x << 1 ) ) & 0x5555555555555555ULL;
+
+    return x;
+#endif
+}
+
+
+// gathers the even bits of the 64 bits value into the 32 bits value.
+static inline uint32_t geo_hash_squash( uint64_t x )
+{
+#if defined(__BMI2__)
+    return (uint32_t)_pext_u64( x, 0x5555555555555555ULL );
+#else
+    x &= 0x5555555555555555ULL;
+    x = ( x | ( x >> 1 ) ) & 0x3333333333333333ULL;
+    x = ( x | ( x >> 2 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+    x = ( x | ( x >> 4 ) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x | ( x >> 8 ) ) & 0x0000FFFF0000FFFFULL;
+    x = ( x | ( x >> 16 ) ) & 0x00000000FFFFFFFFULL;
+
+    return (uint32_t)x;
+#endif
+}
+
+
+// interleaves the quantized latitude and longitude into the 80 bits code.
+// the longitude bit comes first as same as the geohash.
+// hi: upper 64 bits of the code.
+// lo: lower 16 bits of the code.
+static inline void geo_hash_interleave( uint64_t qlat, uint64_t qlon,
+                                        uint64_t *hi, uint64_t *lo )
+{
+    *hi = ( geo_hash_spread( (uint32_t)( qlon >> 8 ) ) << 1 ) |
+          geo_hash_spread( (uint32_t)( qlat >> 8 ) );
+    *lo = ( geo_hash_spread( (uint32_t)( qlon & 0xFF ) ) << 1 ) |
+          geo_hash_spread( (uint32_t)( qlat & 0xFF ) );
+}
+
+
+// formats the 80 bits code into the base32 string.
+static inline void geo_hash_format( char *hash, uint64_t hi, uint64_t lo,
+                                    uint8_t precision )
+{
+    // lower 16 bits of the code follow the upper 60 bits of the code
+    uint64_t tail = ( ( hi & 0xF ) << 16 ) | lo;
+    uint8_t i = 0;
+
+    for(; i < precision && i < 12; i++ ){
+        hash[i] = GEO_BASE32[( hi >> ( 59 - i * 5 ) ) & 0x1F];
+    }
+    for(; i < precision; i++ ){
+        hash[i] = GEO_BASE32[( tail >> ( 75 - i * 5 ) ) & 0x1F];
+    }
+    hash[i] = '\0';
+}
+
+
+static inline void geo_hash_quantize_latlon( double lat, double lon,
+                                             uint64_t *qlat, uint64_t *qlon )
+{
+    *qlat = geo_hash_quantize( lat, -90.0, 180.0 );
+    *qlon = geo_hash_quantize( lon, -180.0, 360.0 );
+}
+
+
+static inline char *geo_hash_encode( char *hash, double lat, double lon,
+                                      uint8_t precision )
+{
+    if( !GEO_IS_PRECISION_RANGE( precision ) ||
+        !GEO_IS_LATLON_RANGE( lat, lon ) ){
+        errno = EINVAL;
+        return NULL;
+    }
+    else
+    {
+        uint64_t qlat, qlon, hi, lo;
+
+        geo_hash_quantize_latlon( lat, lon, &qlat, &qlon );
+        geo_hash_interleave( qlat, qlon, &hi, &lo );
+        geo_hash_format( hash, hi, lo, precision );
+    }
+
+    return hash;
+}
+
+
+// encodes the coordinates into the integer geohash of the specified bits.
+static inline int geo_hash_encode_int( uint64_t *code, double lat, double lon,
+                                       uint8_t bits )
+{
+    if( !GEO_IS_INT_BITS_RANGE( bits ) || !GEO_IS_LATLON_RANGE( lat, lon ) ){
+        errno = EINVAL;
+        return -1;
+    }
+    else
+    {
+        uint64_t qlat, qlon, hi, lo;
+
+        geo_hash_quantize_latlon( lat, lon, &qlat, &qlon );
+        geo_hash_interleave( qlat, qlon, &hi, &lo );
+        *code = hi >> ( 64 - bits );
+    }
+
+    return 0;
+}
+
+
+// splits the integer geohash of the specified bits into the left-aligned
+// cell indices of each axis.
+static inline void geo_hash_int2axis( uint64_t code, uint8_t bits,
+                                      uint64_t *qlat, uint64_t *qlon )
+{
+    uint64_t hi = code << ( 64 - bits );
+
+    *qlat = (uint64_t)geo_hash_squash( hi ) << 8;
+    *qlon = (uint64_t)geo_hash_squash( hi >> 1 ) << 8;
+}
+
+
+// decodes the integer geohash of the specified bits into the center of the
+// cell.
+static inline void geo_hash_decode_int( uint64_t code, uint8_t bits,
+                                        double *lat, double *lon )
+{
+    uint64_t qlat, qlon;
+    // half of the cell size of each axis
+    uint64_t hlat = (uint64_t)1 << ( GEO_HASH_AXIS_BITS - 1 - bits / 2 );
+    uint64_t hlon = (uint64_t)1 << ( GEO_HASH_AXIS_BITS - 1 - ( bits + 1 ) / 2 );
+
+    geo_hash_int2axis( code, bits, &qlat, &qlon );
+    *lat = (double)( qlat + hlat ) * ( 180.0 / GEO_HASH_AXIS_CELLS ) - 90.0;
+    *lon = (double)( qlon + hlon ) * ( 360.0 / GEO_HASH_AXIS_CELLS ) - 180.0;
+}
+
+
+// parses the geohash string into the cell indices of each axis and the
+// number of bits of each axis.
+// each character is mapped to its 5 bits by the table, and the bits are
+// distributed to the axes without the floating point operations; the even
+// characters contain 3 bits of the longitude and 2 bits of the latitude,
+// and the odd characters contain 2 bits of the longitude and 3 bits of the
+// latitude.
+static inline int geo_hash_decode_cell( const char *hash, size_t len,
+                                        uint64_t *qlat, uint64_t *qlon,
+                                        int *latbits, int *lonbits )
+{
+    const unsigned char *code = (const unsigned char*)hash;
+    uint64_t axis[2] = { 0, 0 };
+    size_t i = 0;
+
+    if( !GEO_IS_PRECISION_RANGE( len ) ){
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    for(; i < len; i++ )
+    {
+        unsigned int c = GEO_BASE32_CODE[code[i]];
+        int odd = i & 1;
+
+        // invalid charcode
+        if( !c ){
+            errno = EINVAL;
+            return -1;
+        }
+        c--;
+        // bits 4, 2 and 0
+        axis[odd] = ( axis[odd] << 3 ) | ( ( c >> 2 ) & 4 ) |
+                    ( ( c >> 1 ) & 2 ) | ( c & 1 );
+        // bits 3 and 1
+        axis[!odd] = ( axis[!odd] << 2 ) | ( ( c >> 2 ) & 2 ) |
+                     ( ( c >> 1 ) & 1 );
+    }
+
+    *qlon = axis[0];
+    *qlat = axis[1];
+    *latbits = (int)( len * 5 / 2 );
+    *lonbits = (int)( len * 5 ) - *latbits;
+
+    return 0;
+}
+
+
+// decodes the geohash string into the center of the cell.
+static inline int geo_hash_decode( const char *hash, size_t len, double *lat,
+                                   double *lon )
+{
+    uint64_t qlat, qlon;
+    int latbits, lonbits;
+
+    if( geo_hash_decode_cell( hash, len, &qlat, &qlon, &latbits,
+                              &lonbits ) != 0 ){
+        return -1;
+    }
+    // the cells are the exact binary fractions of the ranges
+    *lat = ( (double)qlat + 0.5 ) * ldexp( 180.0, -latbits ) - 90.0;
+    *lon = ( (double)qlon + 0.5 ) * ldexp( 360.0, -lonbits ) - 180.0;
+
+    return 0;
+}
+
+
+// decodes the geohash string into the bounding box of the cell and the
+// maximum errors of the center of the cell.
+// bbox: minlat, minlon, maxlat, maxlon
+// err: errors of the latitude and the longitude
+static inline int geo_hash_decode_bbox( const char *hash, size_t len,
+                                        double bbox[4], double err[2] )
+{
+    uint64_t qlat, qlon;
+    int latbits, lonbits;
+    double latsize, lonsize;
+
+    if( geo_hash_decode_cell( hash, len, &qlat, &qlon, &latbits,
+                              &lonbits ) != 0 ){
+        return -1;
+    }
+    latsize = ldexp( 180.0, -latbits );
+    lonsize = ldexp( 360.0, -lonbits );
+    bbox[0] = (double)qlat * latsize - 90.0;
+    bbox[1] = (double)qlon * lonsize - 180.0;
+    bbox[2] = (double)( qlat + 1 ) * latsize - 90.0;
+    bbox[3] = (double)( qlon + 1 ) * lonsize - 180.0;
+    err[0] = latsize / 2;
+    err[1] = lonsize / 2;
+
+    return 0;
+}
+
+
+// parses the geohash string into the left-aligned cell indices of each axis.
+static inline int geo_hash_parse( const char *hash, size_t len, uint64_t *qlat,
+                                  uint64_t *qlon )
+{
+    const unsigned char *code = (const unsigned char*)hash;
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    uint64_t c = 0;
+    size_t i = 0;
+
+    if( !GEO_IS_PRECISION_RANGE( len ) ){
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    for(; i < len; i++ )
+    {
+        c = GEO_BASE32_CODE[code[i]];
+        // invalid charcode
+        if( !c ){
+            errno = EINVAL;
+            return -1;
+        }
+        c--;
+        // same layout as geo_hash_format
+        if( i < 12 ){
+            hi |= c << ( 59 - i * 5 );
+        }
+        else if( i == 12 ){
+            hi |= c >> 1;
+            lo |= ( c & 1 ) << 15;
+        }
+        else {
+            lo |= c << ( 75 - i * 5 );
+        }
+    }
+
+    *qlat = ( (uint64_t)geo_hash_squash( hi ) << 8 ) | geo_hash_squash( lo );
+    *qlon = ( (uint64_t)geo_hash_squash( hi >> 1 ) << 8 ) |
+            geo_hash_squash( lo >> 1 );
+
+    return 0;
+}
+
+
+// direction of the adjacent cell
+typedef enum {
+    GEO_HASH_DIR_N = 0,
+    GEO_HASH_DIR_NE,
+    GEO_HASH_DIR_E,
+    GEO_HASH_DIR_SE,
+    GEO_HASH_DIR_S,
+    GEO_HASH_DIR_SW,
+    GEO_HASH_DIR_W,
+    GEO_HASH_DIR_NW,
+    GEO_HASH_NDIR
+} geo_hash_dir_e;
+
+static const char *const GEO_HASH_DIR_NAMES[] = {
+    "n", "ne", "e", "se", "s", "sw", "w", "nw", NULL
+};
+
+static const int GEO_HASH_DIR_DELTA[GEO_HASH_NDIR][2] = {
+    //  lat lon
+    {  1,  0 }, // n
+    {  1,  1 }, // ne
+    {  0,  1 }, // e
+    { -1,  1 }, // se
+    { -1,  0 }, // s
+    { -1, -1 }, // sw
+    {  0, -1 }, // w
+    {  1, -1 }  // nw
+};
+
+
+// moves the left-aligned cell indices to the adjacent cell of the specified
+// direction.
+// nlat: number of bits of the latitude.
+// nlon: number of bits of the longitude.
+// returns -1 if the adjacent cell is beyond the pole, the longitude is wrapped
+// around the antimeridian.
+static inline int geo_hash_adjacent( uint64_t *qlat, uint64_t *qlon,
+                                     uint8_t nlat, uint8_t nlon,
+                                     geo_hash_dir_e dir )
+{
+    uint64_t slat = (uint64_t)1 << ( GEO_HASH_AXIS_BITS - nlat );
+    uint64_t slon = (uint64_t)1 << ( GEO_HASH_AXIS_BITS - nlon );
+
+    switch( GEO_HASH_DIR_DELTA[dir][0] ){
+        case 1:
+            if( GEO_HASH_AXIS_CELLS - *qlat <= slat ){
+                return -1;
+            }
+            *qlat += slat;
+        break;
+        case -1:
+            if( *qlat < slat ){
+                return -1;
+            }
+            *qlat -= slat;
+        break;
+    }
+    *qlon = ( *qlon + GEO_HASH_DIR_DELTA[dir][1] * slon ) &
+            ( GEO_HASH_AXIS_CELLS - 1 );
+
+    return 0;
+}
+
+
+// MARK: cell cover
+// classification of the cell against the region
+
+// classifies the cell [minlat, maxlat) x [minlon, maxlon) against the region.
+// it must never return GEO_COVER_OUTSIDE for the cell that intersects the
+// region.
+typedef geo_cover_e (*geo_cover_classify_t)( const void *region,
+                                             double minlat, double minlon,
+                                             double maxlat, double maxlon );
+
+// bounding box. minlon is greater than maxlon if it crosses the antimeridian.
+typedef struct {
+    double minlat;
+    double minlon;
+    double maxlat;
+    double maxlon;
+} geo_bbox_t;
+
+// cell of the cover
+typedef struct {
+    // left-aligned cell indices of each axis
+    uint64_t qlat;
+    uint64_t qlon;
+    uint8_t len;
+} geo_hash_cell_t;
+
+
+// classifies the half-open interval [lo, hi) against the closed interval
+// [min, max]. the interval is closed if hi is the end of the axis.
+static inline geo_cover_e geo_cover_interval( double lo, double hi, double end,
+                                              double min, double max )
+{
+    if( lo > max || hi < min || ( hi == min && hi != end ) ){
+        return GEO_COVER_OUTSIDE;
+    }
+    else if( lo >= min && hi <= max ){
+        return GEO_COVER_INSIDE;
+    }
+
+    return GEO_COVER_PARTIAL;
+}
+
+
+static inline geo_cover_e geo_bbox_classify( const void *region,
+                                             double minlat, double minlon,
+                                             double maxlat, double maxlon )
+{
+    const geo_bbox_t *bbox = (const geo_bbox_t*)region;
+    geo_cover_e clat = geo_cover_interval( minlat, maxlat, 90, bbox->minlat,
+                                           bbox->maxlat );
+    geo_cover_e clon = GEO_COVER_OUTSIDE;
+
+    if( clat == GEO_COVER_OUTSIDE ){
+        return GEO_COVER_OUTSIDE;
+    }
+    else if( bbox->minlon <= bbox->maxlon ){
+        clon = geo_cover_interval( minlon, maxlon, 180, bbox->minlon,
+                                   bbox->maxlon );
+    }
+    // crosses the antimeridian. the cell never spans the antimeridian.
+    else {
+        geo_cover_e east = geo_cover_interval( minlon, maxlon, 180,
+                                               bbox->minlon, 180 );
+        geo_cover_e west = geo_cover_interval( minlon, maxlon, 180,
+                                               -180, bbox->maxlon );
+        clon = east > west ? east : west;
+    }
+
+    return clat < clon ? clat : clon;
+}
+
+
+// circle on the sphere
+typedef struct {
+    double lat_rad;
+    double lon_rad;
+    double lat_cos;
+    // angular radius on the smallest and the largest radius of curvature of
+    // the WGS84 ellipsoid that used for the conservative classification.
+    double dist_min;
+    double dist_max;
+    geo_bbox_t bbox;
+} geo_circle_t;
+
+// smallest radius of curvature of the WGS84 ellipsoid (meridian at equator)
+#define GEO_CURVATURE_MIN   GEO_MERIDIAN_NUM
+// largest radius of curvature of the WGS84 ellipsoid (at poles)
+#define GEO_CURVATURE_MAX   6399593.625758493
+
+
+static inline void geo_circle_init( geo_circle_t *c, double lat, double lon,
+                                    double radius )
+{
+    double dist_deg = 0;
+
+    c->lat_rad = lat * GEO_RAD;
+    c->lon_rad = lon * GEO_RAD;
+    c->lat_cos = cos( c->lat_rad );
+    c->dist_min = radius / GEO_CURVATURE_MAX;
+    c->dist_max = radius / GEO_CURVATURE_MIN;
+    dist_deg = c->dist_max * GEO_DEG;
+
+    // bounding box of the circle
+    c->bbox.minlat = lat - dist_deg;
+    c->bbox.maxlat = lat + dist_deg;
+    if( c->bbox.minlat <= -90 || c->bbox.maxlat >= 90 ||
+        sin( c->dist_max ) >= c->lat_cos ){
+        // contains the pole
+        c->bbox.minlat = fmax( c->bbox.minlat, -90 );
+        c->bbox.maxlat = fmin( c->bbox.maxlat, 90 );
+        c->bbox.minlon = -180;
+        c->bbox.maxlon = 180;
+    }
+    else {
+        double dlon = asin( sin( c->dist_max ) / c->lat_cos ) * GEO_DEG;
+
+        c->bbox.minlon = lon - dlon;
+        c->bbox.maxlon = lon + dlon;
+        if( c->bbox.minlon < -180 ){
+            c->bbox.minlon += 360;
+        }
+        if( c->bbox.maxlon > 180 ){
+            c->bbox.maxlon -= 360;
+        }
+    }
+}
+
+
+// angular distance between the center of the circle and the point
+static inline double geo_circle_distance( const geo_circle_t *c, double lat_rad,
+                                          double lon_rad )
+{
+    double slat = sin( ( lat_rad - c->lat_rad ) / 2 );
+    double slon = sin( ( lon_rad - c->lon_rad ) / 2 );
+    double h = slat * slat + c->lat_cos * cos( lat_rad ) * slon * slon;
+
+    return 2 * asin( sqrt( fmin( h, 1 ) ) );
+}
+
+
+static inline geo_cover_e geo_circle_classify( const void *region,
+                                               double minlat, double minlon,
+                                               double maxlat, double maxlon )
+{
+    const geo_circle_t *c = (const geo_circle_t*)region;
+    geo_cover_e cls = geo_bbox_classify( &c->bbox, minlat, minlon, maxlat,
+                                         maxlon );
+    double lat0 = minlat * GEO_RAD;
+    double lat1 = maxlat * GEO_RAD;
+    double lon0 = minlon * GEO_RAD;
+    double lon1 = maxlon * GEO_RAD;
+    double dlon = 0;
+
+    if( cls == GEO_COVER_OUTSIDE ){
+        return GEO_COVER_OUTSIDE;
+    }
+
+    // the cell is inside if all corners are inside
+    if( geo_circle_distance( c, lat0, lon0 ) <= c->dist_min &&
+        geo_circle_distance( c, lat0, lon1 ) <= c->dist_min &&
+        geo_circle_distance( c, lat1, lon0 ) <= c->dist_min &&
+        geo_circle_distance( c, lat1, lon1 ) <= c->dist_min ){
+        return GEO_COVER_INSIDE;
+    }
+
+    // longitude distance to the nearest meridian of the cell
+    if( c->lon_rad < lon0 || c->lon_rad > lon1 ){
+        double d0 = fabs( remainder( lon0 - c->lon_rad, 2 * M_PI ) );
+        double d1 = fabs( remainder( lon1 - c->lon_rad, 2 * M_PI ) );
+
+        dlon = fmin( d0, d1 );
+        lon0 = d0 < d1 ? lon0 : lon1;
+    }
+
+    // the nearest point of the cell is on the parallel if the center is
+    // between the meridians, otherwise on the nearest meridian at the foot
+    // of the perpendicular.
+    if( dlon == 0 ){
+        double lat = fmin( fmax( c->lat_rad, lat0 ), lat1 );
+
+        if( fabs( lat - c->lat_rad ) > c->dist_max ){
+            return GEO_COVER_OUTSIDE;
+        }
+    }
+    else if( dlon < M_PI / 2 ){
+        double lat = atan( tan( c->lat_rad ) / cos( dlon ) );
+
+        lat = fmin( fmax( lat, lat0 ), lat1 );
+        if( geo_circle_distance( c, lat, lon0 ) > c->dist_max ){
+            return GEO_COVER_OUTSIDE;
+        }
+    }
+
+    return GEO_COVER_PARTIAL;
+}
+
+
+static inline void geo_hash_cell_bounds( const geo_hash_cell_t *cell,
+                                         double *minlat, double *minlon,
+                                         double *maxlat, double *maxlon )
+{
+    uint8_t nlat = cell->len * 5 / 2;
+    uint8_t nlon = cell->len * 5 - nlat;
+    const double ulat = 180.0 / GEO_HASH_AXIS_CELLS;
+    const double ulon = 360.0 / GEO_HASH_AXIS_CELLS;
+
+    *minlat = (double)cell->qlat * ulat - 90.0;
+    *minlon = (double)cell->qlon * ulon - 180.0;
+    *maxlat = (double)( cell->qlat +
+                        ( (uint64_t)1 << ( GEO_HASH_AXIS_BITS - nlat ) ) ) *
+              ulat - 90.0;
+    *maxlon = (double)( cell->qlon +
+                        ( (uint64_t)1 << ( GEO_HASH_AXIS_BITS - nlon ) ) ) *
+              ulon - 180.0;
+}
+
+
+// returns the child cell of the specified digit.
+static inline geo_hash_cell_t geo_hash_cell_child( const geo_hash_cell_t *cell,
+                                                   uint64_t digit )
+{
+    geo_hash_cell_t child = *cell;
+    int pos = cell->len * 5;
+    int i = 4;
+
+    // the even position of the bit stream is the longitude
+    for(; i >= 0; i--, pos++ )
+    {
+        uint64_t bit = ( digit >> i ) & 1;
+
+        if( pos & 1 ){
+            child.qlat |= bit << ( GEO_HASH_AXIS_BITS - 1 - pos / 2 );
+        }
+        else {
+            child.qlon |= bit << ( GEO_HASH_AXIS_BITS - 1 - pos / 2 );
+        }
+    }
+    child.len++;
+
+    return child;
+}
+
+
+static inline int geo_hash_cell_cmp( const void *a, const void *b )
+{
+    const geo_hash_cell_t *x = (const geo_hash_cell_t*)a;
+    const geo_hash_cell_t *y = (const geo_hash_cell_t*)b;
+    uint64_t xhi, xlo, yhi, ylo;
+
+    geo_hash_interleave( x->qlat, x->qlon, &xhi, &xlo );
+    geo_hash_interleave( y->qlat, y->qlon, &yhi, &ylo );
+    if( xhi != yhi ){
+        return xhi < yhi ? -1 : 1;
+    }
+    else if( xlo != ylo ){
+        return xlo < ylo ? -1 : 1;
+    }
+
+    return (int)x->len - (int)y->len;
+}
+
+
+// region and its classifier of the geohash cover
+typedef struct {
+    geo_cover_classify_t classify;
+    const void *region;
+} geo_hash_region_t;
+
+
+static inline void geo_hash_cover_child( void *child, const void *cell, int i )
+{
+    *(geo_hash_cell_t*)child = geo_hash_cell_child( cell, (uint64_t)i );
+}
+
+
+static inline geo_cover_e geo_hash_cover_classify( const void *region,
+                                                   const void *cell )
+{
+    const geo_hash_region_t *r = (const geo_hash_region_t*)region;
+    double minlat, minlon, maxlat, maxlon;
+
+    geo_hash_cell_bounds( cell, &minlat, &minlon, &maxlat, &maxlon );
+
+    return r->classify( r->region, minlat, minlon, maxlat, maxlon );
+}
+
+
+static const geo_cover_grid_t GEO_HASH_GRID = {
+    .size = sizeof( geo_hash_cell_t ),
+    .lvoff = offsetof( geo_hash_cell_t, len ),
+    .fanout = 32,
+    .child = geo_hash_cover_child,
+    .classify = geo_hash_cover_classify,
+    .cmp = geo_hash_cell_cmp
+};
+
+// number of cells that required to compute the cover of max_cells.
+#define GEO_HASH_COVER_SIZE(max_cells)  GEO_COVER_SIZE( max_cells, 32 )
+
+// computes the geohash cells that cover the region. see geo_cover.
+// cells: array of GEO_HASH_COVER_SIZE( max_cells ) elements to store the
+//        result in ascending order of the hash.
+// returns the number of cells.
+static inline size_t geo_hash_cover( geo_hash_cell_t *cells,
+                                     size_t max_cells, uint8_t precision,
+                                     geo_cover_classify_t classify,
+                                     const void *region )
+{
+    geo_hash_region_t r = { classify, region };
+
+    return geo_cover( cells, max_cells, precision, &GEO_HASH_GRID, &r );
+}
+
+
+// MARK: batch kernels
+// number of coordinates to be encoded at once by the batch kernel
+#define GEO_HASH_BLOCK_SIZE 64
+
+// computes the 80 bits codes of the validated coordinates.
+typedef void (*geo_hash_kernel_t)( uint64_t *hi, uint64_t *lo,
+                                   const double *lat, const double *lon,
+                                   size_t stride, size_t len );
+
+
+static inline void geo_hash_kernel_scalar( uint64_t *hi, uint64_t *lo,
+                                           const double *lat, const double *lon,
+                                           size_t stride, size_t len )
+{
+    uint64_t qlat, qlon;
+    size_t i = 0;
+
+    for(; i < len; i++ ){
+        geo_hash_quantize_latlon( lat[i * stride], lon[i * stride], &qlat,
+                                  &qlon );
+        geo_hash_interleave( qlat, qlon, hi + i, lo + i );
+    }
+}
+
+
+#if defined(GEO_HASH_X86_SIMD)
+
+// the following kernels are the vectorized version of the
+// geo_hash_quantize_latlon and geo_hash_interleave, and they produce the
+// same codes as the scalar kernel.
+// the quantized values are converted into the integers by adding 2^52 that
+// places the integer part of the value in the mantissa bits.
+#define GEO_HASH_MAGIC52    4503599627370496.0
+
+__attribute__((target("avx2")))
+static inline __m256i geo_hash_quantize_avx2( __m256d v, double vmin,
+                                              double vrange )
+{
+    const __m256d unit = _mm256_set1_pd( vrange / GEO_HASH_AXIS_CELLS );
+    const __m256d min = _mm256_set1_pd( vmin );
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    const __m256d magic = _mm256_set1_pd( GEO_HASH_MAGIC52 );
+    __m256d q = _mm256_floor_pd(
+        _mm256_div_pd( _mm256_sub_pd( v, min ), unit )
+    );
+    __m256d lower = _mm256_add_pd( _mm256_mul_pd( q, unit ), min );
+
+    // correct the rounding error of the subtraction
+    q = _mm256_sub_pd(
+        q, _mm256_and_pd( _mm256_cmp_pd( v, lower, _CMP_LT_OQ ), one )
+    );
+    q = _mm256_add_pd(
+        q, _mm256_and_pd(
+            _mm256_cmp_pd( v, _mm256_add_pd( lower, unit ), _CMP_GE_OQ ), one
+        )
+    );
+    q = _mm256_min_pd(
+        _mm256_max_pd( q, _mm256_setzero_pd() ),
+        _mm256_set1_pd( GEO_HASH_AXIS_CELLS - 1 )
+    );
+
+    return _mm256_sub_epi64( _mm256_castpd_si256( _mm256_add_pd( q, magic ) ),
+                             _mm256_castpd_si256( magic ) );
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i geo_hash_spread_avx2( __m256i x )
+{
+    x = _mm256_and_si256( _mm256_or_si256( x, _mm256_slli_epi64( x, 16 ) ),
+                          _mm256_set1_epi64x( 0x0000FFFF0000FFFFLL ) );
+    x = _mm256_and_si256( _mm256_or_si256( x, _mm256_slli_epi64( x, 8 ) ),
+                          _mm256_set1_epi64x( 0x00FF00FF00FF00FFLL ) );
+    x = _mm256_and_si256( _mm256_or_si256( x, _mm256_slli_epi64( x, 4 ) ),
+                          _mm256_set1_epi64x( 0x0F0F0F0F0F0F0F0FLL ) );
+    x = _mm256_and_si256( _mm256_or_si256( x, _mm256_slli_epi64( x, 2 ) ),
+                          _mm256_set1_epi64x( 0x3333333333333333LL ) );
+    x = _mm256_and_si256( _mm256_or_si256( x, _mm256_slli_epi64( x, 1 ) ),
+                          _mm256_set1_epi64x( 0x5555555555555555LL ) );
+
+    return x;
+}
+
+
+__attribute__((target("avx2")))
+static inline void geo_hash_kernel_avx2( uint64_t *hi, uint64_t *lo,
+                                         const double *lat, const double *lon,
+                                         size_t stride, size_t len )
+{
+    const __m256i lomask = _mm256_set1_epi64x( 0xFF );
+    size_t i = 0;
+
+    if( stride == 1 || stride == 2 )
+    {
+        for(; i + 4 <= len; i += 4 )
+        {
+            __m256d vlat, vlon;
+            __m256i qlat, qlon;
+
+            if( stride == 1 ){
+                vlat = _mm256_loadu_pd( lat + i );
+                vlon = _mm256_loadu_pd( lon + i );
+            }
+            else {
+                // [lat0 lon0 lat1 lon1] [lat2 lon2 lat3 lon3]
+                __m256d a = _mm256_loadu_pd( lat + i * 2 );
+                __m256d b = _mm256_loadu_pd( lat + i * 2 + 4 );
+
+                // [lat0 lat2 lat1 lat3] -> [lat0 lat1 lat2 lat3]
+                vlat = _mm256_permute4x64_pd( _mm256_unpacklo_pd( a, b ),
+                                              0xD8 );
+                vlon = _mm256_permute4x64_pd( _mm256_unpackhi_pd( a, b ),
+                                              0xD8 );
+            }
+
+            qlat = geo_hash_quantize_avx2( vlat, -90.0, 180.0 );
+            qlon = geo_hash_quantize_avx2( vlon, -180.0, 360.0 );
+            _mm256_storeu_si256( (__m256i*)( hi + i ), _mm256_or_si256(
+                _mm256_slli_epi64(
+                    geo_hash_spread_avx2( _mm256_srli_epi64( qlon, 8 ) ), 1
+                ),
+                geo_hash_spread_avx2( _mm256_srli_epi64( qlat, 8 ) )
+            ));
+            _mm256_storeu_si256( (__m256i*)( lo + i ), _mm256_or_si256(
+                _mm256_slli_epi64(
+                    geo_hash_spread_avx2( _mm256_and_si256( qlon, lomask ) ), 1
+                ),
+                geo_hash_spread_avx2( _mm256_and_si256( qlat, lomask ) )
+            ));
+        }
+    }
+
+    geo_hash_kernel_scalar( hi + i, lo + i, lat + i * stride,
+                            lon + i * stride, stride, len - i );
+}
+
+
+__attribute__((target("sse4.1")))
+static inline __m128i geo_hash_quantize_sse41( __m128d v, double vmin,
+                                               double vrange )
+{
+    const __m128d unit = _mm_set1_pd( vrange / GEO_HASH_AXIS_CELLS );
+    const __m128d min = _mm_set1_pd( vmin );
+    const __m128d one = _mm_set1_pd( 1.0 );
+    const __m128d magic = _mm_set1_pd( GEO_HASH_MAGIC52 );
+    __m128d q = _mm_floor_pd( _mm_div_pd( _mm_sub_pd( v, min ), unit ) );
+    __m128d lower = _mm_add_pd( _mm_mul_pd( q, unit ), min );
+
+    // correct the rounding error of the subtraction
+    q = _mm_sub_pd( q, _mm_and_pd( _mm_cmplt_pd( v, lower ), one ) );
+    q = _mm_add_pd( q, _mm_and_pd(
+        _mm_cmpge_pd( v, _mm_add_pd( lower, unit ) ), one
+    ));
+    q = _mm_min_pd( _mm_max_pd( q, _mm_setzero_pd() ),
+                    _mm_set1_pd( GEO_HASH_AXIS_CELLS - 1 ) );
+
+    return _mm_sub_epi64( _mm_castpd_si128( _mm_add_pd( q, magic ) ),
+                          _mm_castpd_si128( magic ) );
+}
+
+
+__attribute__((target("sse4.1")))
+static inline __m128i geo_hash_spread_sse41( __m128i x )
+{
+    x = _mm_and_si128( _mm_or_si128( x, _mm_slli_epi64( x, 16 ) ),
+                       _mm_set1_epi64x( 0x0000FFFF0000FFFFLL ) );
+    x = _mm_and_si128( _mm_or_si128( x, _mm_slli_epi64( x, 8 ) ),
+                       _mm_set1_epi64x( 0x00FF00FF00FF00FFLL ) );
+    x = _mm_and_si128( _mm_or_si128( x, _mm_slli_epi64( x, 4 ) ),
+                       _mm_set1_epi64x( 0x0F0F0F0F0F0F0F0FLL ) );
+    x = _mm_and_si128( _mm_or_si128( x, _mm_slli_epi64( x, 2 ) ),
+                       _mm_set1_epi64x( 0x3333333333333333LL ) );
+    x = _mm_and_si128( _mm_or_si128( x, _mm_slli_epi64( x, 1 ) ),
+                       _mm_set1_epi64x( 0x5555555555555555LL ) );
+
+    return x;
+}
+
+
+__attribute__((target("sse4.1")))
+static inline void geo_hash_kernel_sse41( uint64_t *hi, uint64_t *lo,
+                                          const double *lat, const double *lon,
+                                          size_t stride, size_t len )
+{
+    const __m128i lomask = _mm_set1_epi64x( 0xFF );
+    size_t i = 0;
+
+    if( stride == 1 || stride == 2 )
+    {
+        for(; i + 2 <= len; i += 2 )
+        {
+            __m128d vlat, vlon;
+            __m128i qlat, qlon;
+
+            if( stride == 1 ){
+                vlat = _mm_loadu_pd( lat + i );
+                vlon = _mm_loadu_pd( lon + i );
+            }
+            else {
+                // [lat0 lon0] [lat1 lon1]
+                __m128d a = _mm_loadu_pd( lat + i * 2 );
+                __m128d b = _mm_loadu_pd( lat + i * 2 + 2 );
+
+                vlat = _mm_unpacklo_pd( a, b );
+                vlon = _mm_unpackhi_pd( a, b );
+            }
+
+            qlat = geo_hash_quantize_sse41( vlat, -90.0, 180.0 );
+            qlon = geo_hash_quantize_sse41( vlon, -180.0, 360.0 );
+            _mm_storeu_si128( (__m128i*)( hi + i ), _mm_or_si128(
+                _mm_slli_epi64(
+                    geo_hash_spread_sse41( _mm_srli_epi64( qlon, 8 ) ), 1
+                ),
+                geo_hash_spread_sse41( _mm_srli_epi64( qlat, 8 ) )
+            ));
+            _mm_storeu_si128( (__m128i*)( lo + i ), _mm_or_si128(
+                _mm_slli_epi64(
+                    geo_hash_spread_sse41( _mm_and_si128( qlon, lomask ) ), 1
+                ),
+                geo_hash_spread_sse41( _mm_and_si128( qlat, lomask ) )
+            ));
+        }
+    }
+
+    geo_hash_kernel_scalar( hi + i, lo + i, lat + i * stride,
+                            lon + i * stride, stride, len - i );
+}
+
+#endif
+
+
+// selected by luaopen_geo_geohash
+static geo_hash_kernel_t geo_hash_kernel = geo_hash_kernel_scalar;
+static const char *geo_hash_kernel_name = "scalar";
+
+static inline void geo_hash_kernel_init( void )
+{
+#if defined(GEO_HASH_X86_SIMD)
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) ){
+        geo_hash_kernel = geo_hash_kernel_avx2;
+        geo_hash_kernel_name = "avx2";
+    }
+    else if( __builtin_cpu_supports( "sse4.1" ) ){
+        geo_hash_kernel = geo_hash_kernel_sse41;
+        geo_hash_kernel_name = "sse4.1";
+    }
+#endif
+}
+
+
+// encodes the coordinates into the fixed-width hashes.
+// returns the number of encoded coordinates. it is less than the number of
+// coordinates if the coordinate at the returned position is out of range.
+static inline size_t geo_hash_encode_batch( char *hash,
+                                            const geo_coords_t *coords,
+                                            uint8_t precision )
+{
+    uint64_t hi[GEO_HASH_BLOCK_SIZE];
+    uint64_t lo[GEO_HASH_BLOCK_SIZE];
+    char tmp[GEO_MAX_HASH_LEN+1];
+    size_t i = 0;
+
+    while( i < coords->len )
+    {
+        const double *lat = coords->lat + i * coords->stride;
+        const double *lon = coords->lon + i * coords->stride;
+        size_t n = coords->len - i;
+        size_t j = 0;
+        int valid = 1;
+
+        if( n > GEO_HASH_BLOCK_SIZE ){
+            n = GEO_HASH_BLOCK_SIZE;
+        }
+        for(; j < n; j++ ){
+            valid &= GEO_IS_LATLON_RANGE( lat[j * coords->stride],
+                                          lon[j * coords->stride] );
+        }
+        if( !valid ){
+            // encode the valid coordinates before the invalid one
+            for( j = 0; GEO_IS_LATLON_RANGE( lat[j * coords->stride],
+                                             lon[j * coords->stride] ); j++ ){}
+            n = j;
+            valid = 0;
+        }
+
+        geo_hash_kernel( hi, lo, lat, lon, coords->stride, n );
+        for( j = 0; j < n; j++ ){
+            geo_hash_format( tmp, hi[j], lo[j], precision );
+            memcpy( hash, tmp, precision );
+            hash += precision;
+        }
+        i += n;
+
+        if( !valid ){
+            errno = EINVAL;
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+#endif
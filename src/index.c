@@ -0,0 +1,551 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/index.c
+ *  lua-geo
+ */
+
+#include "index.h"
+#include "coords.h"
+
+#define MODULE_MT   "geo.index"
+
+
+// MARK: query
+typedef struct {
+    lua_State *L;
+    geo_bbox_t bbox;
+    int n;
+} bbox_ctx_t;
+
+// pushes the id of the point in the bounding box to the table at the top of
+// the stack.
+static void bbox_scan( void *ctx, const geo_index_t *idx, size_t pos )
+{
+    bbox_ctx_t *c = (bbox_ctx_t*)ctx;
+
+    if( geo_bbox_contains( &c->bbox, idx->lat[pos], idx->lon[pos] ) ){
+        lua_pushinteger( c->L, (lua_Integer)idx->ids[pos] );
+        lua_rawseti( c->L, -2, ++c->n );
+    }
+}
+
+
+typedef struct {
+    lua_State *L;
+    geo_t origin;
+    double radius;
+    int n;
+} radius_ctx_t;
+
+
+static inline double point_distance( const geo_t *origin,
+                                     const geo_index_t *idx, size_t pos )
+{
+    geo_t dest = {
+        .lat_rad = idx->lat[pos] * GEO_RAD,
+        .lon_rad = idx->lon[pos] * GEO_RAD
+    };
+
+    return geo_get_distance( origin, &dest );
+}
+
+// pushes the id and the distance of the point in the circle to the tables at
+// the top of the stack.
+static void radius_scan( void *ctx, const geo_index_t *idx, size_t pos )
+{
+    radius_ctx_t *c = (radius_ctx_t*)ctx;
+    double dist = point_distance( &c->origin, idx, pos );
+
+    if( dist <= c->radius ){
+        c->n++;
+        lua_pushinteger( c->L, (lua_Integer)idx->ids[pos] );
+        lua_rawseti( c->L, -3, c->n );
+        lua_pushnumber( c->L, dist );
+        lua_rawseti( c->L, -2, c->n );
+    }
+}
+
+
+typedef struct {
+    double dist;
+    size_t pos;
+} knn_entry_t;
+
+// max-heap of the k nearest points
+typedef struct {
+    geo_t origin;
+    knn_entry_t *heap;
+    size_t k;
+    size_t n;
+} knn_ctx_t;
+
+
+static void knn_push( knn_ctx_t *c, double dist, size_t pos )
+{
+    knn_entry_t *heap = c->heap;
+    size_t i = 0;
+
+    if( c->n < c->k ){
+        // sift up
+        i = c->n++;
+        while( i > 0 && heap[( i - 1 ) / 2].dist < dist ){
+            heap[i] = heap[( i - 1 ) / 2];
+            i = ( i - 1 ) / 2;
+        }
+        heap[i] = (knn_entry_t){ dist, pos };
+        return;
+    }
+    else if( dist >= heap[0].dist ){
+        return;
+    }
+
+    // replace the farthest point and sift down
+    while( i * 2 + 1 < c->n )
+    {
+        size_t child = i * 2 + 1;
+
+        if( child + 1 < c->n && heap[child + 1].dist > heap[child].dist ){
+            child++;
+        }
+        if( heap[child].dist <= dist ){
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = (knn_entry_t){ dist, pos };
+}
+
+
+static void knn_scan( void *ctx, const geo_index_t *idx, size_t pos )
+{
+    knn_ctx_t *c = (knn_ctx_t*)ctx;
+
+    knn_push( c, point_distance( &c->origin, idx, pos ), pos );
+}
+
+
+static int knn_entry_cmp( const void *a, const void *b )
+{
+    const knn_entry_t *x = (const knn_entry_t*)a;
+    const knn_entry_t *y = (const knn_entry_t*)b;
+
+    if( x->dist != y->dist ){
+        return x->dist < y->dist ? -1 : 1;
+    }
+    return ( x->pos > y->pos ) - ( x->pos < y->pos );
+}
+
+
+// MARK: methods
+// maps the latest snapshot of the shared index.
+static geo_index_t *checksynced( lua_State *L )
+{
+    geo_index_t *idx = luaL_checkudata( L, 1, MODULE_MT );
+
+    if( idx->shm && geo_index_shm_sync( idx ) != 0 ){
+        luaL_error( L, "failed to map the snapshot: %s", strerror( errno ) );
+    }
+
+    return idx;
+}
+
+
+static geo_index_t *checkindex( lua_State *L )
+{
+    geo_index_t *idx = checksynced( L );
+
+    // sort the points that added after the last query
+    if( geo_index_sort( idx ) != 0 ){
+        luaL_error( L, "failed to sort the index: %s", strerror( errno ) );
+    }
+
+    return idx;
+}
+
+
+static void checklatlon( lua_State *L, int idx, double *lat, double *lon )
+{
+    *lat = lauxh_checknumber( L, idx );
+    *lon = lauxh_checknumber( L, idx + 1 );
+    lauxh_argcheck(
+        L, GEO_IS_LAT_RANGE( *lat ), idx,
+        "-90 to 90 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_LON_RANGE( *lon ), idx + 1,
+        "-180 to 180 expected, got an out of range value"
+    );
+}
+
+
+static int knn_lua( lua_State *L )
+{
+    geo_index_t *idx = checkindex( L );
+    double lat, lon;
+    lua_Integer k = 0;
+    knn_ctx_t ctx;
+    size_t i = 0;
+
+    checklatlon( L, 2, &lat, &lon );
+    k = lauxh_checkinteger( L, 4 );
+    lauxh_argcheck(
+        L, k >= 0 && k <= INT32_MAX, 4,
+        "non-negative integer expected, got an out of range value"
+    );
+    if( (size_t)k > idx->len ){
+        k = idx->len;
+    }
+
+    ctx.k = k;
+    ctx.n = 0;
+    ctx.heap = lua_newuserdata( L, sizeof( knn_entry_t ) * ( k + 1 ) );
+    geo_init( &ctx.origin, lat, lon, 0 );
+    if( k )
+    {
+        uint64_t qlat, qlon, hi, lo;
+        size_t pos, from, to;
+        geo_hash_cell_t cells[GEO_HASH_COVER_SIZE( GEO_INDEX_COVER_CELLS )];
+        geo_circle_t circle;
+
+        // the nearest k of the points around the position of the origin in
+        // the sort order give the upper bound of the distance of the k-th
+        // nearest point.
+        geo_hash_quantize_latlon( lat, lon, &qlat, &qlon );
+        geo_hash_interleave( qlat, qlon, &hi, &lo );
+        pos = geo_index_lower_bound( idx, 0,
+                                     hi >> ( 64 - GEO_INDEX_KEY_BITS ) );
+        from = pos > (size_t)k ? pos - k : 0;
+        to = pos + k < idx->len ? pos + k : idx->len;
+        for(; from < to; from++ ){
+            knn_scan( &ctx, idx, from );
+        }
+
+        // then find the nearer points in the circle of that distance
+        geo_circle_init( &circle, lat, lon, ctx.heap[0].dist );
+        ctx.n = 0;
+        geo_index_query( idx, cells, geo_circle_classify, &circle, knn_scan,
+                         &ctx );
+        qsort( ctx.heap, ctx.n, sizeof( knn_entry_t ), knn_entry_cmp );
+    }
+
+    lua_createtable( L, ctx.n, 0 );
+    lua_createtable( L, ctx.n, 0 );
+    for(; i < ctx.n; i++ ){
+        lua_pushinteger( L, (lua_Integer)idx->ids[ctx.heap[i].pos] );
+        lua_rawseti( L, -3, i + 1 );
+        lua_pushnumber( L, ctx.heap[i].dist );
+        lua_rawseti( L, -2, i + 1 );
+    }
+
+    return 2;
+}
+
+
+static int within_radius_lua( lua_State *L )
+{
+    geo_index_t *idx = checkindex( L );
+    radius_ctx_t ctx = { .L = L };
+    geo_hash_cell_t cells[GEO_HASH_COVER_SIZE( GEO_INDEX_COVER_CELLS )];
+    geo_circle_t circle;
+    double lat, lon;
+
+    checklatlon( L, 2, &lat, &lon );
+    ctx.radius = lauxh_checknumber( L, 4 );
+    lauxh_argcheck(
+        L, ctx.radius >= 0, 4, "non-negative number expected, got %f",
+        ctx.radius
+    );
+
+    geo_init( &ctx.origin, lat, lon, 0 );
+    geo_circle_init( &circle, lat, lon, ctx.radius );
+    lua_newtable( L );
+    lua_newtable( L );
+    geo_index_query( idx, cells, geo_circle_classify, &circle, radius_scan,
+                     &ctx );
+
+    return 2;
+}
+
+
+static int within_bbox_lua( lua_State *L )
+{
+    geo_index_t *idx = checkindex( L );
+    bbox_ctx_t ctx = { .L = L };
+    geo_hash_cell_t cells[GEO_HASH_COVER_SIZE( GEO_INDEX_COVER_CELLS )];
+
+    checklatlon( L, 2, &ctx.bbox.minlat, &ctx.bbox.minlon );
+    checklatlon( L, 4, &ctx.bbox.maxlat, &ctx.bbox.maxlon );
+    lauxh_argcheck(
+        L, ctx.bbox.minlat <= ctx.bbox.maxlat, 4,
+        "maxlat must be greater than or equal to minlat"
+    );
+
+    lua_newtable( L );
+    geo_index_query( idx, cells, geo_bbox_classify, &ctx.bbox, bbox_scan,
+                     &ctx );
+
+    return 1;
+}
+
+
+static int add_lua( lua_State *L )
+{
+    geo_index_t *idx = luaL_checkudata( L, 1, MODULE_MT );
+    double lat, lon;
+    lua_Integer id = 0;
+
+    checklatlon( L, 2, &lat, &lon );
+    id = lauxh_checkinteger( L, 4 );
+    if( geo_index_add( idx, lat, lon, id ) != 0 ){
+        lua_pushboolean( L, 0 );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    lua_pushboolean( L, 1 );
+
+    return 1;
+}
+
+
+static int save_lua( lua_State *L )
+{
+    geo_index_t *idx = luaL_checkudata( L, 1, MODULE_MT );
+    const char *path = lauxh_checkstring( L, 2 );
+
+    if( geo_index_save( idx, path ) != 0 ){
+        lua_pushboolean( L, 0 );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    lua_pushboolean( L, 1 );
+
+    return 1;
+}
+
+
+static int publish_lua( lua_State *L )
+{
+    geo_index_t *idx = checksynced( L );
+    const char *name = lauxh_checkstring( L, 2 );
+    uint64_t gen = 0;
+
+    if( geo_index_publish( idx, name, &gen ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    lua_pushinteger( L, (lua_Integer)gen );
+
+    return 1;
+}
+
+
+static int generation_lua( lua_State *L )
+{
+    geo_index_t *idx = checksynced( L );
+
+    lua_pushinteger( L, idx->shm ? (lua_Integer)idx->shm->gen : 0 );
+
+    return 1;
+}
+
+
+static int build_lua( lua_State *L )
+{
+    checkindex( L );
+    return 0;
+}
+
+
+static int len_lua( lua_State *L )
+{
+    geo_index_t *idx = checksynced( L );
+
+    lua_pushinteger( L, (lua_Integer)idx->len );
+
+    return 1;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, MODULE_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    geo_index_free( (geo_index_t*)lua_touserdata( L, 1 ) );
+    return 0;
+}
+
+
+static int open_lua( lua_State *L )
+{
+    const char *path = lauxh_checkstring( L, 1 );
+    geo_index_t *idx = lua_newuserdata( L, sizeof( geo_index_t ) );
+
+    *idx = (geo_index_t){ 0 };
+    if( geo_index_open( idx, path ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+
+    return 1;
+}
+
+
+static int attach_lua( lua_State *L )
+{
+    const char *name = lauxh_checkstring( L, 1 );
+    geo_index_t *idx = lua_newuserdata( L, sizeof( geo_index_t ) );
+
+    if( geo_index_attach( idx, name ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+
+    return 1;
+}
+
+
+static int unlink_lua( lua_State *L )
+{
+    const char *name = lauxh_checkstring( L, 1 );
+
+    if( geo_index_unlink( name ) != 0 ){
+        lua_pushboolean( L, 0 );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    lua_pushboolean( L, 1 );
+
+    return 1;
+}
+
+
+static int new_lua( lua_State *L )
+{
+    geo_index_t *idx = NULL;
+    geo_coords_t coords = { .len = 0 };
+    size_t n = 0;
+
+    if( !lauxh_isnil( L, 1 ) ){
+        geo_checkcoords( L, 1, &coords );
+    }
+    if( !lauxh_isnil( L, 2 ) ){
+        lauxh_checktable( L, 2 );
+        lauxh_argcheck(
+            L, lauxh_rawlen( L, 2 ) == coords.len, 2,
+            "%d ids expected, got %d ids", (int)coords.len,
+            (int)lauxh_rawlen( L, 2 )
+        );
+    }
+
+    idx = lua_newuserdata( L, sizeof( geo_index_t ) );
+    *idx = (geo_index_t){ 0 };
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+
+    // the identifiers of the table take precedence over the buffer
+    n = geo_index_add_batch( idx, &coords, coords.ids );
+    if( n != coords.len ){
+        // got error
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        lua_pushinteger( L, (lua_Integer)n + 1 );
+        return 3;
+    }
+    else if( lua_istable( L, 2 ) )
+    {
+        size_t i = 0;
+
+        for(; i < n; i++ )
+        {
+            lua_rawgeti( L, 2, i + 1 );
+            lauxh_argcheck(
+                L, lua_type( L, -1 ) == LUA_TNUMBER, 2,
+                "integer expected at #%d", (int)i + 1
+            );
+            idx->ids[i] = (int64_t)lua_tointeger( L, -1 );
+            lua_pop( L, 1 );
+        }
+    }
+
+    return 1;
+}
+
+
+LUALIB_API int luaopen_geo_index( lua_State *L )
+{
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__tostring", tostring_lua },
+        { "__len", len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "add", add_lua },
+        { "build", build_lua },
+        { "save", save_lua },
+        { "publish", publish_lua },
+        { "generation", generation_lua },
+        { "len", len_lua },
+        { "within_bbox", within_bbox_lua },
+        { "within_radius", within_radius_lua },
+        { "knn", knn_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg *ptr = mmethod;
+
+    geo_hash_kernel_init();
+
+    // create metatable
+    luaL_newmetatable( L, MODULE_MT );
+    for(; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    // create method table
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    for( ptr = method; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    lua_createtable( L, 0, 4 );
+    lauxh_pushfn2tbl( L, "new", new_lua );
+    lauxh_pushfn2tbl( L, "open", open_lua );
+    lauxh_pushfn2tbl( L, "attach", attach_lua );
+    lauxh_pushfn2tbl( L, "unlink", unlink_lua );
+
+    return 1;
+}
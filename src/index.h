@@ -0,0 +1,886 @@
+/*
+ *  Copyright (C) 2013-2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/index.h
+ *  lua-geo
+ *
+ *  spatial index of the points that sorted by the integer geohash.
+ */
+
+#ifndef geo_index_h
+#define geo_index_h
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "geohash.h"
+
+
+// number of bits of the sort key.
+// the key is the 62 bits integer geohash of the point.
+#define GEO_INDEX_KEY_BITS      GEO_HASH_INT_MAX_BITS
+// max number of cells of the cover that used to find the candidates
+#define GEO_INDEX_COVER_CELLS   16
+// precision of the finest cell of the cover
+#define GEO_INDEX_COVER_PRECISION   12
+// initial capacity of the points
+#define GEO_INDEX_MIN_CAPACITY  64
+
+// control object of the shared index in the POSIX shared memory
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    // generation of the current snapshot; 0 if not published yet.
+    // it is accessed atomically.
+    uint64_t gen;
+} geo_index_ctl_t;
+
+// max length of the name of the shared index
+#define GEO_INDEX_SHM_NAME_MAX  200
+
+// state of the reader of the shared index
+typedef struct {
+    const geo_index_ctl_t *ctl;
+    // generation of the mapped snapshot
+    uint64_t gen;
+    char name[GEO_INDEX_SHM_NAME_MAX + 1];
+} geo_index_shm_t;
+
+// structure of arrays of the points.
+// the points are sorted in ascending order of the key if the sorted is
+// non-zero.
+// the arrays point into the read-only mapping of the index file if the map
+// is not NULL, and the mapping is replaced by the newer snapshot if the shm
+// is not NULL.
+typedef struct {
+    size_t len;
+    size_t cap;
+    int sorted;
+    uint64_t *keys;
+    double *lat;
+    double *lon;
+    int64_t *ids;
+    void *map;
+    size_t maplen;
+    geo_index_shm_t *shm;
+} geo_index_t;
+
+// called for each candidate point of the scan
+typedef void (*geo_index_scan_t)( void *ctx, const geo_index_t *idx,
+                                  size_t pos );
+
+
+static inline void geo_index_free( geo_index_t *idx )
+{
+    if( idx->map ){
+        munmap( idx->map, idx->maplen );
+    }
+    else {
+        free( idx->keys );
+        free( idx->lat );
+        free( idx->lon );
+        free( idx->ids );
+    }
+    if( idx->shm ){
+        munmap( (void*)idx->shm->ctl, sizeof( geo_index_ctl_t ) );
+        free( idx->shm );
+    }
+    *idx = (geo_index_t){ 0 };
+}
+
+
+// grows the capacity to store the specified number of points.
+static inline int geo_index_reserve( geo_index_t *idx, size_t need )
+{
+    if( idx->map ){
+        errno = EROFS;
+        return -1;
+    }
+    else if( need > idx->cap )
+    {
+        size_t cap = idx->cap ? idx->cap : GEO_INDEX_MIN_CAPACITY;
+        void *ptr = NULL;
+
+        while( cap < need ){
+            cap *= 2;
+        }
+        // the capacity is updated after all arrays are grown
+        if( !( ptr = realloc( idx->keys, sizeof( uint64_t ) * cap ) ) ){
+            return -1;
+        }
+        idx->keys = (uint64_t*)ptr;
+        if( !( ptr = realloc( idx->lat, sizeof( double ) * cap ) ) ){
+            return -1;
+        }
+        idx->lat = (double*)ptr;
+        if( !( ptr = realloc( idx->lon, sizeof( double ) * cap ) ) ){
+            return -1;
+        }
+        idx->lon = (double*)ptr;
+        if( !( ptr = realloc( idx->ids, sizeof( int64_t ) * cap ) ) ){
+            return -1;
+        }
+        idx->ids = (int64_t*)ptr;
+        idx->cap = cap;
+    }
+
+    return 0;
+}
+
+
+// appends the point. the coordinates must be validated.
+static inline int geo_index_add( geo_index_t *idx, double lat, double lon,
+                                 int64_t id )
+{
+    uint64_t qlat, qlon, hi, lo;
+
+    if( geo_index_reserve( idx, idx->len + 1 ) != 0 ){
+        return -1;
+    }
+
+    geo_hash_quantize_latlon( lat, lon, &qlat, &qlon );
+    geo_hash_interleave( qlat, qlon, &hi, &lo );
+    idx->keys[idx->len] = hi >> ( 64 - GEO_INDEX_KEY_BITS );
+    idx->lat[idx->len] = lat;
+    idx->lon[idx->len] = lon;
+    idx->ids[idx->len] = id;
+    idx->len++;
+    idx->sorted = 0;
+
+    return 0;
+}
+
+
+// appends the points by the batch kernel.
+// returns the number of appended points. it is less than the number of
+// coordinates if the coordinate at the returned position is out of range.
+// ids: identifiers of the points or NULL to use the 1-based position.
+static inline size_t geo_index_add_batch( geo_index_t *idx,
+                                          const geo_coords_t *coords,
+                                          const int64_t *ids )
+{
+    uint64_t hi[GEO_HASH_BLOCK_SIZE];
+    uint64_t lo[GEO_HASH_BLOCK_SIZE];
+    size_t base = idx->len;
+    size_t i = 0;
+
+    if( geo_index_reserve( idx, idx->len + coords->len ) != 0 ){
+        return 0;
+    }
+
+    idx->sorted = 0;
+    while( i < coords->len )
+    {
+        const double *lat = coords->lat + i * coords->stride;
+        const double *lon = coords->lon + i * coords->stride;
+        size_t n = coords->len - i;
+        size_t j = 0;
+        int valid = 1;
+
+        if( n > GEO_HASH_BLOCK_SIZE ){
+            n = GEO_HASH_BLOCK_SIZE;
+        }
+        for(; j < n; j++ )
+        {
+            if( !GEO_IS_LATLON_RANGE( lat[j * coords->stride],
+                                      lon[j * coords->stride] ) ){
+                // append the valid coordinates before the invalid one
+                n = j;
+                valid = 0;
+                break;
+            }
+            idx->lat[idx->len + j] = lat[j * coords->stride];
+            idx->lon[idx->len + j] = lon[j * coords->stride];
+            idx->ids[idx->len + j] = ids ? ids[i + j] :
+                                     (int64_t)( base + i + j + 1 );
+        }
+
+        geo_hash_kernel( hi, lo, lat, lon, coords->stride, n );
+        for( j = 0; j < n; j++ ){
+            idx->keys[idx->len + j] = hi[j] >> ( 64 - GEO_INDEX_KEY_BITS );
+        }
+        idx->len += n;
+        i += n;
+
+        if( !valid ){
+            errno = EINVAL;
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+// sort entry of the key and the position of the point
+typedef struct {
+    uint64_t key;
+    size_t pos;
+} geo_index_entry_t;
+
+
+static inline int geo_index_entry_cmp( const void *a, const void *b )
+{
+    const geo_index_entry_t *x = (const geo_index_entry_t*)a;
+    const geo_index_entry_t *y = (const geo_index_entry_t*)b;
+
+    if( x->key != y->key ){
+        return x->key < y->key ? -1 : 1;
+    }
+    // keep the insertion order of the same key
+    return ( x->pos > y->pos ) - ( x->pos < y->pos );
+}
+
+
+#define geo_index_gather(idx,field,type,order,tmp) do{ \
+    type *_src = (idx)->field; \
+    type *_dst = (type*)(tmp); \
+    size_t _i = 0; \
+    for(; _i < (idx)->len; _i++ ){ \
+        _dst[_i] = _src[(order)[_i].pos]; \
+    } \
+    memcpy( _src, _dst, sizeof( type ) * (idx)->len ); \
+}while(0)
+
+// sorts the points in ascending order of the key.
+static inline int geo_index_sort( geo_index_t *idx )
+{
+    if( idx->len < 2 ){
+        idx->sorted = 1;
+    }
+    else if( !idx->sorted )
+    {
+        geo_index_entry_t *order = NULL;
+        void *tmp = NULL;
+        size_t i = 0;
+
+        if( !( order = malloc( sizeof( geo_index_entry_t ) * idx->len ) ) ){
+            return -1;
+        }
+        else if( !( tmp = malloc( sizeof( uint64_t ) * idx->len ) ) ){
+            free( order );
+            return -1;
+        }
+
+        for(; i < idx->len; i++ ){
+            order[i] = (geo_index_entry_t){ idx->keys[i], i };
+        }
+        qsort( order, idx->len, sizeof( geo_index_entry_t ),
+               geo_index_entry_cmp );
+        geo_index_gather( idx, keys, uint64_t, order, tmp );
+        geo_index_gather( idx, lat, double, order, tmp );
+        geo_index_gather( idx, lon, double, order, tmp );
+        geo_index_gather( idx, ids, int64_t, order, tmp );
+        free( tmp );
+        free( order );
+        idx->sorted = 1;
+    }
+
+    return 0;
+}
+
+#undef geo_index_gather
+
+
+// returns the position of the first point whose key is not less than the
+// specified key in [from, len).
+static inline size_t geo_index_lower_bound( const geo_index_t *idx,
+                                            size_t from, uint64_t key )
+{
+    size_t to = idx->len;
+
+    while( from < to )
+    {
+        size_t mid = from + ( to - from ) / 2;
+
+        if( idx->keys[mid] < key ){
+            from = mid + 1;
+        }
+        else {
+            to = mid;
+        }
+    }
+
+    return from;
+}
+
+
+// key range of the cell
+static inline void geo_index_cell_range( const geo_hash_cell_t *cell,
+                                         uint64_t *from, uint64_t *to )
+{
+    uint64_t hi, lo;
+
+    geo_hash_interleave( cell->qlat, cell->qlon, &hi, &lo );
+    *from = hi >> ( 64 - GEO_INDEX_KEY_BITS );
+    *to = *from + ( (uint64_t)1 << ( GEO_INDEX_KEY_BITS - cell->len * 5 ) );
+}
+
+
+// calls the function for each point in the cells that cover the region.
+// the contiguous cells are merged into the single range scan.
+// the points must be sorted, and the precision of the cells must be less
+// than or equal to GEO_INDEX_COVER_PRECISION.
+static inline void geo_index_scan( const geo_index_t *idx,
+                                   const geo_hash_cell_t *cells, size_t ncell,
+                                   geo_index_scan_t fn, void *ctx )
+{
+    size_t pos = 0;
+    size_t i = 0;
+
+    while( i < ncell && pos < idx->len )
+    {
+        uint64_t from, to, next, end;
+
+        geo_index_cell_range( cells + i, &from, &to );
+        for( i++; i < ncell; i++ )
+        {
+            geo_index_cell_range( cells + i, &next, &end );
+            if( next != to ){
+                break;
+            }
+            to = end;
+        }
+
+        pos = geo_index_lower_bound( idx, pos, from );
+        for(; pos < idx->len && idx->keys[pos] < to; pos++ ){
+            fn( ctx, idx, pos );
+        }
+    }
+}
+
+
+// calls the function for each point that may be in the region.
+// the region is classified by the classify function of the cover.
+static inline void geo_index_query( const geo_index_t *idx,
+                                    geo_hash_cell_t *cells,
+                                    geo_cover_classify_t classify,
+                                    const void *region, geo_index_scan_t fn,
+                                    void *ctx )
+{
+    size_t ncell = geo_hash_cover( cells, GEO_INDEX_COVER_CELLS,
+                                   GEO_INDEX_COVER_PRECISION, classify,
+                                   region );
+
+    geo_index_scan( idx, cells, ncell, fn, ctx );
+}
+
+
+// returns non-zero if the point is in the bounding box.
+static inline int geo_bbox_contains( const geo_bbox_t *bbox, double lat,
+                                     double lon )
+{
+    if( lat < bbox->minlat || lat > bbox->maxlat ){
+        return 0;
+    }
+    else if( bbox->minlon <= bbox->maxlon ){
+        return lon >= bbox->minlon && lon <= bbox->maxlon;
+    }
+    // crosses the antimeridian
+    return lon >= bbox->minlon || lon <= bbox->maxlon;
+}
+
+
+// MARK: index file
+// the index file consists of the header and the arrays of the sorted points
+// in the native byte order:
+//
+//  header: geo_index_header_t
+//  keys  : uint64_t[len]
+//  lat   : double[len]
+//  lon   : double[len]
+//  ids   : int64_t[len]
+//
+// the keys are the same as the integer geohash of GEO_INDEX_KEY_BITS bits,
+// that is, geohash.encode_int( lat, lon, 62 ).
+#define GEO_INDEX_MAGIC     "GEOINDEX"
+#define GEO_INDEX_VERSION   1
+// written as the native integer to detect the byte order mismatch
+#define GEO_INDEX_BOM       0x0102030405060708ULL
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t key_bits;
+    uint64_t bom;
+    uint64_t len;
+} geo_index_header_t;
+
+// size of the point in the index file
+#define GEO_INDEX_POINT_SIZE    ( sizeof( uint64_t ) + sizeof( double ) * 2 + \
+                                  sizeof( int64_t ) )
+
+
+static inline geo_index_header_t geo_index_header( size_t len )
+{
+    return (geo_index_header_t){
+        .magic = GEO_INDEX_MAGIC,
+        .version = GEO_INDEX_VERSION,
+        .key_bits = GEO_INDEX_KEY_BITS,
+        .bom = GEO_INDEX_BOM,
+        .len = len
+    };
+}
+
+
+static inline int geo_index_write( FILE *fp, const void *ptr, size_t size,
+                                   size_t len )
+{
+    if( len && fwrite( ptr, size, len, fp ) != len ){
+        return -1;
+    }
+    return 0;
+}
+
+// writes the sorted points to the index file.
+// the points are written to the temporary file in the same directory and then
+// renamed to the path, so the processes that map the current file keep
+// reading the old file and the new file is opened by the next open.
+static inline int geo_index_save( geo_index_t *idx, const char *path )
+{
+    geo_index_header_t hdr = geo_index_header( idx->len );
+    size_t len = strlen( path );
+    char *tmp = NULL;
+    FILE *fp = NULL;
+    int fd = -1;
+    int err = 0;
+
+    if( geo_index_sort( idx ) != 0 || !( tmp = malloc( len + 8 ) ) ){
+        return -1;
+    }
+    memcpy( tmp, path, len );
+    memcpy( tmp + len, ".XXXXXX", 8 );
+    if( ( fd = mkstemp( tmp ) ) == -1 ){
+        free( tmp );
+        return -1;
+    }
+    else if( fchmod( fd, 0644 ) != 0 || !( fp = fdopen( fd, "w" ) ) ){
+        goto FAILED;
+    }
+    fd = -1;
+    if( geo_index_write( fp, &hdr, sizeof( hdr ), 1 ) != 0 ||
+        geo_index_write( fp, idx->keys, sizeof( uint64_t ), idx->len ) != 0 ||
+        geo_index_write( fp, idx->lat, sizeof( double ), idx->len ) != 0 ||
+        geo_index_write( fp, idx->lon, sizeof( double ), idx->len ) != 0 ||
+        geo_index_write( fp, idx->ids, sizeof( int64_t ), idx->len ) != 0 ||
+        fflush( fp ) != 0 || fsync( fileno( fp ) ) != 0 ){
+        goto FAILED;
+    }
+    else if( fclose( fp ) != 0 ){
+        fp = NULL;
+        goto FAILED;
+    }
+    fp = NULL;
+    if( rename( tmp, path ) != 0 ){
+        goto FAILED;
+    }
+    free( tmp );
+
+    return 0;
+
+FAILED:
+    err = errno;
+    if( fp ){
+        fclose( fp );
+    }
+    else if( fd != -1 ){
+        close( fd );
+    }
+    unlink( tmp );
+    free( tmp );
+    errno = err;
+    return -1;
+}
+
+
+// maps the index file into the read-only memory.
+// the pages are shared with the other processes that map the same file.
+static inline int geo_index_map( geo_index_t *idx, void *map, size_t maplen )
+{
+    const geo_index_header_t *hdr = (const geo_index_header_t*)map;
+    char *ptr = (char*)map + sizeof( geo_index_header_t );
+    uint64_t len = 0;
+
+    if( maplen < sizeof( geo_index_header_t ) ||
+        memcmp( hdr->magic, GEO_INDEX_MAGIC, sizeof( hdr->magic ) ) != 0 ||
+        hdr->version != GEO_INDEX_VERSION ||
+        hdr->key_bits != GEO_INDEX_KEY_BITS || hdr->bom != GEO_INDEX_BOM ){
+        errno = EINVAL;
+        return -1;
+    }
+
+    // the file size must be exactly the size of the points
+    len = ( maplen - sizeof( geo_index_header_t ) ) / GEO_INDEX_POINT_SIZE;
+    if( hdr->len != len ||
+        maplen != sizeof( geo_index_header_t ) + len * GEO_INDEX_POINT_SIZE ){
+        errno = EINVAL;
+        return -1;
+    }
+
+    *idx = (geo_index_t){
+        .len = len,
+        .cap = len,
+        .sorted = 1,
+        .keys = (uint64_t*)ptr,
+        .lat = (double*)( ptr + len * sizeof( uint64_t ) ),
+        .lon = (double*)( ptr + len * ( sizeof( uint64_t ) +
+                                        sizeof( double ) ) ),
+        .ids = (int64_t*)( ptr + len * ( sizeof( uint64_t ) +
+                                         sizeof( double ) * 2 ) ),
+        .map = map,
+        .maplen = maplen
+    };
+
+    return 0;
+}
+
+
+// maps the index file of the descriptor. the descriptor is always closed.
+static inline int geo_index_mapfd( geo_index_t *idx, int fd )
+{
+    struct stat st;
+    void *map = NULL;
+    int err = 0;
+
+    if( fstat( fd, &st ) != 0 ){
+        err = errno;
+        close( fd );
+        errno = err;
+        return -1;
+    }
+    else if( (size_t)st.st_size < sizeof( geo_index_header_t ) ){
+        close( fd );
+        errno = EINVAL;
+        return -1;
+    }
+
+    map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    err = errno;
+    close( fd );
+    if( map == MAP_FAILED ){
+        errno = err;
+        return -1;
+    }
+    else if( geo_index_map( idx, map, st.st_size ) != 0 ){
+        munmap( map, st.st_size );
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static inline int geo_index_open( geo_index_t *idx, const char *path )
+{
+    int fd = open( path, O_RDONLY|O_CLOEXEC );
+
+    if( fd == -1 ){
+        return -1;
+    }
+
+    return geo_index_mapfd( idx, fd );
+}
+
+
+// MARK: shared memory
+// the shared index consists of the objects of the POSIX shared memory;
+//
+//  /<name>      : geo_index_ctl_t
+//  /<name>.<gen>: snapshot of the generation in the format of the index file
+//
+// the writer creates the new snapshot, stores its generation into the control
+// object, and then unlinks the previous snapshot. the writers are serialized
+// by the lock of the control object.
+// the readers never lock; they load the generation before the query and map
+// the new snapshot if it is changed. the unlinked snapshot is alive until all
+// the readers unmap it, so the readers keep using the old snapshot safely
+// during the update.
+#define GEO_INDEX_SHM_MAGIC     "GEOSHCTL"
+#define GEO_INDEX_SHM_VERSION   1
+// size of the object name that consists of the slash, name, dot and the
+// generation.
+#define GEO_INDEX_SHM_PATH_SIZE ( GEO_INDEX_SHM_NAME_MAX + 23 )
+
+
+// formats the object name of the generation. gen 0 is the control object.
+static inline int geo_index_shm_path( char *path, const char *name,
+                                      uint64_t gen )
+{
+    size_t len = strlen( name );
+
+    if( !len || len > GEO_INDEX_SHM_NAME_MAX || strchr( name, '/' ) ){
+        errno = EINVAL;
+        return -1;
+    }
+    else if( gen ){
+        snprintf( path, GEO_INDEX_SHM_PATH_SIZE, "/%s.%llu", name,
+                  (unsigned long long)gen );
+    }
+    else {
+        snprintf( path, GEO_INDEX_SHM_PATH_SIZE, "/%s", name );
+    }
+
+    return 0;
+}
+
+
+// writes the sorted points to the snapshot of the generation.
+static inline int geo_index_shm_write( const geo_index_t *idx,
+                                       const char *name, uint64_t gen )
+{
+    char path[GEO_INDEX_SHM_PATH_SIZE];
+    size_t size = sizeof( geo_index_header_t ) +
+                  idx->len * GEO_INDEX_POINT_SIZE;
+    char *map = NULL;
+    char *ptr = NULL;
+    int fd = -1;
+    int err = 0;
+
+    if( geo_index_shm_path( path, name, gen ) != 0 ){
+        return -1;
+    }
+    // remove the snapshot that left by the crashed writer
+    shm_unlink( path );
+    if( ( fd = shm_open( path, O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC,
+                         0644 ) ) == -1 ){
+        return -1;
+    }
+    else if( ftruncate( fd, size ) != 0 ||
+             ( map = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd,
+                           0 ) ) == MAP_FAILED ){
+        err = errno;
+        close( fd );
+        shm_unlink( path );
+        errno = err;
+        return -1;
+    }
+    close( fd );
+
+    *(geo_index_header_t*)map = geo_index_header( idx->len );
+    ptr = map + sizeof( geo_index_header_t );
+    memcpy( ptr, idx->keys, sizeof( uint64_t ) * idx->len );
+    ptr += sizeof( uint64_t ) * idx->len;
+    memcpy( ptr, idx->lat, sizeof( double ) * idx->len );
+    ptr += sizeof( double ) * idx->len;
+    memcpy( ptr, idx->lon, sizeof( double ) * idx->len );
+    ptr += sizeof( double ) * idx->len;
+    memcpy( ptr, idx->ids, sizeof( int64_t ) * idx->len );
+    munmap( map, size );
+
+    return 0;
+}
+
+
+// opens the control object and locks it exclusively.
+static inline geo_index_ctl_t *geo_index_shm_lock( const char *name,
+                                                   int create, int *fd )
+{
+    char path[GEO_INDEX_SHM_PATH_SIZE];
+    geo_index_ctl_t *ctl = NULL;
+    struct stat st;
+    int err = 0;
+
+    if( geo_index_shm_path( path, name, 0 ) != 0 ||
+        ( *fd = shm_open( path, O_RDWR|O_CLOEXEC|( create ? O_CREAT : 0 ),
+                          0644 ) ) == -1 ){
+        return NULL;
+    }
+    else if( flock( *fd, LOCK_EX ) != 0 || fstat( *fd, &st ) != 0 ||
+             ( st.st_size != sizeof( geo_index_ctl_t ) &&
+               ftruncate( *fd, sizeof( geo_index_ctl_t ) ) != 0 ) ||
+             ( ctl = mmap( NULL, sizeof( geo_index_ctl_t ),
+                           PROT_READ|PROT_WRITE, MAP_SHARED, *fd,
+                           0 ) ) == MAP_FAILED ){
+        err = errno;
+        close( *fd );
+        errno = err;
+        return NULL;
+    }
+
+    return ctl;
+}
+
+
+// publishes the sorted points as the new snapshot of the shared index.
+// gen: the generation of the published snapshot.
+static inline int geo_index_publish( geo_index_t *idx, const char *name,
+                                     uint64_t *gen )
+{
+    char path[GEO_INDEX_SHM_PATH_SIZE];
+    geo_index_ctl_t *ctl = NULL;
+    int fd = -1;
+    int rc = 0;
+
+    if( geo_index_sort( idx ) != 0 ||
+        !( ctl = geo_index_shm_lock( name, 1, &fd ) ) ){
+        return -1;
+    }
+
+    *gen = ctl->gen + 1;
+    if( ( rc = geo_index_shm_write( idx, name, *gen ) ) == 0 )
+    {
+        memcpy( ctl->magic, GEO_INDEX_SHM_MAGIC, sizeof( ctl->magic ) );
+        ctl->version = GEO_INDEX_SHM_VERSION;
+        __atomic_store_n( &ctl->gen, *gen, __ATOMIC_RELEASE );
+        // the readers that mapped the previous snapshot keep it
+        if( *gen > 1 && geo_index_shm_path( path, name, *gen - 1 ) == 0 ){
+            shm_unlink( path );
+        }
+    }
+    munmap( ctl, sizeof( geo_index_ctl_t ) );
+    // releases the lock
+    close( fd );
+
+    return rc;
+}
+
+
+// unlinks the control object and the current snapshot.
+static inline int geo_index_unlink( const char *name )
+{
+    char path[GEO_INDEX_SHM_PATH_SIZE];
+    geo_index_ctl_t *ctl = NULL;
+    int fd = -1;
+    int rc = 0;
+
+    if( !( ctl = geo_index_shm_lock( name, 0, &fd ) ) ){
+        return -1;
+    }
+    if( ctl->gen && geo_index_shm_path( path, name, ctl->gen ) == 0 ){
+        shm_unlink( path );
+    }
+    geo_index_shm_path( path, name, 0 );
+    rc = shm_unlink( path );
+    munmap( ctl, sizeof( geo_index_ctl_t ) );
+    close( fd );
+
+    return rc;
+}
+
+
+// maps the current snapshot if the generation of the shared index is
+// changed.
+static inline int geo_index_shm_sync( geo_index_t *idx )
+{
+    geo_index_shm_t *shm = idx->shm;
+    uint64_t gen = __atomic_load_n( &shm->ctl->gen, __ATOMIC_ACQUIRE );
+
+    while( gen != shm->gen )
+    {
+        char path[GEO_INDEX_SHM_PATH_SIZE];
+        geo_index_t snap = { 0 };
+        int fd = -1;
+
+        geo_index_shm_path( path, shm->name, gen );
+        if( ( fd = shm_open( path, O_RDONLY|O_CLOEXEC, 0 ) ) != -1 &&
+            geo_index_mapfd( &snap, fd ) == 0 )
+        {
+            if( idx->map ){
+                munmap( idx->map, idx->maplen );
+            }
+            *idx = snap;
+            idx->shm = shm;
+            shm->gen = gen;
+            return 0;
+        }
+        // retry if the snapshot is replaced by the newer one before it is
+        // opened
+        else if( errno != ENOENT ||
+                 gen == __atomic_load_n( &shm->ctl->gen, __ATOMIC_ACQUIRE ) ){
+            return -1;
+        }
+        gen = __atomic_load_n( &shm->ctl->gen, __ATOMIC_ACQUIRE );
+    }
+
+    return 0;
+}
+
+
+// attaches the shared index as the reader.
+static inline int geo_index_attach( geo_index_t *idx, const char *name )
+{
+    char path[GEO_INDEX_SHM_PATH_SIZE];
+    geo_index_shm_t *shm = NULL;
+    geo_index_ctl_t *ctl = NULL;
+    struct stat st;
+    int fd = -1;
+    int err = 0;
+
+    *idx = (geo_index_t){ 0 };
+    if( geo_index_shm_path( path, name, 0 ) != 0 ||
+        ( fd = shm_open( path, O_RDONLY|O_CLOEXEC, 0 ) ) == -1 ){
+        return -1;
+    }
+    else if( fstat( fd, &st ) != 0 ||
+             ( st.st_size == sizeof( geo_index_ctl_t ) &&
+               ( ctl = mmap( NULL, sizeof( geo_index_ctl_t ), PROT_READ,
+                             MAP_SHARED, fd, 0 ) ) == MAP_FAILED ) ){
+        err = errno;
+        close( fd );
+        errno = err;
+        return -1;
+    }
+    close( fd );
+
+    // the control object that has not been published yet
+    if( !ctl || !__atomic_load_n( &ctl->gen, __ATOMIC_ACQUIRE ) ){
+        if( ctl ){
+            munmap( ctl, sizeof( geo_index_ctl_t ) );
+        }
+        errno = ENOENT;
+        return -1;
+    }
+    else if( memcmp( ctl->magic, GEO_INDEX_SHM_MAGIC,
+                     sizeof( ctl->magic ) ) != 0 ||
+             ctl->version != GEO_INDEX_SHM_VERSION ){
+        munmap( ctl, sizeof( geo_index_ctl_t ) );
+        errno = EINVAL;
+        return -1;
+    }
+    else if( !( shm = malloc( sizeof( geo_index_shm_t ) ) ) ){
+        munmap( ctl, sizeof( geo_index_ctl_t ) );
+        return -1;
+    }
+
+    shm->ctl = ctl;
+    shm->gen = 0;
+    strcpy( shm->name, name );
+    idx->shm = shm;
+    idx->sorted = 1;
+    if( geo_index_shm_sync( idx ) != 0 ){
+        err = errno;
+        geo_index_free( idx );
+        errno = err;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+#endif
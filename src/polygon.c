@@ -0,0 +1,238 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/polygon.c
+ *  lua-geo
+ */
+
+#include "polygon.h"
+#include "coords.h"
+#include "cache.h"
+
+#define MODULE_MT   "geo.polygon"
+
+// default max number of the raster cells
+#define DEFAULT_MAX_CELLS   256
+
+// last identifier of the polygons. the identifiers are never reused, so the
+// cached results of the collected polygon are never matched.
+static uint64_t SERIAL = 0;
+
+
+// MARK: methods
+static int contains_lua( lua_State *L )
+{
+    geo_polygon_t *p = luaL_checkudata( L, 1, MODULE_MT );
+    double lat = lauxh_checknumber( L, 2 );
+    double lon = lauxh_checknumber( L, 3 );
+
+    // the classification of the cell of the point is memoized in the cache
+    if( !lua_isnoneornil( L, 4 ) && GEO_IS_LATLON_RANGE( lat, lon ) )
+    {
+        geo_cache_t *c = luaL_checkudata( L, 4, GEO_CACHE_MT );
+        uint64_t tag = GEO_CACHE_TAG( GEO_CACHE_POLYGON, p->serial );
+        geo_cache_value_t *v = NULL;
+        uint64_t code = 0;
+
+        geo_hash_encode_int( &code, lat, lon, c->precision * 5 );
+        if( !( v = geo_cache_get( c, code, tag ) ) )
+        {
+            geo_hash_cell_t cell = { 0, 0, c->precision };
+            double minlat, minlon, maxlat, maxlon;
+
+            geo_hash_int2axis( code, c->precision * 5, &cell.qlat,
+                               &cell.qlon );
+            geo_hash_cell_bounds( &cell, &minlat, &minlon, &maxlat, &maxlon );
+            v = geo_cache_put( c, code, tag );
+            v->cls = geo_polygon_classify( p, minlat, minlon, maxlat, maxlon );
+        }
+        if( v->cls != GEO_COVER_PARTIAL ){
+            lua_pushboolean( L, v->cls == GEO_COVER_INSIDE );
+            return 1;
+        }
+    }
+    lua_pushboolean( L, geo_polygon_contains( p, lat, lon ) );
+
+    return 1;
+}
+
+
+static int bbox_lua( lua_State *L )
+{
+    geo_polygon_t *p = luaL_checkudata( L, 1, MODULE_MT );
+
+    lua_pushnumber( L, p->bbox.minlat );
+    lua_pushnumber( L, p->bbox.minlon );
+    lua_pushnumber( L, p->bbox.maxlat );
+    lua_pushnumber( L, p->bbox.maxlon );
+
+    return 4;
+}
+
+
+static int cells_lua( lua_State *L )
+{
+    geo_polygon_t *p = luaL_checkudata( L, 1, MODULE_MT );
+    char hash[GEO_MAX_HASH_LEN + 1];
+    size_t i = 0;
+
+    lua_createtable( L, p->ncell, 0 );
+    lua_createtable( L, p->ncell, 0 );
+    for(; i < p->ncell; i++ )
+    {
+        const geo_polygon_cell_t *cell = p->cells + i;
+        // size of the range minus 1 determines the precision of the cell
+        uint64_t span = cell->hi - cell->lo;
+        int len = GEO_POLYGON_MAX_PRECISION;
+
+        for(; len > 1 && ( span >> ( 64 - len * 5 ) ); len-- ){}
+        geo_hash_format( hash, cell->lo, 0, len );
+        lua_pushlstring( L, hash, len );
+        lua_rawseti( L, -3, i + 1 );
+        lua_pushboolean( L, cell->inside );
+        lua_rawseti( L, -2, i + 1 );
+    }
+
+    return 2;
+}
+
+
+static int len_lua( lua_State *L )
+{
+    geo_polygon_t *p = luaL_checkudata( L, 1, MODULE_MT );
+
+    lua_pushinteger( L, (lua_Integer)p->nedge );
+
+    return 1;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, MODULE_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    geo_polygon_free( (geo_polygon_t*)lua_touserdata( L, 1 ) );
+    return 0;
+}
+
+
+static int new_lua( lua_State *L )
+{
+    lua_Integer max_cells = lauxh_optinteger( L, 2, DEFAULT_MAX_CELLS );
+    lua_Integer precision = lauxh_optinteger( L, 3,
+                                              GEO_POLYGON_MAX_PRECISION );
+    geo_coords_t *rings = NULL;
+    size_t nring = 1;
+    geo_polygon_t *p = NULL;
+
+    lauxh_argcheck(
+        L, max_cells >= 0, 2, "unsigned integer expected, got %d",
+        (int)max_cells
+    );
+    lauxh_argcheck(
+        L, precision > 0 && precision <= GEO_POLYGON_MAX_PRECISION, 3,
+        "1 to %d expected, got %d", GEO_POLYGON_MAX_PRECISION, (int)precision
+    );
+    lua_settop( L, 1 );
+
+    // a ring or the array of the rings
+    if( lua_istable( L, 1 ) )
+    {
+        size_t i = 0;
+
+        nring = lauxh_rawlen( L, 1 );
+        lauxh_argcheck( L, nring > 0, 1, "rings expected, got an empty table" );
+        rings = lua_newuserdata( L, sizeof( geo_coords_t ) * nring );
+        for(; i < nring; i++ )
+        {
+            lua_rawgeti( L, 1, i + 1 );
+            lauxh_argcheck(
+                L, lua_type( L, -1 ) == LUA_TSTRING ||
+                   lua_type( L, -1 ) == LUA_TUSERDATA, 1,
+                "packed lat/lon pairs expected at #%d", (int)i + 1
+            );
+            geo_checkcoords( L, lua_gettop( L ), rings + i );
+            // the table keeps the reference of the ring
+            lua_pop( L, 1 );
+        }
+    }
+    else {
+        rings = lua_newuserdata( L, sizeof( geo_coords_t ) );
+        geo_checkcoords( L, 1, rings );
+    }
+
+    p = lua_newuserdata( L, sizeof( geo_polygon_t ) );
+    *p = (geo_polygon_t){ 0 };
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+    if( geo_polygon_init( p, rings, nring, (size_t)max_cells,
+                          (uint8_t)precision ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    p->serial = __atomic_add_fetch( &SERIAL, 1, __ATOMIC_RELAXED );
+
+    return 1;
+}
+
+
+LUALIB_API int luaopen_geo_polygon( lua_State *L )
+{
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__tostring", tostring_lua },
+        { "__len", len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "contains", contains_lua },
+        { "bbox", bbox_lua },
+        { "cells", cells_lua },
+        { "len", len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg *ptr = mmethod;
+
+    // create metatable
+    luaL_newmetatable( L, MODULE_MT );
+    for(; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    // create method table
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    for( ptr = method; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    lua_createtable( L, 0, 1 );
+    lauxh_pushfn2tbl( L, "new", new_lua );
+
+    return 1;
+}
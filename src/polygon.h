@@ -0,0 +1,453 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/polygon.h
+ *  lua-geo
+ *
+ *  prepared polygon for the point-in-polygon tests.
+ */
+
+#ifndef geo_polygon_h
+#define geo_polygon_h
+
+#include <stdlib.h>
+#include <string.h>
+#include "geohash.h"
+
+
+// max precision of the cells of the raster.
+// the cell ranges are represented by the upper 64 bits of the 80 bits code.
+#define GEO_POLYGON_MAX_PRECISION   12
+// max number of latitude bands of the edges
+#define GEO_POLYGON_MAX_BANDS       4096
+// margin in degrees to find the edges that touch the cell
+#define GEO_POLYGON_EPSILON         1e-9
+
+// edge of the ring from the vertex 0 to the vertex 1.
+typedef struct {
+    double lat0;
+    double lon0;
+    double lat1;
+    double lon1;
+    // longitude increment per degree of latitude; 0 for the horizontal edge
+    double slope;
+} geo_polygon_edge_t;
+
+// cell of the raster that contains the codes in the range of [lo, hi].
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+    // non-zero if the cell is entirely inside of the polygon, otherwise the
+    // cell is on the boundary.
+    int inside;
+} geo_polygon_cell_t;
+
+// prepared polygon of the rings.
+// the inside of the polygon is determined by the even-odd rule, so the holes
+// and the multiple parts are represented by the rings of any orientation.
+// the edges are divided into the latitude bands of the bounding box, and the
+// ray casting scans only the edges of the band that contains the point.
+typedef struct {
+    geo_bbox_t bbox;
+    geo_polygon_edge_t *edges;
+    size_t nedge;
+    // edges of the band i are band_edges[band_off[i] .. band_off[i + 1] - 1]
+    uint32_t *band_off;
+    uint32_t *band_edges;
+    size_t nband;
+    double band_scale;
+    // raster of the cover cells in ascending order of the code
+    geo_polygon_cell_t *cells;
+    size_t ncell;
+    // identifier of the polygon in the keys of the cache
+    uint64_t serial;
+} geo_polygon_t;
+
+
+static inline void geo_polygon_free( geo_polygon_t *p )
+{
+    free( p->edges );
+    free( p->band_off );
+    free( p->band_edges );
+    free( p->cells );
+    *p = (geo_polygon_t){ 0 };
+}
+
+
+// returns the band that contains the latitude.
+static inline size_t geo_polygon_band( const geo_polygon_t *p, double lat )
+{
+    double band = ( lat - p->bbox.minlat ) * p->band_scale;
+
+    if( band <= 0 ){
+        return 0;
+    }
+    else if( band >= (double)( p->nband - 1 ) ){
+        return p->nband - 1;
+    }
+
+    return (size_t)band;
+}
+
+
+// tests the point by the ray casting to the east against the edges of the
+// band. the point on the boundary may be either inside or outside.
+static inline int geo_polygon_contains_exact( const geo_polygon_t *p,
+                                              double lat, double lon )
+{
+    size_t band = geo_polygon_band( p, lat );
+    const uint32_t *idx = p->band_edges + p->band_off[band];
+    const uint32_t *end = p->band_edges + p->band_off[band + 1];
+    int inside = 0;
+
+    for(; idx < end; idx++ )
+    {
+        const geo_polygon_edge_t *e = p->edges + *idx;
+
+        if( ( e->lat0 > lat ) != ( e->lat1 > lat ) &&
+            lon < e->lon0 + ( lat - e->lat0 ) * e->slope ){
+            inside ^= 1;
+        }
+    }
+
+    return inside;
+}
+
+
+// returns non-zero if the edge intersects the closed rectangle by the
+// liang-barsky clipping.
+static inline int geo_polygon_edge_hits( const geo_polygon_edge_t *e,
+                                         double minlat, double minlon,
+                                         double maxlat, double maxlon )
+{
+    double dlat = e->lat1 - e->lat0;
+    double dlon = e->lon1 - e->lon0;
+    double p[4] = { -dlon, dlon, -dlat, dlat };
+    double q[4] = {
+        e->lon0 - minlon, maxlon - e->lon0, e->lat0 - minlat, maxlat - e->lat0
+    };
+    double t0 = 0;
+    double t1 = 1;
+    int i = 0;
+
+    for(; i < 4; i++ )
+    {
+        if( p[i] == 0 ){
+            if( q[i] < 0 ){
+                return 0;
+            }
+        }
+        else
+        {
+            double r = q[i] / p[i];
+
+            if( p[i] < 0 ){
+                if( r > t1 ){
+                    return 0;
+                }
+                t0 = fmax( t0, r );
+            }
+            else {
+                if( r < t0 ){
+                    return 0;
+                }
+                t1 = fmin( t1, r );
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+// classifies the cell by the edges that touch it; the cell without the
+// edges is entirely inside or outside, and it is determined by its center.
+static inline geo_cover_e geo_polygon_classify( const void *region,
+                                                double minlat, double minlon,
+                                                double maxlat, double maxlon )
+{
+    const geo_polygon_t *p = (const geo_polygon_t*)region;
+    size_t band = 0;
+    size_t last = 0;
+
+    if( maxlat < p->bbox.minlat || minlat > p->bbox.maxlat ||
+        maxlon < p->bbox.minlon || minlon > p->bbox.maxlon ){
+        return GEO_COVER_OUTSIDE;
+    }
+
+    minlat -= GEO_POLYGON_EPSILON;
+    minlon -= GEO_POLYGON_EPSILON;
+    maxlat += GEO_POLYGON_EPSILON;
+    maxlon += GEO_POLYGON_EPSILON;
+    last = geo_polygon_band( p, maxlat );
+    for( band = geo_polygon_band( p, minlat ); band <= last; band++ )
+    {
+        uint32_t i = p->band_off[band];
+
+        for(; i < p->band_off[band + 1]; i++ ){
+            if( geo_polygon_edge_hits( p->edges + p->band_edges[i], minlat,
+                                       minlon, maxlat, maxlon ) ){
+                return GEO_COVER_PARTIAL;
+            }
+        }
+    }
+
+    if( geo_polygon_contains_exact( p, ( minlat + maxlat ) / 2,
+                                    ( minlon + maxlon ) / 2 ) ){
+        return GEO_COVER_INSIDE;
+    }
+
+    return GEO_COVER_OUTSIDE;
+}
+
+
+// distributes the edges into the latitude bands.
+static inline int geo_polygon_index_edges( geo_polygon_t *p )
+{
+    size_t nband = 1;
+    size_t total = 0;
+    size_t i = 0;
+
+    // the number of the edges per band is about the square root of the
+    // number of the edges
+    while( nband * nband < p->nedge && nband < GEO_POLYGON_MAX_BANDS ){
+        nband *= 2;
+    }
+    p->nband = nband;
+    p->band_scale = 0;
+    if( p->bbox.maxlat > p->bbox.minlat ){
+        p->band_scale = (double)nband / ( p->bbox.maxlat - p->bbox.minlat );
+    }
+    if( !( p->band_off = calloc( nband + 1, sizeof( uint32_t ) ) ) ){
+        return -1;
+    }
+
+    // count the edges of each band, and convert the counts into the offsets
+    for(; i < p->nedge; i++ )
+    {
+        const geo_polygon_edge_t *e = p->edges + i;
+        size_t lo = geo_polygon_band( p, fmin( e->lat0, e->lat1 ) );
+        size_t hi = geo_polygon_band( p, fmax( e->lat0, e->lat1 ) );
+
+        for(; lo <= hi; lo++ ){
+            p->band_off[lo + 1]++;
+        }
+    }
+    for( i = 0; i < nband; i++ ){
+        p->band_off[i + 1] += p->band_off[i];
+    }
+    total = p->band_off[nband];
+    if( total > UINT32_MAX ||
+        !( p->band_edges = malloc( sizeof( uint32_t ) * ( total + 1 ) ) ) ){
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // fill the bands and restore the offsets
+    for( i = 0; i < p->nedge; i++ )
+    {
+        const geo_polygon_edge_t *e = p->edges + i;
+        size_t lo = geo_polygon_band( p, fmin( e->lat0, e->lat1 ) );
+        size_t hi = geo_polygon_band( p, fmax( e->lat0, e->lat1 ) );
+
+        for(; lo <= hi; lo++ ){
+            p->band_edges[p->band_off[lo]++] = (uint32_t)i;
+        }
+    }
+    for( i = nband; i > 0; i-- ){
+        p->band_off[i] = p->band_off[i - 1];
+    }
+    p->band_off[0] = 0;
+
+    return 0;
+}
+
+
+// rasterizes the polygon into the cover cells of the specified precision.
+static inline int geo_polygon_rasterize( geo_polygon_t *p, size_t max_cells,
+                                         uint8_t precision )
+{
+    geo_hash_cell_t *cover = malloc( sizeof( geo_hash_cell_t ) *
+                                     GEO_HASH_COVER_SIZE( max_cells ) );
+    size_t ncell = 0;
+    size_t i = 0;
+
+    if( !cover ){
+        return -1;
+    }
+    ncell = geo_hash_cover( cover, max_cells, precision, geo_polygon_classify,
+                            p );
+    if( !( p->cells = malloc( sizeof( geo_polygon_cell_t ) * ( ncell + 1 ) ) ) ){
+        free( cover );
+        return -1;
+    }
+
+    // the cover does not keep the classification of the cells
+    for(; i < ncell; i++ )
+    {
+        const geo_hash_cell_t *cell = cover + i;
+        double minlat, minlon, maxlat, maxlon;
+        uint64_t hi, lo;
+
+        geo_hash_cell_bounds( cell, &minlat, &minlon, &maxlat, &maxlon );
+        geo_hash_interleave( cell->qlat, cell->qlon, &hi, &lo );
+        p->cells[i] = (geo_polygon_cell_t){
+            .lo = hi,
+            .hi = hi + ( UINT64_MAX >> ( cell->len * 5 ) ),
+            .inside = geo_polygon_classify( p, minlat, minlon, maxlat,
+                                            maxlon ) == GEO_COVER_INSIDE
+        };
+    }
+    p->ncell = ncell;
+    free( cover );
+
+    return 0;
+}
+
+
+// builds the polygon of the rings.
+// the rings are closed implicitly, and the first vertex may be repeated at
+// the end. the longitudes of each ring must not wrap around the antimeridian.
+// max_cells: max number of the raster cells. 0 disables the raster.
+// precision: max precision of the raster cells.
+static inline int geo_polygon_init( geo_polygon_t *p,
+                                    const geo_coords_t *rings, size_t nring,
+                                    size_t max_cells, uint8_t precision )
+{
+    size_t nedge = 0;
+    size_t i = 0;
+
+    *p = (geo_polygon_t){
+        .bbox = { 90, 180, -90, -180 }
+    };
+    for(; i < nring; i++ ){
+        if( rings[i].len < 3 ){
+            errno = EINVAL;
+            return -1;
+        }
+        nedge += rings[i].len;
+    }
+    if( !nedge || nedge > UINT32_MAX ){
+        errno = EINVAL;
+        return -1;
+    }
+    else if( !( p->edges = malloc( sizeof( geo_polygon_edge_t ) * nedge ) ) ){
+        return -1;
+    }
+
+    for( i = 0; i < nring; i++ )
+    {
+        const geo_coords_t *r = rings + i;
+        size_t j = 0;
+
+        for(; j < r->len; j++ )
+        {
+            size_t k = ( j + 1 ) % r->len;
+            geo_polygon_edge_t *e = p->edges + p->nedge++;
+
+            e->lat0 = r->lat[j * r->stride];
+            e->lon0 = r->lon[j * r->stride];
+            e->lat1 = r->lat[k * r->stride];
+            e->lon1 = r->lon[k * r->stride];
+            if( !GEO_IS_LATLON_RANGE( e->lat0, e->lon0 ) ){
+                geo_polygon_free( p );
+                errno = EINVAL;
+                return -1;
+            }
+            e->slope = 0;
+            if( e->lat1 != e->lat0 ){
+                e->slope = ( e->lon1 - e->lon0 ) / ( e->lat1 - e->lat0 );
+            }
+            p->bbox.minlat = fmin( p->bbox.minlat, e->lat0 );
+            p->bbox.minlon = fmin( p->bbox.minlon, e->lon0 );
+            p->bbox.maxlat = fmax( p->bbox.maxlat, e->lat0 );
+            p->bbox.maxlon = fmax( p->bbox.maxlon, e->lon0 );
+        }
+    }
+
+    if( geo_polygon_index_edges( p ) != 0 ||
+        ( max_cells && geo_polygon_rasterize( p, max_cells, precision ) ) ){
+        geo_polygon_free( p );
+        return -1;
+    }
+
+    return 0;
+}
+
+
+// returns the cell of the raster that contains the point, or NULL.
+static inline const geo_polygon_cell_t *geo_polygon_lookup(
+    const geo_polygon_t *p, double lat, double lon )
+{
+    uint64_t qlat, qlon, key, lo;
+    size_t head = 0;
+    size_t tail = p->ncell;
+
+    geo_hash_quantize_latlon( lat, lon, &qlat, &qlon );
+    geo_hash_interleave( qlat, qlon, &key, &lo );
+    // find the last cell whose lower bound is less than or equal to the key
+    while( head < tail )
+    {
+        size_t mid = head + ( tail - head ) / 2;
+
+        if( p->cells[mid].lo <= key ){
+            head = mid + 1;
+        }
+        else {
+            tail = mid;
+        }
+    }
+    if( head && key <= p->cells[head - 1].hi ){
+        return p->cells + head - 1;
+    }
+
+    return NULL;
+}
+
+
+// returns non-zero if the point is inside of the polygon.
+// the point in the inside cell of the raster is resolved by the lookup, and
+// the exact test runs only for the point in the boundary cell.
+static inline int geo_polygon_contains( const geo_polygon_t *p, double lat,
+                                        double lon )
+{
+    if( lat < p->bbox.minlat || lat > p->bbox.maxlat ||
+        lon < p->bbox.minlon || lon > p->bbox.maxlon ){
+        return 0;
+    }
+    else if( p->ncell )
+    {
+        const geo_polygon_cell_t *cell = geo_polygon_lookup( p, lat, lon );
+
+        // the raster covers all cells that intersect the polygon
+        if( !cell ){
+            return 0;
+        }
+        else if( cell->inside ){
+            return 1;
+        }
+    }
+
+    return geo_polygon_contains_exact( p, lat, lon );
+}
+
+
+#endif
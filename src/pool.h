@@ -0,0 +1,268 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/pool.h
+ *  lua-geo
+ *
+ *  worker pool that processes the large buffers of the batch functions.
+ */
+
+#ifndef geo_pool_h
+#define geo_pool_h
+
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lauxhlib.h"
+
+
+// maximum number of threads including the calling thread
+#define GEO_POOL_MAX_THREADS    256
+// number of items that a thread takes from the job at once
+#define GEO_POOL_CHUNK_SIZE     16384
+
+// processes the items in the range of [head, tail).
+typedef void (*geo_pool_fn_t)( void *ctx, size_t head, size_t tail );
+
+// The threads of the pool are created on demand and shared by all the
+// lua states that loaded the module, and they are joined when the last
+// lua state is closed.
+// The job is split into the chunks, and each thread takes the next chunk
+// by incrementing the atomic counter until no chunks remain, so the faster
+// threads process more chunks.
+typedef struct {
+    pthread_mutex_t mutex;
+    // notifies the workers of the new job or the shutdown
+    pthread_cond_t wake;
+    // notifies the caller of the completion of the job
+    pthread_cond_t done;
+    // held by the caller during the job
+    pthread_mutex_t busy;
+    pthread_t threads[GEO_POOL_MAX_THREADS - 1];
+    // sequence number of the job that the worker has seen
+    uint64_t seen[GEO_POOL_MAX_THREADS - 1];
+    int nthread;
+    // number of lua states that loaded the module
+    int refs;
+    int shutdown;
+    // current job
+    uint64_t seq;
+    int nworker;
+    int active;
+    geo_pool_fn_t fn;
+    void *ctx;
+    size_t len;
+    size_t chunk;
+    size_t next;
+} geo_pool_t;
+
+static geo_pool_t geo_pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .busy = PTHREAD_MUTEX_INITIALIZER
+};
+
+
+// stores the value into the location if it is less than the stored value.
+static inline void geo_pool_min( size_t *loc, size_t val )
+{
+    size_t cur = __atomic_load_n( loc, __ATOMIC_RELAXED );
+
+    while( val < cur &&
+           !__atomic_compare_exchange_n( loc, &cur, val, 1, __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED ) ){}
+}
+
+
+// processes the chunks of the job until no chunks remain.
+static inline void geo_pool_work( geo_pool_t *pool, geo_pool_fn_t fn,
+                                  void *ctx, size_t len, size_t chunk )
+{
+    size_t head = 0;
+
+    while( ( head = __atomic_fetch_add( &pool->next, chunk,
+                                        __ATOMIC_RELAXED ) ) < len )
+    {
+        size_t tail = len - head > chunk ? head + chunk : len;
+
+        fn( ctx, head, tail );
+    }
+}
+
+
+static void *geo_pool_worker( void *arg )
+{
+    geo_pool_t *pool = &geo_pool;
+    int id = (int)(intptr_t)arg;
+
+    pthread_mutex_lock( &pool->mutex );
+    for(;;)
+    {
+        while( !pool->shutdown && pool->seen[id] == pool->seq ){
+            pthread_cond_wait( &pool->wake, &pool->mutex );
+        }
+        if( pool->shutdown ){
+            break;
+        }
+
+        pool->seen[id] = pool->seq;
+        if( id < pool->nworker )
+        {
+            geo_pool_fn_t fn = pool->fn;
+            void *ctx = pool->ctx;
+            size_t len = pool->len;
+            size_t chunk = pool->chunk;
+
+            pthread_mutex_unlock( &pool->mutex );
+            geo_pool_work( pool, fn, ctx, len, chunk );
+            pthread_mutex_lock( &pool->mutex );
+            if( --pool->active == 0 ){
+                pthread_cond_signal( &pool->done );
+            }
+        }
+    }
+    pthread_mutex_unlock( &pool->mutex );
+
+    return NULL;
+}
+
+
+// processes the len items by the nthreads threads including the calling
+// thread. the items are processed by the calling thread alone if the pool
+// is used by another thread or failed to create the threads.
+static inline void geo_pool_run( int nthreads, size_t len, size_t chunk,
+                                 geo_pool_fn_t fn, void *ctx )
+{
+    geo_pool_t *pool = &geo_pool;
+    size_t nchunk = len / chunk + ( len % chunk != 0 );
+    int nworker = nthreads - 1;
+
+    if( (size_t)nworker >= nchunk ){
+        nworker = nchunk ? nchunk - 1 : 0;
+    }
+    if( nworker <= 0 || pthread_mutex_trylock( &pool->busy ) != 0 ){
+        fn( ctx, 0, len );
+        return;
+    }
+
+    pthread_mutex_lock( &pool->mutex );
+    for(; pool->nthread < nworker; pool->nthread++ )
+    {
+        int id = pool->nthread;
+
+        pool->seen[id] = pool->seq;
+        if( pthread_create( &pool->threads[id], NULL, geo_pool_worker,
+                            (void*)(intptr_t)id ) != 0 ){
+            nworker = id;
+            break;
+        }
+    }
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->len = len;
+    pool->chunk = chunk;
+    pool->next = 0;
+    pool->nworker = nworker;
+    pool->active = nworker;
+    pool->seq++;
+    pthread_cond_broadcast( &pool->wake );
+    pthread_mutex_unlock( &pool->mutex );
+
+    geo_pool_work( pool, fn, ctx, len, chunk );
+
+    pthread_mutex_lock( &pool->mutex );
+    while( pool->active ){
+        pthread_cond_wait( &pool->done, &pool->mutex );
+    }
+    pthread_mutex_unlock( &pool->mutex );
+    pthread_mutex_unlock( &pool->busy );
+}
+
+
+// joins the threads of the pool if the pool is no longer referenced.
+static inline void geo_pool_release( void )
+{
+    geo_pool_t *pool = &geo_pool;
+    int i = 0;
+
+    pthread_mutex_lock( &pool->mutex );
+    if( --pool->refs > 0 ){
+        pthread_mutex_unlock( &pool->mutex );
+        return;
+    }
+    pool->shutdown = 1;
+    pthread_cond_broadcast( &pool->wake );
+    pthread_mutex_unlock( &pool->mutex );
+
+    for(; i < pool->nthread; i++ ){
+        pthread_join( pool->threads[i], NULL );
+    }
+    pool->nthread = 0;
+    pool->shutdown = 0;
+}
+
+
+// called when the sentinel userdata of the lua state is collected.
+static int geo_pool_gc( lua_State *L )
+{
+    if( lua_touserdata( L, 1 ) ){
+        geo_pool_release();
+    }
+    return 0;
+}
+
+
+// references the pool from the lua state until the state is closed.
+static inline void geo_pool_open( lua_State *L )
+{
+    lua_newuserdata( L, 1 );
+    lua_createtable( L, 0, 1 );
+    lua_pushcfunction( L, geo_pool_gc );
+    lua_setfield( L, -2, "__gc" );
+    lua_setmetatable( L, -2 );
+    luaL_ref( L, LUA_REGISTRYINDEX );
+
+    pthread_mutex_lock( &geo_pool.mutex );
+    geo_pool.refs++;
+    pthread_mutex_unlock( &geo_pool.mutex );
+}
+
+
+// checks the number of threads at the specified index. 0 means the number of
+// the online processors.
+static inline int geo_pool_checkthreads( lua_State *L, int idx )
+{
+    lua_Integer n = lauxh_optinteger( L, idx, 1 );
+
+    lauxh_argcheck(
+        L, n >= 0 && n <= GEO_POOL_MAX_THREADS, idx,
+        "0-%d expected, got an out of range value", GEO_POOL_MAX_THREADS
+    );
+    if( n == 0 && ( n = sysconf( _SC_NPROCESSORS_ONLN ) ) < 1 ){
+        return 1;
+    }
+
+    return n > GEO_POOL_MAX_THREADS ? GEO_POOL_MAX_THREADS : (int)n;
+}
+
+
+#endif
@@ -26,134 +26,19 @@
  */
 
 #include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <math.h>
+
 // lua
 #include "lauxhlib.h"
-
-
-#define LATITUDE_MIN    -85.05112878
-#define LATITUDE_MAX    85.05112878
-#define LONGITUDE_MIN   -180
-#define LONGITUDE_MAX   180
-
-
-// Clips a number to the specified minimum and maximum values.
-// n: The number to clip.
-// minValue: Minimum allowable value.
-// maxValue: Maximum allowable value.
-// returns: The clipped value.
-static inline double getclip( double n, double minValue, double maxValue )
-{
-    return fmin( fmax( n, minValue ), maxValue );
-}
-
-
-// Determines the map width and height (in pixels) at a specified level
-// of detail.
-// lv: Level of detail, from 1 (lowest detail) to 23 (highest detail).
-// returns: The map width and height in pixels.
-static inline unsigned int getmapsize( int lv )
-{
-    return 256 << lv;
-}
-
-
-// Converts a point from latitude/longitude WGS-84 coordinates (in degrees)
-// into pixel XY coordinates at a specified level of detail.
-// lat: latitude of the point, in degrees.
-// lon: longitude of the point, in degrees.
-// lv: from 1 (lowest detail) to 23 (highest detail)
-// px: Output parameter receiving the X coordinate in pixels.
-// py: Output parameter receiving the Y coordinate in pixels.
-static void latlon2pixel( double lat, double lon, int lv, int *px, int *py )
-{
-    lat = getclip( lat, LATITUDE_MIN, LATITUDE_MAX );
-    lon = getclip( lon, LONGITUDE_MIN, LONGITUDE_MAX );
-
-    double x = ( lon  + 180) / 360;
-    double sinlat = sin( lat * M_PI / 180 );
-    double y = 0.5 - log( ( 1 + sinlat ) / ( 1 - sinlat ) ) / ( 4 * M_PI );
-    unsigned int mapsize = getmapsize( lv );
-
-    *px = (int)getclip( x * mapsize + 0.5, 0, mapsize - 1 );
-    *py = (int)getclip( y * mapsize + 0.5, 0, mapsize - 1 );
-}
-
-
-// Converts a pixel from pixel XY coordinates at a specified level of detail
-// into latitude/longitude WGS-84 coordinates (in degrees).
-// px: X coordinate of the point, in pixels.
-// py: Y coordinates of the point, in pixels.
-// lv: Level of detail, from 1 (lowest detail) to 23 (highest detail).
-// lat: Output parameter receiving the latitude in degrees.
-// lon: Output parameter receiving the longitude in degrees.
-static void pixel2latlon( int px, int py, int lv, double *lat, double *lon )
-{
-    double mapSize = getmapsize( lv );
-    double x = ( getclip( px, 0, mapSize - 1 ) / mapSize ) - 0.5;
-    double y = 0.5 - ( getclip( py, 0, mapSize - 1 ) / mapSize );
-
-    *lat = 90 - 360 * atan( exp( -y * 2 * M_PI ) ) / M_PI;
-    *lon = 360 * x;
-}
-
-
-// Converts pixel XY coordinates into tile XY coordinates of the tile containing
-// the specified pixel.
-// px: Pixel X coordinate.
-// py: Pixel Y coordinate.
-// tx: Output parameter receiving the tile X coordinate.
-// ty: Output parameter receiving the tile Y coordinate.
-static void pixel2tile( int px, int py, int *tx, int *ty )
-{
-    *tx = px / 256;
-    *ty = py / 256;
-}
-
-
-// Converts tile XY coordinates into pixel XY coordinates of the upper-left pixel
-// of the specified tile.
-// tx: Tile X coordinate.
-// ty: Tile Y coordinate.
-// px: Output parameter receiving the pixel X coordinate.
-// py: Output parameter receiving the pixel Y coordinate.
-static void tile2pixel( int tx, int ty, int *px, int *py )
-{
-    *px = tx * 256;
-    *py = ty * 256;
-}
-
-
-// Converts tile XY coordinates into a QuadKey at a specified level of detail.
-// tx: Tile X coordinate.
-// ty: Tile Y coordinate.
-// lv: Level of detail, from 1 (lowest detail) to 23 (highest detail).
-// returns: A string containing the QuadKey.
-static int tile2quadkey( char *quadkeys, int tx, int ty, int lv )
-{
-    int i = lv;
-    char digit = 0;
-    int mask = 0;
-    int len = 0;
-
-    for(; i > 0; i-- )
-    {
-        digit = '0';
-        mask = 1 << ( i - 1 );
-        if( ( tx & mask ) != 0 ){
-            digit++;
-        }
-        if( ( ty & mask ) != 0 ){
-            digit += 2;
-        }
-
-        quadkeys[len++] = digit;
-    }
-
-    return len;
-}
+#include "coords.h"
+#include "pool.h"
+#include "cover.h"
+#include "quadkeys.h"
 
 
 static int encode_lua( lua_State *L )
@@ -208,49 +93,6 @@ static int encode2tile_lua( lua_State *L )
     return 2;
 }
 
-
-// Converts a QuadKey into tile XY coordinates.
-// quadKey: QuadKey of the tile.
-// lv: Output parameter receiving the level of detail.
-// tx: Output parameter receiving the tile X coordinate.
-// ty: Output parameter receiving the tile Y coordinate.
-static int quadkey2tile( const char *quadKey, int lv, int *tx, int *ty )
-{
-    int i = lv;
-    int mask = 0;
-
-    *tx = *ty = 0;
-    for(; i > 0; i-- )
-    {
-        mask = 1 << ( i - 1 );
-        switch( quadKey[lv - i] )
-        {
-            case '0':
-                break;
-
-            case '1':
-                *tx |= mask;
-                break;
-
-            case '2':
-                *ty |= mask;
-                break;
-
-            case '3':
-                *tx |= mask;
-                *ty |= mask;
-                break;
-
-            // Invalid QuadKey digit sequence
-            default:
-                return -1;
-        }
-    }
-
-    return 0;
-}
-
-
 static int decode_lua( lua_State *L )
 {
     size_t len = 0;
@@ -358,15 +200,1027 @@ static int tile2key_lua( lua_State *L )
     return 1;
 }
 
-LUALIB_API int luaopen_geo_quadkeys( lua_State *L )
+typedef struct {
+    uint32_t tx;
+    uint32_t ty;
+    uint8_t lv;
+} tilecell_t;
+
+// Range of tile XY coordinates at the level of detail of the cover.
+typedef struct {
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t x1;
+    uint32_t y1;
+    int lv;
+    // the range crosses the antimeridian
+    int cross;
+} tilerange_t;
+
+// Classifies the range [lo, hi] against the range [min, max].
+static inline geo_cover_e classifyrange( uint32_t lo, uint32_t hi,
+                                         uint32_t min, uint32_t max )
+{
+    if( hi < min || lo > max ){
+        return GEO_COVER_OUTSIDE;
+    }
+    else if( lo >= min && hi <= max ){
+        return GEO_COVER_INSIDE;
+    }
+
+    return GEO_COVER_PARTIAL;
+}
+
+
+// Classifies the tile against the range.
+static geo_cover_e classifytile( const void *region, const void *tile )
+{
+    const tilerange_t *range = (const tilerange_t*)region;
+    const tilecell_t *cell = (const tilecell_t*)tile;
+    int shift = range->lv - cell->lv;
+    uint32_t x0 = cell->tx << shift;
+    uint32_t x1 = ( ( cell->tx + 1 ) << shift ) - 1;
+    uint32_t y0 = cell->ty << shift;
+    uint32_t y1 = ( ( cell->ty + 1 ) << shift ) - 1;
+    geo_cover_e cy = classifyrange( y0, y1, range->y0, range->y1 );
+    geo_cover_e cx = GEO_COVER_OUTSIDE;
+
+    if( cy == GEO_COVER_OUTSIDE ){
+        return GEO_COVER_OUTSIDE;
+    }
+    else if( !range->cross ){
+        cx = classifyrange( x0, x1, range->x0, range->x1 );
+    }
+    // crosses the antimeridian
+    else {
+        geo_cover_e east = classifyrange( x0, x1, range->x0, UINT32_MAX );
+        geo_cover_e west = classifyrange( x0, x1, 0, range->x1 );
+        cx = east > west ? east : west;
+    }
+
+    return cy < cx ? cy : cx;
+}
+
+
+static int comparetile( const void *a, const void *b )
 {
+    const tilecell_t *x = (const tilecell_t*)a;
+    const tilecell_t *y = (const tilecell_t*)b;
+    // left-aligned Morton code
+    uint64_t mx = tile2morton( x->tx, x->ty ) << ( ( 23 - x->lv ) * 2 );
+    uint64_t my = tile2morton( y->tx, y->ty ) << ( ( 23 - y->lv ) * 2 );
+
+    if( mx != my ){
+        return mx < my ? -1 : 1;
+    }
+
+    return x->lv - y->lv;
+}
+
+
+static void childtile( void *child, const void *tile, int i )
+{
+    const tilecell_t *cell = (const tilecell_t*)tile;
+
+    *(tilecell_t*)child = (tilecell_t){
+        ( cell->tx << 1 ) | ( i & 1 ), ( cell->ty << 1 ) | ( i >> 1 ),
+        cell->lv + 1
+    };
+}
+
+
+// Each tile is divided into the 4 tiles of the next level.
+static const geo_cover_grid_t TILE_GRID = {
+    .size = sizeof( tilecell_t ),
+    .lvoff = offsetof( tilecell_t, lv ),
+    .fanout = 4,
+    .child = childtile,
+    .classify = classifytile,
+    .cmp = comparetile
+};
+
+// Number of tiles that required to compute the cover of max_cells.
+#define TILECOVER_SIZE(max_cells)   GEO_COVER_SIZE( max_cells, 4 )
+
+// Computes the tiles that cover the range. See geo_cover.
+// cells: array of TILECOVER_SIZE( max_cells ) elements to store the result in
+//        ascending order of the QuadKey.
+// returns: the number of tiles.
+static size_t tilecover( tilecell_t *cells, size_t max_cells,
+                         const tilerange_t *range )
+{
+    return geo_cover( cells, max_cells, (uint8_t)range->lv, &TILE_GRID, range );
+}
+
+
+static int cover_lua( lua_State *L )
+{
+    lua_Number minlat = lauxh_checknumber( L, 1 );
+    lua_Number minlon = lauxh_checknumber( L, 2 );
+    lua_Number maxlat = lauxh_checknumber( L, 3 );
+    lua_Number maxlon = lauxh_checknumber( L, 4 );
+    lua_Integer max_cells = lauxh_checkinteger( L, 5 );
+    lua_Integer lv = lauxh_optinteger( L, 6, 23 );
+    tilerange_t range;
+    tilecell_t *cells = NULL;
+    size_t ncell = 0;
+    size_t i = 0;
+    int px = 0;
+    int py = 0;
+    int tx = 0;
+    int ty = 0;
+
+    lauxh_argcheck(
+        L, maxlat >= minlat, 3, "minlat or greater expected, got %f", maxlat
+    );
+    lauxh_argcheck(
+        L, max_cells > 0 && max_cells <= INT32_MAX, 5,
+        "positive integer expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, lv >= 1 && lv <= 23, 6, "1-23 expected, got an out of range value"
+    );
+
+    // the north-west and the south-east corners
+    latlon2pixel( maxlat, minlon, lv, &px, &py );
+    pixel2tile( px, py, &tx, &ty );
+    range.x0 = tx;
+    range.y0 = ty;
+    latlon2pixel( minlat, maxlon, lv, &px, &py );
+    pixel2tile( px, py, &tx, &ty );
+    range.x1 = tx;
+    range.y1 = ty;
+    range.lv = lv;
+    range.cross = minlon > maxlon;
+
+    cells = lua_newuserdata( L, sizeof( tilecell_t ) * TILECOVER_SIZE( max_cells ) );
+    ncell = tilecover( cells, max_cells, &range );
+    lua_createtable( L, ncell, 0 );
+    for(; i < ncell; i++ ){
+        char quadkey[23] = {0};
+        int len = tile2quadkey( quadkey, cells[i].tx, cells[i].ty, cells[i].lv );
+
+        lua_pushlstring( L, quadkey, len );
+        lua_rawseti( L, -2, i + 1 );
+    }
+
+    return 1;
+}
+
+
+// Maximum number of tiles on the stack of the iterator; the 4 tiles of level
+// 1 and the 3 siblings of each level that waiting to be visited.
+#define TILEITER_STACK_SIZE ( 4 + 3 * ( QUADKEY_MAX_LEVEL - 1 ) )
+
+// State of the depth-first traversal of the tiles that intersect the range.
+typedef struct {
+    tilerange_t range;
+    // the Morton codes of the remaining tiles of the subtree that is inside
+    // the range
+    uint64_t cur;
+    uint64_t end;
+    size_t ntile;
+    tilecell_t stack[TILEITER_STACK_SIZE];
+} tileiter_t;
+
+
+static void tileiter_init( tileiter_t *it, const tilerange_t *range )
+{
+    int pos = 3;
+
+    it->range = *range;
+    it->cur = it->end = 0;
+    it->ntile = 0;
+    for(; pos >= 0; pos-- ){
+        it->stack[it->ntile++] = (tilecell_t){ pos & 1, pos >> 1, 1 };
+    }
+}
+
+
+// Finds the next tile in the Morton order. The subtrees outside the range are
+// skipped, and the subtrees inside the range are enumerated by incrementing
+// the Morton code without classification.
+// returns: 0 if there are no more tiles.
+static int tileiter_next( tileiter_t *it, uint32_t *tx, uint32_t *ty )
+{
+    while( it->cur == it->end )
+    {
+        tilecell_t cell;
+        int pos = 3;
+
+        if( it->ntile == 0 ){
+            return 0;
+        }
+
+        cell = it->stack[--it->ntile];
+        switch( classifytile( &it->range, &cell ) )
+        {
+            case GEO_COVER_OUTSIDE:
+                break;
+
+            case GEO_COVER_INSIDE: {
+                int shift = ( it->range.lv - cell.lv ) * 2;
+                uint64_t code = tile2morton( cell.tx, cell.ty );
+
+                it->cur = code << shift;
+                it->end = ( code + 1 ) << shift;
+            } break;
+
+            // the tile at the level of the range is never partial
+            default:
+                for(; pos >= 0; pos-- ){
+                    it->stack[it->ntile++] = (tilecell_t){
+                        cell.tx * 2 + ( pos & 1 ), cell.ty * 2 + ( pos >> 1 ),
+                        cell.lv + 1
+                    };
+                }
+        }
+    }
+
+    *tx = compactbits( it->cur );
+    *ty = compactbits( it->cur >> 1 );
+    it->cur++;
+
+    return 1;
+}
+
+
+static int tiles_next_lua( lua_State *L )
+{
+    tileiter_t *it = lua_touserdata( L, lua_upvalueindex( 1 ) );
+    uint32_t tx = 0;
+    uint32_t ty = 0;
+
+    if( !tileiter_next( it, &tx, &ty ) ){
+        return 0;
+    }
+    lua_pushinteger( L, tx );
+    lua_pushinteger( L, ty );
+    lua_pushinteger( L, (lua_Integer)tile2int( tx, ty, it->range.lv ) );
+
+    return 3;
+}
+
+
+static int tiles_in_bbox_lua( lua_State *L )
+{
+    lua_Number minlat = lauxh_checknumber( L, 1 );
+    lua_Number minlon = lauxh_checknumber( L, 2 );
+    lua_Number maxlat = lauxh_checknumber( L, 3 );
+    lua_Number maxlon = lauxh_checknumber( L, 4 );
+    lua_Integer lv = lauxh_checkinteger( L, 5 );
+    tilerange_t range;
+    int px = 0;
+    int py = 0;
+    int tx = 0;
+    int ty = 0;
+
+    lauxh_argcheck(
+        L, maxlat >= minlat, 3, "minlat or greater expected, got %f", maxlat
+    );
+    lauxh_argcheck(
+        L, lv >= 1 && lv <= 23, 5, "1-23 expected, got an out of range value"
+    );
+
+    // the north-west and the south-east corners
+    latlon2pixel( maxlat, minlon, lv, &px, &py );
+    pixel2tile( px, py, &tx, &ty );
+    range.x0 = tx;
+    range.y0 = ty;
+    latlon2pixel( minlat, maxlon, lv, &px, &py );
+    pixel2tile( px, py, &tx, &ty );
+    range.x1 = tx;
+    range.y1 = ty;
+    range.lv = lv;
+    range.cross = minlon > maxlon;
+
+    tileiter_init( lua_newuserdata( L, sizeof( tileiter_t ) ), &range );
+    lua_pushcclosure( L, tiles_next_lua, 1 );
+
+    return 1;
+}
+
+
+// MARK: batch
+static const char *const BATCH_FORMATS[] = {
+    "tile", "morton", NULL
+};
+
+enum {
+    BATCH_TILE = 0,
+    BATCH_MORTON
+};
+
+// job of the batch functions.
+typedef struct {
+    geo_coords_t coords;
+    int lv;
+    int fmt;
+    void *out;
+    const double *values;
+} tilejob_t;
+
+
+static void encode_batch_job( void *ctx, size_t head, size_t tail )
+{
+    tilejob_t *job = (tilejob_t*)ctx;
+    size_t stride = job->coords.stride;
+    size_t n = 0;
+
+    for(; head < tail; head += n )
+    {
+        uint32_t tx[TILE_BLOCK_SIZE];
+        uint32_t ty[TILE_BLOCK_SIZE];
+        size_t i = 0;
+
+        n = tail - head > TILE_BLOCK_SIZE ? TILE_BLOCK_SIZE : tail - head;
+        tilekernel( tx, ty, job->coords.lat + head * stride,
+                    job->coords.lon + head * stride, stride, n, job->lv );
+        if( job->fmt == BATCH_TILE ){
+            uint32_t *xy = (uint32_t*)job->out + head * 2;
+
+            for(; i < n; i++ ){
+                xy[i * 2] = tx[i];
+                xy[i * 2 + 1] = ty[i];
+            }
+        }
+        else {
+            uint64_t *codes = (uint64_t*)job->out + head;
+
+            for(; i < n; i++ ){
+                codes[i] = tile2morton( tx[i], ty[i] );
+            }
+        }
+    }
+}
+
+
+static int encode_batch_lua( lua_State *L )
+{
+    tilejob_t job;
+    lua_Integer lv = lauxh_checkinteger( L, 2 );
+    int fmt = luaL_checkoption( L, 3, "tile", BATCH_FORMATS );
+    int nthreads = geo_pool_checkthreads( L, 4 );
+    // size of the encoded coordinate
+    size_t size = fmt == BATCH_TILE ? sizeof( uint32_t ) * 2 :
+                                      sizeof( uint64_t );
+
+    geo_checkcoords( L, 1, &job.coords );
+    lauxh_argcheck(
+        L, lv >= 1 && lv <= 23, 2, "1-23 expected, got an out of range value"
+    );
+
+    job.lv = lv;
+    job.fmt = fmt;
+    job.out = lua_newuserdata( L, job.coords.len * size + 1 );
+    geo_pool_run( nthreads, job.coords.len, GEO_POOL_CHUNK_SIZE,
+                  encode_batch_job, &job );
+    lua_pushlstring( L, job.out, job.coords.len * size );
+
+    return 1;
+}
+
+
+static inline uint64_t checkquadkeyint( lua_State *L, int idx )
+{
+    uint64_t code = (uint64_t)lauxh_checkinteger( L, idx );
+
+    lauxh_argcheck(
+        L, quadkey_isint( code ), idx,
+        "integer quadkey expected, got an invalid code"
+    );
+
+    return code;
+}
+
+
+static int encode_int_lua( lua_State *L )
+{
+    lua_Number lat = lauxh_checknumber( L, 1 );
+    lua_Number lon = lauxh_checknumber( L, 2 );
+    lua_Integer lv = lauxh_optinteger( L, 3, QUADKEY_MAX_LEVEL );
+    int px = 0;
+    int py = 0;
+    int tx = 0;
+    int ty = 0;
+
+    lauxh_argcheck(
+        L, lv >= 1 && lv <= 23, 3, "1-23 expected, got an out of range value"
+    );
+
+    latlon2pixel( lat, lon, lv, &px, &py );
+    pixel2tile( px, py, &tx, &ty );
+    lua_pushinteger( L, (lua_Integer)tile2int( tx, ty, lv ) );
+
+    return 1;
+}
+
+
+static int tile2int_lua( lua_State *L )
+{
+    lua_Integer tx = lauxh_checkinteger( L, 1 );
+    lua_Integer ty = lauxh_checkinteger( L, 2 );
+    lua_Integer lv = lauxh_optinteger( L, 3, QUADKEY_MAX_LEVEL );
+
+    lauxh_argcheck(
+        L, lv >= 0 && lv <= 23, 3, "0-23 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, tx >= 0 && tx >> lv == 0, 1, "tile X coordinate out of range"
+    );
+    lauxh_argcheck(
+        L, ty >= 0 && ty >> lv == 0, 2, "tile Y coordinate out of range"
+    );
+
+    lua_pushinteger( L, (lua_Integer)tile2int( tx, ty, lv ) );
+
+    return 1;
+}
+
+
+static int int2tile_lua( lua_State *L )
+{
+    uint64_t code = checkquadkeyint( L, 1 );
+    uint32_t tx = 0;
+    uint32_t ty = 0;
+    int lv = 0;
+
+    int2tile( code, &tx, &ty, &lv );
+    lua_pushinteger( L, tx );
+    lua_pushinteger( L, ty );
+    lua_pushinteger( L, lv );
+
+    return 3;
+}
+
+
+static int int2key_lua( lua_State *L )
+{
+    uint64_t code = checkquadkeyint( L, 1 );
+    uint64_t morton = code >> ( __builtin_ctzll( code ) + 1 );
+    int lv = quadkey_level( code );
+    char quadkey[QUADKEY_MAX_LEVEL] = {0};
+    int i = 0;
+
+    for(; i < lv; i++ ){
+        quadkey[i] = '0' + ( ( morton >> ( ( lv - i - 1 ) * 2 ) ) & 3 );
+    }
+    lua_pushlstring( L, quadkey, lv );
+
+    return 1;
+}
+
+
+static int key2int_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *quadkey = lauxh_checklstring( L, 1, &len );
+    uint64_t morton = 0;
+    size_t i = 0;
+
+    lauxh_argcheck(
+        L, len <= QUADKEY_MAX_LEVEL, 1,
+        "length between 0 and 23 expected, got an out of range value"
+    );
+
+    for(; i < len; i++ )
+    {
+        unsigned char c = quadkey[i] - '0';
+
+        // invalid quadkey digit
+        if( c > 3 ){
+            lua_pushnil( L );
+            lua_pushstring( L, strerror( EILSEQ ) );
+            return 2;
+        }
+        morton = ( morton << 2 ) | c;
+    }
+
+    lua_pushinteger(
+        L, (lua_Integer)( ( ( morton << 1 ) | 1 ) <<
+                          ( ( QUADKEY_MAX_LEVEL - len ) * 2 ) )
+    );
+
+    return 1;
+}
+
+
+static int level_lua( lua_State *L )
+{
+    lua_pushinteger( L, quadkey_level( checkquadkeyint( L, 1 ) ) );
+    return 1;
+}
+
+
+static int parent_lua( lua_State *L )
+{
+    uint64_t code = checkquadkeyint( L, 1 );
+    int clv = quadkey_level( code );
+    lua_Integer lv = lauxh_optinteger( L, 2, clv - 1 );
+
+    // the root tile has no parent
+    if( clv == 0 && lua_isnoneornil( L, 2 ) ){
+        lua_pushnil( L );
+        return 1;
+    }
+    lauxh_argcheck(
+        L, lv >= 0 && lv <= clv, 2,
+        "0-%d expected, got an out of range value", clv
+    );
+
+    lua_pushinteger( L, (lua_Integer)quadkey_parent( code, lv ) );
+
+    return 1;
+}
+
+
+static int children_lua( lua_State *L )
+{
+    uint64_t code = checkquadkeyint( L, 1 );
+    int pos = 0;
+
+    // the tiles of the maximum level have no children
+    if( quadkey_level( code ) == QUADKEY_MAX_LEVEL ){
+        return 0;
+    }
+    for(; pos < 4; pos++ ){
+        lua_pushinteger( L, (lua_Integer)quadkey_child( code, pos ) );
+    }
+
+    return 4;
+}
+
+
+static int contains_lua( lua_State *L )
+{
+    uint64_t code = checkquadkeyint( L, 1 );
+    uint64_t other = checkquadkeyint( L, 2 );
+
+    lua_pushboolean( L, quadkey_contains( code, other ) );
+
+    return 1;
+}
+
+
+// MARK: pyramid
+// Point of the pyramid that encoded at the deepest level.
+typedef struct {
+    uint64_t code;
+    double value;
+} tilepoint_t;
+
+
+// Sorts the points by the Morton code of the bits by the LSD radix sort.
+// returns: pts or tmp that contains the sorted points.
+static tilepoint_t *tilepoint_sort( tilepoint_t *pts, tilepoint_t *tmp,
+                                    size_t len, int bits )
+{
+    int shift = 0;
+
+    for(; shift < bits && len > 1; shift += 8 )
+    {
+        size_t count[256] = {0};
+        size_t i = 0;
+        size_t pos = 0;
+        tilepoint_t *swap = NULL;
+
+        for(; i < len; i++ ){
+            count[( pts[i].code >> shift ) & 0xFF]++;
+        }
+        // all the points are in the same bucket
+        if( count[( pts[0].code >> shift ) & 0xFF] == len ){
+            continue;
+        }
+        for( i = 0; i < 256; i++ ){
+            size_t n = count[i];
+            count[i] = pos;
+            pos += n;
+        }
+        for( i = 0; i < len; i++ ){
+            tmp[count[( pts[i].code >> shift ) & 0xFF]++] = pts[i];
+        }
+        swap = pts;
+        pts = tmp;
+        tmp = swap;
+    }
+
+    return pts;
+}
+
+
+// Pushes the table of the aggregated tiles of the level that contains the
+// packed integer quadkeys, counts and sums.
+static void push_pyramid_level( lua_State *L, uint64_t *codes,
+                                const uint64_t *counts, const double *sums,
+                                size_t len, int lv )
+{
+    int shift = ( QUADKEY_MAX_LEVEL - lv ) * 2;
+    size_t i = 0;
+
     lua_createtable( L, 0, 3 );
+    // converts the Morton codes into the integer quadkeys temporarily
+    for(; i < len; i++ ){
+        codes[i] = ( ( codes[i] << 1 ) | 1 ) << shift;
+    }
+    lua_pushlstring( L, (const char*)codes, sizeof( uint64_t ) * len );
+    lua_setfield( L, -2, "codes" );
+    for( i = 0; i < len; i++ ){
+        codes[i] >>= shift + 1;
+    }
+    lua_pushlstring( L, (const char*)counts, sizeof( uint64_t ) * len );
+    lua_setfield( L, -2, "counts" );
+    if( sums ){
+        lua_pushlstring( L, (const char*)sums, sizeof( double ) * len );
+        lua_setfield( L, -2, "sums" );
+    }
+    lua_rawseti( L, -2, lv );
+}
+
+
+static void pyramid_job( void *ctx, size_t head, size_t tail )
+{
+    tilejob_t *job = (tilejob_t*)ctx;
+    tilepoint_t *pts = (tilepoint_t*)job->out;
+    size_t stride = job->coords.stride;
+    size_t n = 0;
+
+    for(; head < tail; head += n )
+    {
+        uint32_t tx[TILE_BLOCK_SIZE];
+        uint32_t ty[TILE_BLOCK_SIZE];
+        size_t i = 0;
+
+        n = tail - head > TILE_BLOCK_SIZE ? TILE_BLOCK_SIZE : tail - head;
+        tilekernel( tx, ty, job->coords.lat + head * stride,
+                    job->coords.lon + head * stride, stride, n, job->lv );
+        for(; i < n; i++ ){
+            pts[head + i].code = tile2morton( tx[i], ty[i] );
+            pts[head + i].value = job->values ? job->values[head + i] : 0;
+        }
+    }
+}
+
+
+static int pyramid_lua( lua_State *L )
+{
+    geo_coords_t coords;
+    lua_Integer minlv = lauxh_checkinteger( L, 2 );
+    lua_Integer maxlv = lauxh_checkinteger( L, 3 );
+    size_t nval = 0;
+    const double *values = (const double*)lauxh_optlstring( L, 4, NULL,
+                                                            &nval );
+    int nthreads = geo_pool_checkthreads( L, 5 );
+    tilejob_t job;
+    tilepoint_t *pts = NULL;
+    tilepoint_t *sorted = NULL;
+    uint64_t *codes = NULL;
+    uint64_t *counts = NULL;
+    double *sums = NULL;
+    size_t len = 0;
+    size_t i = 0;
+    int lv = 0;
+
+    geo_checkcoords( L, 1, &coords );
+    lauxh_argcheck(
+        L, minlv >= 1 && minlv <= 23, 2,
+        "1-23 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, maxlv >= minlv && maxlv <= 23, 3,
+        "minlv-23 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, !values || nval == sizeof( double ) * coords.len, 4,
+        "%d values expected", (int)coords.len
+    );
+
+    // allocates one more point to avoid the zero-size allocation
+    pts = lua_newuserdata( L, sizeof( tilepoint_t ) * ( coords.len + 1 ) * 2 );
+
+    // encodes the points at the deepest level
+    job.coords = coords;
+    job.lv = maxlv;
+    job.out = pts;
+    job.values = values;
+    geo_pool_run( nthreads, coords.len, GEO_POOL_CHUNK_SIZE, pyramid_job,
+                  &job );
+    sorted = tilepoint_sort( pts, pts + coords.len + 1, coords.len,
+                             maxlv * 2 );
+
+    // aggregates the sorted points into the arrays of the other half of the
+    // allocated memory, and the sums into the head of the sorted points that
+    // have already been read.
+    codes = (uint64_t*)( sorted == pts ? pts + coords.len + 1 : pts );
+    counts = codes + coords.len + 1;
+    sums = (double*)sorted;
+    for( i = 0; i < coords.len; i++ )
+    {
+        double value = sorted[i].value;
+
+        if( len && codes[len - 1] == sorted[i].code ){
+            counts[len - 1]++;
+            sums[len - 1] += value;
+        }
+        else {
+            codes[len] = sorted[i].code;
+            counts[len] = 1;
+            sums[len] = value;
+            len++;
+        }
+    }
+
+    // derives the coarser levels from the finer level by shifting the codes
+    lua_createtable( L, maxlv, 0 );
+    for( lv = maxlv;; )
+    {
+        size_t n = 0;
+
+        push_pyramid_level( L, codes, counts, values ? sums : NULL, len, lv );
+        if( --lv < minlv ){
+            break;
+        }
+        for( i = 0; i < len; i++ )
+        {
+            uint64_t code = codes[i] >> 2;
+
+            if( n && codes[n - 1] == code ){
+                counts[n - 1] += counts[i];
+                sums[n - 1] += sums[i];
+            }
+            else {
+                codes[n] = code;
+                counts[n] = counts[i];
+                sums[n] = sums[i];
+                n++;
+            }
+        }
+        len = n;
+    }
+
+    return 1;
+}
+
+
+// MARK: cluster
+// Default radius of the cluster in pixels.
+#define CLUSTER_RADIUS  60
+
+// Bucket of the grid of the radius pixels.
+typedef struct {
+    // grid coordinates; gy << 32 | gx
+    uint64_t key;
+    uint64_t count;
+    // sums of the coordinates and the pixel coordinates of the points
+    double lat;
+    double lon;
+    double px;
+    double py;
+    // index of the cluster plus 1; 0 if not merged yet
+    uint32_t cluster;
+} gridbucket_t;
+
+typedef struct {
+    uint64_t count;
+    uint32_t idx;
+} gridorder_t;
+
+// Open addressing table of the buckets that allocated from the arena.
+typedef struct {
+    gridbucket_t *buckets;
+    size_t nbucket;
+    // index of the bucket plus 1; 0 if empty
+    uint32_t *slots;
+    uint64_t mask;
+    int bits;
+} gridtable_t;
+
+
+static inline uint32_t *gridtable_slot( const gridtable_t *t, uint64_t key )
+{
+    uint64_t pos = ( key * 0x9E3779B97F4A7C15ULL ) >> ( 64 - t->bits );
+
+    for(;; pos = ( pos + 1 ) & t->mask ){
+        uint32_t *slot = t->slots + pos;
+
+        if( !*slot || t->buckets[*slot - 1].key == key ){
+            return slot;
+        }
+    }
+}
+
+
+// Returns the bucket of the grid coordinates, or NULL.
+static inline gridbucket_t *gridtable_get( const gridtable_t *t, int64_t gx,
+                                           int64_t gy )
+{
+    uint32_t *slot = NULL;
+
+    if( gx < 0 || gy < 0 ){
+        return NULL;
+    }
+    slot = gridtable_slot( t, ( (uint64_t)gy << 32 ) | (uint64_t)gx );
+
+    return *slot ? t->buckets + *slot - 1 : NULL;
+}
+
+
+static int gridorder_cmp( const void *a, const void *b )
+{
+    const gridorder_t *x = (const gridorder_t*)a;
+    const gridorder_t *y = (const gridorder_t*)b;
+
+    if( x->count != y->count ){
+        return x->count < y->count ? 1 : -1;
+    }
+    return ( x->idx > y->idx ) - ( x->idx < y->idx );
+}
+
+
+static int cluster_lua( lua_State *L )
+{
+    geo_coords_t coords;
+    lua_Integer lv = lauxh_checkinteger( L, 2 );
+    lua_Integer radius = lauxh_optinteger( L, 3, CLUSTER_RADIUS );
+    gridtable_t t = { NULL, 0, NULL, 0, 1 };
+    gridorder_t *order = NULL;
+    uint32_t *pbucket = NULL;
+    double *centroids = NULL;
+    uint64_t *counts = NULL;
+    uint64_t *offsets = NULL;
+    int64_t *ids = NULL;
+    size_t ncluster = 0;
+    size_t i = 0;
+    char *arena = NULL;
+
+    geo_checkcoords( L, 1, &coords );
+    lauxh_argcheck(
+        L, coords.len < UINT32_MAX, 1, "too many coordinates"
+    );
+    lauxh_argcheck(
+        L, lv >= 0 && lv <= 23, 2, "0-23 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, radius > 0 && radius <= 65536, 3,
+        "1-65536 expected, got an out of range value"
+    );
+
+    // allocates all the arrays from the arena at once
+    while( ( (size_t)1 << t.bits ) < ( coords.len + 1 ) * 2 ){
+        t.bits++;
+    }
+    t.mask = ( (uint64_t)1 << t.bits ) - 1;
+    arena = lua_newuserdata( L, ( sizeof( gridbucket_t ) +
+                                  sizeof( gridorder_t ) +
+                                  sizeof( double ) * 2 +
+                                  sizeof( uint64_t ) * 2 ) *
+                                ( coords.len + 1 ) +
+                                sizeof( int64_t ) * coords.len +
+                                sizeof( uint32_t ) *
+                                ( coords.len + ( (size_t)1 << t.bits ) ) );
+    t.buckets = (gridbucket_t*)arena;
+    order = (gridorder_t*)( t.buckets + coords.len + 1 );
+    centroids = (double*)( order + coords.len + 1 );
+    counts = (uint64_t*)( centroids + ( coords.len + 1 ) * 2 );
+    offsets = counts + coords.len + 1;
+    ids = (int64_t*)( offsets + coords.len + 1 );
+    t.slots = (uint32_t*)( ids + coords.len );
+    pbucket = t.slots + t.mask + 1;
+    memset( t.slots, 0, sizeof( uint32_t ) * ( t.mask + 1 ) );
+
+    // puts the points into the buckets of the grid in a single pass
+    for(; i < coords.len; i++ )
+    {
+        double lat = coords.lat[i * coords.stride];
+        double lon = coords.lon[i * coords.stride];
+        int px = 0;
+        int py = 0;
+        uint64_t key = 0;
+        uint32_t *slot = NULL;
+        gridbucket_t *b = NULL;
+
+        latlon2pixel( lat, lon, lv, &px, &py );
+        key = ( (uint64_t)( (unsigned int)py / radius ) << 32 ) |
+              (uint64_t)( (unsigned int)px / radius );
+        slot = gridtable_slot( &t, key );
+        if( !*slot ){
+            t.buckets[t.nbucket] = (gridbucket_t){ .key = key };
+            *slot = (uint32_t)++t.nbucket;
+        }
+        b = t.buckets + *slot - 1;
+        b->count++;
+        b->lat += lat;
+        b->lon += lon;
+        b->px += px;
+        b->py += py;
+        pbucket[i] = *slot - 1;
+    }
+
+    // the denser buckets absorb the neighboring buckets whose centroid is
+    // within the radius of their centroid
+    for( i = 0; i < t.nbucket; i++ ){
+        order[i] = (gridorder_t){ t.buckets[i].count, (uint32_t)i };
+    }
+    qsort( order, t.nbucket, sizeof( gridorder_t ), gridorder_cmp );
+    for( i = 0; i < t.nbucket; i++ )
+    {
+        gridbucket_t *seed = t.buckets + order[i].idx;
+        int64_t gx = (int64_t)( seed->key & 0xFFFFFFFF );
+        int64_t gy = (int64_t)( seed->key >> 32 );
+        double cx = seed->px / seed->count;
+        double cy = seed->py / seed->count;
+        double lat = 0;
+        double lon = 0;
+        int dy = -1;
+
+        if( seed->cluster ){
+            continue;
+        }
+        counts[ncluster] = 0;
+        for(; dy <= 1; dy++ )
+        {
+            int dx = -1;
+
+            for(; dx <= 1; dx++ )
+            {
+                gridbucket_t *b = gridtable_get( &t, gx + dx, gy + dy );
+                double ddx = 0;
+                double ddy = 0;
+
+                if( !b || b->cluster ){
+                    continue;
+                }
+                ddx = b->px / b->count - cx;
+                ddy = b->py / b->count - cy;
+                if( ddx * ddx + ddy * ddy <= (double)( radius * radius ) ){
+                    b->cluster = (uint32_t)ncluster + 1;
+                    counts[ncluster] += b->count;
+                    lat += b->lat;
+                    lon += b->lon;
+                }
+            }
+        }
+        centroids[ncluster * 2] = lat / counts[ncluster];
+        centroids[ncluster * 2 + 1] = lon / counts[ncluster];
+        ncluster++;
+    }
+
+    // groups the ids of the points by the cluster
+    offsets[0] = 0;
+    for( i = 1; i < ncluster; i++ ){
+        offsets[i] = offsets[i - 1] + counts[i - 1];
+    }
+    for( i = 0; i < coords.len; i++ ){
+        uint32_t c = t.buckets[pbucket[i]].cluster - 1;
+
+        ids[offsets[c]++] = coords.ids ? coords.ids[i] : (int64_t)i + 1;
+    }
+    for( i = 0; i < ncluster; i++ ){
+        offsets[i] -= counts[i];
+    }
+
+    lua_createtable( L, 0, 4 );
+    lua_pushlstring( L, (const char*)centroids,
+                     sizeof( double ) * 2 * ncluster );
+    lua_setfield( L, -2, "coords" );
+    lua_pushlstring( L, (const char*)counts, sizeof( uint64_t ) * ncluster );
+    lua_setfield( L, -2, "counts" );
+    lua_pushlstring( L, (const char*)offsets, sizeof( uint64_t ) * ncluster );
+    lua_setfield( L, -2, "offsets" );
+    lua_pushlstring( L, (const char*)ids, sizeof( int64_t ) * coords.len );
+    lua_setfield( L, -2, "ids" );
+
+    return 1;
+}
+
+
+LUALIB_API int luaopen_geo_quadkeys( lua_State *L )
+{
+    tilekernel_init();
+    geo_pool_open( L );
+
+    lua_createtable( L, 0, 21 );
     lauxh_pushfn2tbl( L, "encode", encode_lua );
     lauxh_pushfn2tbl( L, "encode2tile", encode2tile_lua );
     lauxh_pushfn2tbl( L, "decode", decode_lua );
     lauxh_pushfn2tbl( L, "decode2tile", decode2tile_lua );
     lauxh_pushfn2tbl( L, "tile2latlon", tile2latlon_lua );
     lauxh_pushfn2tbl( L, "tile2key", tile2key_lua );
+    lauxh_pushfn2tbl( L, "cover", cover_lua );
+    lauxh_pushfn2tbl( L, "tiles_in_bbox", tiles_in_bbox_lua );
+    lauxh_pushfn2tbl( L, "encode_batch", encode_batch_lua );
+    lauxh_pushfn2tbl( L, "pyramid", pyramid_lua );
+    lauxh_pushfn2tbl( L, "cluster", cluster_lua );
+    lauxh_pushfn2tbl( L, "encode_int", encode_int_lua );
+    lauxh_pushfn2tbl( L, "tile2int", tile2int_lua );
+    lauxh_pushfn2tbl( L, "int2tile", int2tile_lua );
+    lauxh_pushfn2tbl( L, "int2key", int2key_lua );
+    lauxh_pushfn2tbl( L, "key2int", key2int_lua );
+    lauxh_pushfn2tbl( L, "level", level_lua );
+    lauxh_pushfn2tbl( L, "parent", parent_lua );
+    lauxh_pushfn2tbl( L, "children", children_lua );
+    lauxh_pushfn2tbl( L, "contains", contains_lua );
+    // name of the batch kernel selected for this cpu
+    lauxh_pushstr2tbl( L, "kernel", tilekernel_name );
 
     return 1;
 }
@@ -0,0 +1,552 @@
+/*
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/quadkeys.h
+ *  lua-geo
+ *
+ *  projection, tile and integer quadkey conversions of the quadkeys module.
+ */
+
+#ifndef geo_quadkeys_h
+#define geo_quadkeys_h
+
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#if defined(__x86_64__) && ( defined(__GNUC__) || defined(__clang__) ) && \
+    !defined(QUADKEYS_NO_SIMD)
+#define QUADKEYS_X86_SIMD
+#include <immintrin.h>
+#endif
+#include "geo.h"
+
+
+#define LATITUDE_MIN    -85.05112878
+#define LATITUDE_MAX    85.05112878
+#define LONGITUDE_MIN   -180
+#define LONGITUDE_MAX   180
+
+
+// Clips a number to the specified minimum and maximum values.
+// n: The number to clip.
+// minValue: Minimum allowable value.
+// maxValue: Maximum allowable value.
+// returns: The clipped value.
+static inline double getclip( double n, double minValue, double maxValue )
+{
+    return fmin( fmax( n, minValue ), maxValue );
+}
+
+
+// Determines the map width and height (in pixels) at a specified level
+// of detail.
+// lv: Level of detail, from 1 (lowest detail) to 23 (highest detail).
+// returns: The map width and height in pixels.
+static inline unsigned int getmapsize( int lv )
+{
+    return 256 << lv;
+}
+
+
+// Converts a point from latitude/longitude WGS-84 coordinates (in degrees)
+// into pixel XY coordinates at a specified level of detail.
+// lat: latitude of the point, in degrees.
+// lon: longitude of the point, in degrees.
+// lv: from 1 (lowest detail) to 23 (highest detail)
+// px: Output parameter receiving the X coordinate in pixels.
+// py: Output parameter receiving the Y coordinate in pixels.
+static inline void latlon2pixel( double lat, double lon, int lv, int *px,
+                                 int *py )
+{
+    lat = getclip( lat, LATITUDE_MIN, LATITUDE_MAX );
+    lon = getclip( lon, LONGITUDE_MIN, LONGITUDE_MAX );
+
+    double x = ( lon  + 180) / 360;
+    double sinlat = sin( lat * M_PI / 180 );
+    double y = 0.5 - log( ( 1 + sinlat ) / ( 1 - sinlat ) ) / ( 4 * M_PI );
+    unsigned int mapsize = getmapsize( lv );
+
+    *px = (int)getclip( x * mapsize + 0.5, 0, mapsize - 1 );
+    *py = (int)getclip( y * mapsize + 0.5, 0, mapsize - 1 );
+}
+
+
+// Converts a pixel from pixel XY coordinates at a specified level of detail
+// into latitude/longitude WGS-84 coordinates (in degrees).
+// px: X coordinate of the point, in pixels.
+// py: Y coordinates of the point, in pixels.
+// lv: Level of detail, from 1 (lowest detail) to 23 (highest detail).
+// lat: Output parameter receiving the latitude in degrees.
+// lon: Output parameter receiving the longitude in degrees.
+static inline void pixel2latlon( int px, int py, int lv, double *lat,
+                                 double *lon )
+{
+    double mapSize = getmapsize( lv );
+    double x = ( getclip( px, 0, mapSize - 1 ) / mapSize ) - 0.5;
+    double y = 0.5 - ( getclip( py, 0, mapSize - 1 ) / mapSize );
+
+    *lat = 90 - 360 * atan( exp( -y * 2 * M_PI ) ) / M_PI;
+    *lon = 360 * x;
+}
+
+
+// Converts pixel XY coordinates into tile XY coordinates of the tile containing
+// the specified pixel.
+// px: Pixel X coordinate.
+// py: Pixel Y coordinate.
+// tx: Output parameter receiving the tile X coordinate.
+// ty: Output parameter receiving the tile Y coordinate.
+static inline void pixel2tile( int px, int py, int *tx, int *ty )
+{
+    *tx = px / 256;
+    *ty = py / 256;
+}
+
+
+// Converts tile XY coordinates into pixel XY coordinates of the upper-left pixel
+// of the specified tile.
+// tx: Tile X coordinate.
+// ty: Tile Y coordinate.
+// px: Output parameter receiving the pixel X coordinate.
+// py: Output parameter receiving the pixel Y coordinate.
+static inline void tile2pixel( int tx, int ty, int *px, int *py )
+{
+    *px = tx * 256;
+    *py = ty * 256;
+}
+
+
+// Converts tile XY coordinates into a QuadKey at a specified level of detail.
+// tx: Tile X coordinate.
+// ty: Tile Y coordinate.
+// lv: Level of detail, from 1 (lowest detail) to 23 (highest detail).
+// returns: A string containing the QuadKey.
+static inline int tile2quadkey( char *quadkeys, int tx, int ty, int lv )
+{
+    int i = lv;
+    char digit = 0;
+    int mask = 0;
+    int len = 0;
+
+    for(; i > 0; i-- )
+    {
+        digit = '0';
+        mask = 1 << ( i - 1 );
+        if( ( tx & mask ) != 0 ){
+            digit++;
+        }
+        if( ( ty & mask ) != 0 ){
+            digit += 2;
+        }
+
+        quadkeys[len++] = digit;
+    }
+
+    return len;
+}
+
+
+// Converts a QuadKey into tile XY coordinates.
+// quadKey: QuadKey of the tile.
+// lv: Output parameter receiving the level of detail.
+// tx: Output parameter receiving the tile X coordinate.
+// ty: Output parameter receiving the tile Y coordinate.
+static inline int quadkey2tile( const char *quadKey, int lv, int *tx,
+                                int *ty )
+{
+    int i = lv;
+    int mask = 0;
+
+    *tx = *ty = 0;
+    for(; i > 0; i-- )
+    {
+        mask = 1 << ( i - 1 );
+        switch( quadKey[lv - i] )
+        {
+            case '0':
+                break;
+
+            case '1':
+                *tx |= mask;
+                break;
+
+            case '2':
+                *ty |= mask;
+                break;
+
+            case '3':
+                *tx |= mask;
+                *ty |= mask;
+                break;
+
+            // Invalid QuadKey digit sequence
+            default:
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+// Spreads the bits of the 32 bits value to the even bits of the 64 bits value.
+static inline uint64_t spreadbits( uint32_t v )
+{
+    uint64_t x = v;
+
+    x = ( x | ( x << 16 ) ) & 0x0000FFFF0000FFFFULL;
+    x = ( x | ( x << 8 ) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x | ( x << 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+    x = ( x | ( x << 2 ) ) & 0x3333333333333333ULL;
+    x = ( x | ( x << 1 ) ) & 0x5555555555555555ULL;
+
+    return x;
+}
+
+
+// Converts tile XY coordinates into the Morton code that has the same digits
+// as the QuadKey.
+static inline uint64_t tile2morton( uint32_t tx, uint32_t ty )
+{
+    return spreadbits( tx ) | ( spreadbits( ty ) << 1 );
+}
+
+
+// Gathers the even bits of the 64 bits value into the 32 bits value.
+static inline uint32_t compactbits( uint64_t x )
+{
+    x &= 0x5555555555555555ULL;
+    x = ( x | ( x >> 1 ) ) & 0x3333333333333333ULL;
+    x = ( x | ( x >> 2 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+    x = ( x | ( x >> 4 ) ) & 0x00FF00FF00FF00FFULL;
+    x = ( x | ( x >> 8 ) ) & 0x0000FFFF0000FFFFULL;
+    x = ( x | ( x >> 16 ) ) & 0x00000000FFFFFFFFULL;
+
+    return (uint32_t)x;
+}
+
+
+// MARK: integer quadkey
+// The integer quadkey is the Morton code of the tile that left-aligned to the
+// level 23 and followed by the terminating 1 bit;
+//
+//  code = ( morton << 1 | 1 ) << ( ( 23 - lv ) * 2 )
+//
+// The level of detail is determined by the position of the lowest set bit,
+// and the codes of all the descendant tiles are in the range of
+// [code - lsb + 1, code + lsb - 1]. Thus, the integer quadkeys of the same
+// level are sorted in the same order as the quadkey strings, and the
+// hierarchical operations are done in O(1).
+
+#define QUADKEY_MAX_LEVEL   23
+// bits of the integer quadkey
+#define QUADKEY_INT_BITS    ( QUADKEY_MAX_LEVEL * 2 + 1 )
+
+
+// Returns non-zero if the code is a valid integer quadkey of level 0-23.
+static inline int quadkey_isint( uint64_t code )
+{
+    return code && code >> QUADKEY_INT_BITS == 0 &&
+           !( __builtin_ctzll( code ) & 1 );
+}
+
+
+static inline uint64_t quadkey_lsb( uint64_t code )
+{
+    return code & -code;
+}
+
+
+static inline int quadkey_level( uint64_t code )
+{
+    return QUADKEY_MAX_LEVEL - __builtin_ctzll( code ) / 2;
+}
+
+
+static inline uint64_t tile2int( uint32_t tx, uint32_t ty, int lv )
+{
+    return ( ( tile2morton( tx, ty ) << 1 ) | 1 ) <<
+           ( ( QUADKEY_MAX_LEVEL - lv ) * 2 );
+}
+
+
+static inline void int2tile( uint64_t code, uint32_t *tx, uint32_t *ty,
+                             int *lv )
+{
+    uint64_t morton = code >> ( __builtin_ctzll( code ) + 1 );
+
+    *lv = quadkey_level( code );
+    *tx = compactbits( morton );
+    *ty = compactbits( morton >> 1 );
+}
+
+
+// Returns the ancestor of the code at the level that must be less than or
+// equal to the level of the code.
+static inline uint64_t quadkey_parent( uint64_t code, int lv )
+{
+    uint64_t lsb = 1ULL << ( ( QUADKEY_MAX_LEVEL - lv ) * 2 );
+
+    return ( code & -( lsb << 1 ) ) | lsb;
+}
+
+
+// Returns the child of the code at the position in the range of 0-3 that is
+// the digit of the quadkey string.
+static inline uint64_t quadkey_child( uint64_t code, int pos )
+{
+    uint64_t lsb = quadkey_lsb( code );
+
+    return code - lsb + ( lsb >> 2 ) * ( pos * 2 + 1 );
+}
+
+
+static inline int quadkey_contains( uint64_t code, uint64_t other )
+{
+    uint64_t lsb = quadkey_lsb( code );
+
+    return other >= code - ( lsb - 1 ) && other <= code + ( lsb - 1 );
+}
+
+
+
+
+// MARK: batch
+// Number of coordinates to be converted at once by the batch kernel.
+#define TILE_BLOCK_SIZE 64
+
+// Converts the coordinates into tile XY coordinates at a specified level of
+// detail.
+typedef void (*tilekernel_t)( uint32_t *tx, uint32_t *ty, const double *lat,
+                              const double *lon, size_t stride, size_t len,
+                              int lv );
+
+
+static inline void tilekernel_scalar( uint32_t *tx, uint32_t *ty,
+                                      const double *lat, const double *lon,
+                                      size_t stride, size_t len, int lv )
+{
+    size_t i = 0;
+
+    for(; i < len; i++ )
+    {
+        int px, py, x, y;
+
+        latlon2pixel( lat[i * stride], lon[i * stride], lv, &px, &py );
+        pixel2tile( px, py, &x, &y );
+        tx[i] = x;
+        ty[i] = y;
+    }
+}
+
+
+#if defined(QUADKEYS_X86_SIMD)
+
+// The following functions approximate the sine and the natural logarithm by
+// the polynomials that consist only of the multiplications and the
+// additions. Their errors are less than 1e-15, and the tile Y coordinate
+// that is too close to the tile boundary to be determined by the
+// approximation is computed again by the latlon2pixel, so the kernel
+// produces the same tiles as the scalar kernel.
+
+// Sine of the angle in the range of -pi/2 to pi/2 by the taylor series.
+__attribute__((target("avx2")))
+static inline __m256d sin_avx2( __m256d x )
+{
+    static const double c[] = {
+        -1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880,
+        -1.0 / 39916800, 1.0 / 6227020800, -1.0 / 1307674368000,
+        1.0 / 355687428096000, -1.0 / 121645100408832000,
+        1.0 / 51090942171709440000.0
+    };
+    __m256d z = _mm256_mul_pd( x, x );
+    __m256d v = _mm256_set1_pd( c[9] );
+    int i = 8;
+
+    for(; i >= 0; i-- ){
+        v = _mm256_add_pd( _mm256_set1_pd( c[i] ), _mm256_mul_pd( z, v ) );
+    }
+
+    return _mm256_add_pd( x, _mm256_mul_pd( _mm256_mul_pd( x, z ), v ) );
+}
+
+
+// Natural logarithm of the positive normal number.
+// x = m * 2^e, m in [sqrt(1/2), sqrt(2)), log(m) = 2 * atanh((m-1)/(m+1)).
+__attribute__((target("avx2")))
+static inline __m256d log_avx2( __m256d x )
+{
+    const __m256i mantissa = _mm256_set1_epi64x( 0x000FFFFFFFFFFFFFLL );
+    const __m256i exp0 = _mm256_set1_epi64x( 0x3FF0000000000000LL );
+    // 2^52 to convert the biased exponent into the double
+    const __m256d magic = _mm256_set1_pd( 4503599627370496.0 );
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    __m256i bits = _mm256_castpd_si256( x );
+    __m256d m = _mm256_castsi256_pd(
+        _mm256_or_si256( _mm256_and_si256( bits, mantissa ), exp0 )
+    );
+    __m256d e = _mm256_sub_pd( _mm256_castsi256_pd( _mm256_or_si256(
+        _mm256_srli_epi64( bits, 52 ), _mm256_castpd_si256( magic )
+    )), _mm256_add_pd( magic, _mm256_set1_pd( 1023 ) ) );
+    __m256d large = _mm256_cmp_pd( m, _mm256_set1_pd( M_SQRT2 ), _CMP_GE_OQ );
+    __m256d z, z2, v;
+    int i = 21;
+
+    m = _mm256_blendv_pd( m, _mm256_mul_pd( m, _mm256_set1_pd( 0.5 ) ),
+                          large );
+    e = _mm256_add_pd( e, _mm256_and_pd( large, one ) );
+    z = _mm256_div_pd( _mm256_sub_pd( m, one ), _mm256_add_pd( m, one ) );
+    z2 = _mm256_mul_pd( z, z );
+    v = _mm256_set1_pd( 1.0 / i );
+    for( i -= 2; i > 0; i -= 2 ){
+        v = _mm256_add_pd( _mm256_set1_pd( 1.0 / i ), _mm256_mul_pd( z2, v ) );
+    }
+
+    return _mm256_add_pd( _mm256_mul_pd( e, _mm256_set1_pd( M_LN2 ) ),
+                          _mm256_mul_pd( _mm256_add_pd( z, z ), v ) );
+}
+
+
+// Clips the value and converts it into the tile coordinate of the
+// upper-left pixel in the same way as latlon2pixel and pixel2tile.
+__attribute__((target("avx2")))
+static inline __m256d pixel2tile_avx2( __m256d v, __m256d mapsize )
+{
+    __m256d px = _mm256_add_pd( _mm256_mul_pd( v, mapsize ),
+                                _mm256_set1_pd( 0.5 ) );
+
+    px = _mm256_min_pd( _mm256_max_pd( px, _mm256_setzero_pd() ),
+                        _mm256_sub_pd( mapsize, _mm256_set1_pd( 1 ) ) );
+    return _mm256_mul_pd( px, _mm256_set1_pd( 1.0 / 256 ) );
+}
+
+
+__attribute__((target("avx2")))
+static inline void tilekernel_avx2( uint32_t *tx, uint32_t *ty,
+                                    const double *lat, const double *lon,
+                                    size_t stride, size_t len, int lv )
+{
+    const __m256d mapsize = _mm256_set1_pd( getmapsize( lv ) );
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    // margin of the tile boundary in the tile coordinate
+    const __m256d margin = _mm256_set1_pd( ldexp( 1, lv - 40 ) );
+    size_t i = 0;
+
+    if( stride == 1 || stride == 2 )
+    {
+        for(; i + 4 <= len; i += 4 )
+        {
+            __m256d vlat, vlon, sinlat, x, y, ftx, fty;
+            int near = 0;
+
+            if( stride == 1 ){
+                vlat = _mm256_loadu_pd( lat + i );
+                vlon = _mm256_loadu_pd( lon + i );
+            }
+            else {
+                // [lat0 lon0 lat1 lon1] [lat2 lon2 lat3 lon3]
+                __m256d a = _mm256_loadu_pd( lat + i * 2 );
+                __m256d b = _mm256_loadu_pd( lat + i * 2 + 4 );
+
+                // [lat0 lat2 lat1 lat3] -> [lat0 lat1 lat2 lat3]
+                vlat = _mm256_permute4x64_pd( _mm256_unpacklo_pd( a, b ),
+                                              0xD8 );
+                vlon = _mm256_permute4x64_pd( _mm256_unpackhi_pd( a, b ),
+                                              0xD8 );
+            }
+
+            // the NaN is clipped to the minimum value as same as getclip
+            vlat = _mm256_min_pd(
+                _mm256_max_pd( vlat, _mm256_set1_pd( LATITUDE_MIN ) ),
+                _mm256_set1_pd( LATITUDE_MAX )
+            );
+            vlon = _mm256_min_pd(
+                _mm256_max_pd( vlon, _mm256_set1_pd( LONGITUDE_MIN ) ),
+                _mm256_set1_pd( LONGITUDE_MAX )
+            );
+
+            x = _mm256_div_pd( _mm256_add_pd( vlon, _mm256_set1_pd( 180 ) ),
+                               _mm256_set1_pd( 360 ) );
+            sinlat = sin_avx2( _mm256_div_pd(
+                _mm256_mul_pd( vlat, _mm256_set1_pd( M_PI ) ),
+                _mm256_set1_pd( 180 )
+            ));
+            y = _mm256_sub_pd( _mm256_set1_pd( 0.5 ), _mm256_div_pd(
+                log_avx2( _mm256_div_pd( _mm256_add_pd( one, sinlat ),
+                                         _mm256_sub_pd( one, sinlat ) ) ),
+                _mm256_set1_pd( 4 * M_PI )
+            ));
+
+            ftx = _mm256_floor_pd( pixel2tile_avx2( x, mapsize ) );
+            fty = pixel2tile_avx2( y, mapsize );
+            // the distance to the nearest tile boundary
+            near = _mm256_movemask_pd( _mm256_cmp_pd(
+                _mm256_min_pd(
+                    _mm256_sub_pd( fty, _mm256_floor_pd( fty ) ),
+                    _mm256_sub_pd( _mm256_ceil_pd( fty ), fty )
+                ), margin, _CMP_LT_OQ
+            ));
+            fty = _mm256_floor_pd( fty );
+
+            _mm_storeu_si128( (__m128i*)( tx + i ),
+                              _mm256_cvttpd_epi32( ftx ) );
+            _mm_storeu_si128( (__m128i*)( ty + i ),
+                              _mm256_cvttpd_epi32( fty ) );
+            // determine the tile by the exact computation
+            for(; near; near &= near - 1 )
+            {
+                size_t j = i + __builtin_ctz( near );
+
+                tilekernel_scalar( tx + j, ty + j, lat + j * stride,
+                                   lon + j * stride, stride, 1, lv );
+            }
+        }
+    }
+
+    tilekernel_scalar( tx + i, ty + i, lat + i * stride, lon + i * stride,
+                       stride, len - i, lv );
+}
+
+#endif
+
+
+// Selected by tilekernel_init.
+static tilekernel_t tilekernel = tilekernel_scalar;
+static const char *tilekernel_name = "scalar";
+
+
+// Selects the batch kernel for this cpu.
+static inline void tilekernel_init( void )
+{
+#if defined(QUADKEYS_X86_SIMD)
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) ){
+        tilekernel = tilekernel_avx2;
+        tilekernel_name = "avx2";
+    }
+#endif
+}
+
+
+#endif
@@ -0,0 +1,376 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/reader.h
+ *  lua-geo
+ *
+ *  streaming parser of the CSV and NDJSON lines of the coordinates.
+ */
+
+#ifndef geo_reader_h
+#define geo_reader_h
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "buffer.h"
+
+
+// max length of the number that parsed by the strtod
+#define GEO_READER_MAX_NUMLEN   63
+// max length of the key name of the NDJSON
+#define GEO_READER_MAX_KEYLEN   31
+
+typedef enum {
+    GEO_READER_CSV = 0,
+    GEO_READER_NDJSON
+} geo_reader_format_e;
+
+enum {
+    GEO_READER_LAT = 0,
+    GEO_READER_LON,
+    GEO_READER_ID,
+    GEO_READER_NFIELD
+};
+
+typedef struct {
+    geo_reader_format_e format;
+    // 1-based column numbers of the CSV fields. 0 means that the field does
+    // not exist.
+    int cols[GEO_READER_NFIELD];
+    // key names of the NDJSON fields. the empty name means that the field
+    // does not exist.
+    char keys[GEO_READER_NFIELD][GEO_READER_MAX_KEYLEN + 1];
+    // skip the first line
+    int header;
+    // number of the lines that have been read
+    size_t lineno;
+    // number of the rows that have been parsed
+    size_t nrow;
+    // the last parsing stopped at the invalid line
+    int invalid;
+} geo_reader_t;
+
+
+// exact powers of ten that representable by the double.
+static const double GEO_READER_POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+// parses the decimal number in the range of [p, end).
+// the number of up to 15 significant digits and the exponent of up to 22 is
+// converted exactly by the single multiplication or division, and the
+// other numbers are converted by the strtod.
+// returns the position after the number, or NULL if there is no number.
+static inline const char *geo_reader_double( const char *p, const char *end,
+                                             double *val )
+{
+    const char *head = p;
+    uint64_t mantissa = 0;
+    int ndigit = 0;
+    int exp10 = 0;
+    int neg = 0;
+    int valid = 0;
+
+    if( p < end && ( *p == '-' || *p == '+' ) ){
+        neg = *p++ == '-';
+    }
+    for(; p < end && *p >= '0' && *p <= '9'; p++ )
+    {
+        valid = 1;
+        if( ndigit < 19 ){
+            mantissa = mantissa * 10 + ( *p - '0' );
+            ndigit += mantissa != 0;
+        }
+        else {
+            exp10++;
+        }
+    }
+    if( p < end && *p == '.' )
+    {
+        for( p++; p < end && *p >= '0' && *p <= '9'; p++ )
+        {
+            valid = 1;
+            if( ndigit < 19 ){
+                mantissa = mantissa * 10 + ( *p - '0' );
+                ndigit += mantissa != 0;
+                exp10--;
+            }
+        }
+    }
+    if( !valid ){
+        return NULL;
+    }
+    else if( p < end && ( *p == 'e' || *p == 'E' ) )
+    {
+        const char *e = p + 1;
+        int eneg = 0;
+        int n = 0;
+
+        if( e < end && ( *e == '-' || *e == '+' ) ){
+            eneg = *e++ == '-';
+        }
+        if( e < end && *e >= '0' && *e <= '9' )
+        {
+            for(; e < end && *e >= '0' && *e <= '9'; e++ ){
+                if( n < 10000 ){
+                    n = n * 10 + ( *e - '0' );
+                }
+            }
+            exp10 += eneg ? -n : n;
+            p = e;
+        }
+    }
+
+    if( ndigit <= 15 && exp10 >= -22 && exp10 <= 22 ){
+        *val = exp10 < 0 ? (double)mantissa / GEO_READER_POW10[-exp10] :
+                           (double)mantissa * GEO_READER_POW10[exp10];
+        if( neg ){
+            *val = -*val;
+        }
+    }
+    else {
+        char num[GEO_READER_MAX_NUMLEN + 1];
+        size_t len = p - head;
+
+        if( len > GEO_READER_MAX_NUMLEN ){
+            return NULL;
+        }
+        memcpy( num, head, len );
+        num[len] = 0;
+        *val = strtod( num, NULL );
+    }
+
+    return p;
+}
+
+
+// parses the decimal integer in the range of [p, end).
+// returns the position after the number, or NULL if there is no number or
+// it is out of range of the 64 bits integer.
+static inline const char *geo_reader_int( const char *p, const char *end,
+                                          int64_t *val )
+{
+    uint64_t n = 0;
+    int neg = 0;
+    int valid = 0;
+
+    if( p < end && ( *p == '-' || *p == '+' ) ){
+        neg = *p++ == '-';
+    }
+    for(; p < end && *p >= '0' && *p <= '9'; p++ )
+    {
+        if( n > ( (uint64_t)INT64_MAX + neg - ( *p - '0' ) ) / 10 ){
+            return NULL;
+        }
+        n = n * 10 + ( *p - '0' );
+        valid = 1;
+    }
+    if( !valid ){
+        return NULL;
+    }
+    *val = neg ? (int64_t)( 0 - n ) : (int64_t)n;
+
+    return p;
+}
+
+
+static inline const char *geo_reader_skipspace( const char *p,
+                                                const char *end )
+{
+    while( p < end && ( *p == ' ' || *p == '\t' ) ){
+        p++;
+    }
+    return p;
+}
+
+
+// parses the field value in the range of [p, end) that may be surrounded by
+// the spaces. the id is parsed as the integer.
+// returns the position after the value, or NULL on failure.
+static inline const char *geo_reader_value( const char *p, const char *end,
+                                            int field, double *val,
+                                            int64_t *id )
+{
+    p = geo_reader_skipspace( p, end );
+    p = field == GEO_READER_ID ? geo_reader_int( p, end, id ) :
+                                 geo_reader_double( p, end, val );
+
+    return p ? geo_reader_skipspace( p, end ) : NULL;
+}
+
+
+static inline int geo_reader_csv( const geo_reader_t *r, const char *p,
+                                  const char *end, double *latlon,
+                                  int64_t *id )
+{
+    int found = 0;
+    int col = 1;
+
+    for(;; col++ )
+    {
+        const char *delim = memchr( p, ',', end - p );
+        int field = 0;
+
+        if( !delim ){
+            delim = end;
+        }
+        for(; field < GEO_READER_NFIELD; field++ )
+        {
+            if( r->cols[field] == col )
+            {
+                if( geo_reader_value( p, delim, field, latlon + field,
+                                      id ) != delim ){
+                    return -1;
+                }
+                found++;
+            }
+        }
+        if( delim == end ){
+            break;
+        }
+        p = delim + 1;
+    }
+
+    return found;
+}
+
+
+static inline int geo_reader_ndjson( const geo_reader_t *r, const char *p,
+                                     const char *end, double *latlon,
+                                     int64_t *id )
+{
+    const char *head = p;
+    int found = 0;
+    int field = 0;
+
+    for(; field < GEO_READER_NFIELD; field++ )
+    {
+        const char *key = r->keys[field];
+        size_t klen = strlen( key );
+
+        if( !klen ){
+            continue;
+        }
+        for( p = head; ( p = memchr( p, '"', end - p ) ); p++ )
+        {
+            const char *v = p + 1 + klen;
+
+            // "<key>" followed by the colon
+            if( v < end && *v == '"' && memcmp( p + 1, key, klen ) == 0 &&
+                ( v = geo_reader_skipspace( v + 1, end ) ) < end &&
+                *v == ':' )
+            {
+                v = geo_reader_value( v + 1, end, field, latlon + field, id );
+                if( !v || ( v < end && *v != ',' && *v != '}' ) ){
+                    return -1;
+                }
+                found++;
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+// parses the lines in the range of [p, p + len) and appends the rows to the
+// buffer until the buffer has the rows.
+// the last line that is not terminated by the newline is parsed only if the
+// final is not zero.
+// the parsing stops at the invalid line and sets the invalid to 1. the
+// invalid line is left unparsed if the buffer has the rows, so that they are
+// returned first. otherwise, the invalid line is skipped and the lineno is
+// the number of the invalid line.
+// returns the number of bytes of the parsed and skipped lines.
+static inline ssize_t geo_reader_parse( geo_reader_t *r, geo_buffer_t *buf,
+                                        size_t rows, const char *p, size_t len,
+                                        int final )
+{
+    const char *head = p;
+    const char *end = p + len;
+    int nfield = 0;
+    int i = 0;
+
+    for(; i < GEO_READER_NFIELD; i++ ){
+        nfield += r->format == GEO_READER_CSV ? r->cols[i] > 0 :
+                                                r->keys[i][0] != 0;
+    }
+
+    while( p < end && buf->len < rows )
+    {
+        const char *eol = memchr( p, '\n', end - p );
+        const char *next = NULL;
+        double latlon[2] = { 0 };
+        int64_t id = 0;
+        int found = 0;
+
+        if( eol ){
+            next = eol + 1;
+        }
+        else if( final ){
+            eol = next = end;
+        }
+        else {
+            break;
+        }
+
+        r->lineno++;
+        if( eol > p && eol[-1] == '\r' ){
+            eol--;
+        }
+        // skip the header and the empty lines
+        if( ( r->header && r->lineno == 1 ) ||
+            geo_reader_skipspace( p, eol ) == eol ){
+            p = next;
+            continue;
+        }
+
+        found = r->format == GEO_READER_CSV ?
+                geo_reader_csv( r, p, eol, latlon, &id ) :
+                geo_reader_ndjson( r, p, eol, latlon, &id );
+        if( found != nfield )
+        {
+            r->invalid = 1;
+            if( buf->len ){
+                r->lineno--;
+            }
+            else {
+                p = next;
+            }
+            break;
+        }
+        r->nrow++;
+        geo_buffer_push( buf, latlon[GEO_READER_LAT], latlon[GEO_READER_LON],
+                         r->keys[GEO_READER_ID][0] || r->cols[GEO_READER_ID] ?
+                         id : (int64_t)r->nrow );
+        p = next;
+    }
+
+    return p - head;
+}
+
+
+#endif
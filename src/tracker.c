@@ -0,0 +1,333 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/tracker.c
+ *  lua-geo
+ */
+
+#include "tracker.h"
+#include "coords.h"
+
+#define MODULE_MT   "geo.tracker"
+
+
+// MARK: query
+typedef struct {
+    lua_State *L;
+    geo_t origin;
+    double radius;
+    int n;
+} radius_ctx_t;
+
+// pushes the id and the distance of the object in the circle to the tables at
+// the top of the stack.
+static void radius_scan( void *ctx, const geo_tracker_obj_t *obj )
+{
+    radius_ctx_t *c = (radius_ctx_t*)ctx;
+    geo_t dest = {
+        .lat_rad = obj->lat * GEO_RAD,
+        .lon_rad = obj->lon * GEO_RAD
+    };
+    double dist = geo_get_distance( &c->origin, &dest );
+
+    if( dist <= c->radius ){
+        c->n++;
+        lua_pushinteger( c->L, (lua_Integer)obj->id );
+        lua_rawseti( c->L, -3, c->n );
+        lua_pushnumber( c->L, dist );
+        lua_rawseti( c->L, -2, c->n );
+    }
+}
+
+
+// MARK: methods
+static void checklatlon( lua_State *L, int idx, double *lat, double *lon )
+{
+    *lat = lauxh_checknumber( L, idx );
+    *lon = lauxh_checknumber( L, idx + 1 );
+    lauxh_argcheck(
+        L, GEO_IS_LAT_RANGE( *lat ), idx,
+        "-90 to 90 expected, got an out of range value"
+    );
+    lauxh_argcheck(
+        L, GEO_IS_LON_RANGE( *lon ), idx + 1,
+        "-180 to 180 expected, got an out of range value"
+    );
+}
+
+
+static int within_radius_lua( lua_State *L )
+{
+    geo_tracker_t *t = luaL_checkudata( L, 1, MODULE_MT );
+    radius_ctx_t ctx = { .L = L };
+    geo_hash_cell_t cells[GEO_HASH_COVER_SIZE( GEO_TRACKER_COVER_CELLS )];
+    geo_circle_t circle;
+    double lat, lon;
+
+    checklatlon( L, 2, &lat, &lon );
+    ctx.radius = lauxh_checknumber( L, 4 );
+    lauxh_argcheck(
+        L, ctx.radius >= 0, 4, "non-negative number expected, got %f",
+        ctx.radius
+    );
+
+    geo_init( &ctx.origin, lat, lon, 0 );
+    geo_circle_init( &circle, lat, lon, ctx.radius );
+    lua_newtable( L );
+    lua_newtable( L );
+    geo_tracker_query( t, cells, geo_circle_classify, &circle, radius_scan,
+                       &ctx );
+
+    return 2;
+}
+
+
+static int get_lua( lua_State *L )
+{
+    geo_tracker_t *t = luaL_checkudata( L, 1, MODULE_MT );
+    uint32_t i = geo_tracker_find( t, lauxh_checkinteger( L, 2 ) );
+
+    if( i == GEO_TRACKER_NIL ){
+        lua_pushnil( L );
+        return 1;
+    }
+    lua_pushnumber( L, GEO_TRACKER_OBJ( t, i )->lat );
+    lua_pushnumber( L, GEO_TRACKER_OBJ( t, i )->lon );
+
+    return 2;
+}
+
+
+static int update_lua( lua_State *L )
+{
+    geo_tracker_t *t = luaL_checkudata( L, 1, MODULE_MT );
+    lua_Integer id = lauxh_checkinteger( L, 2 );
+    double lat, lon;
+    uint64_t key = 0;
+    int rc = 0;
+
+    checklatlon( L, 3, &lat, &lon );
+    geo_hash_encode_int( &key, lat, lon, GEO_TRACKER_KEY_BITS );
+    if( ( rc = geo_tracker_update( t, id, lat, lon, key ) ) == -1 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    lua_pushboolean( L, rc );
+
+    return 1;
+}
+
+
+static int update_batch_lua( lua_State *L )
+{
+    geo_tracker_t *t = luaL_checkudata( L, 1, MODULE_MT );
+    geo_coords_t coords;
+    uint64_t hi[GEO_HASH_BLOCK_SIZE];
+    uint64_t lo[GEO_HASH_BLOCK_SIZE];
+    lua_Integer nmove = 0;
+    size_t i = 0;
+
+    geo_checkcoords( L, 2, &coords );
+    if( !lauxh_isnil( L, 3 ) ){
+        lauxh_checktable( L, 3 );
+        lauxh_argcheck(
+            L, lauxh_rawlen( L, 3 ) == coords.len, 3,
+            "%d ids expected, got %d ids", (int)coords.len,
+            (int)lauxh_rawlen( L, 3 )
+        );
+    }
+    else {
+        lauxh_argcheck(
+            L, coords.ids != NULL, 3,
+            "ids expected for the coordinates without the ids"
+        );
+    }
+
+    while( i < coords.len )
+    {
+        const double *lat = coords.lat + i * coords.stride;
+        const double *lon = coords.lon + i * coords.stride;
+        size_t n = coords.len - i;
+        size_t j = 0;
+
+        if( n > GEO_HASH_BLOCK_SIZE ){
+            n = GEO_HASH_BLOCK_SIZE;
+        }
+        // encode the valid coordinates before the invalid one
+        for(; j < n && GEO_IS_LATLON_RANGE( lat[j * coords.stride],
+                                            lon[j * coords.stride] ); j++ ){}
+        n = j;
+        geo_hash_kernel( hi, lo, lat, lon, coords.stride, n );
+
+        for( j = 0; j < n; j++, i++ )
+        {
+            // the identifiers of the table take precedence over the buffer
+            int64_t id = 0;
+            int rc = 0;
+
+            if( coords.ids && lua_isnoneornil( L, 3 ) ){
+                id = coords.ids[i];
+            }
+            else {
+                lua_rawgeti( L, 3, i + 1 );
+                lauxh_argcheck(
+                    L, lua_type( L, -1 ) == LUA_TNUMBER, 3,
+                    "integer expected at #%d", (int)i + 1
+                );
+                id = (int64_t)lua_tointeger( L, -1 );
+                lua_pop( L, 1 );
+            }
+
+            rc = geo_tracker_update( t, id, lat[j * coords.stride],
+                                     lon[j * coords.stride],
+                                     hi[j] >> ( 64 - GEO_TRACKER_KEY_BITS ) );
+            if( rc == -1 ){
+                goto FAILED;
+            }
+            nmove += rc;
+        }
+
+        if( n < GEO_HASH_BLOCK_SIZE && i < coords.len ){
+            errno = EINVAL;
+            goto FAILED;
+        }
+    }
+
+    lua_pushinteger( L, nmove );
+    return 1;
+
+FAILED:
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+    lua_pushinteger( L, (lua_Integer)i + 1 );
+    return 3;
+}
+
+
+static int remove_lua( lua_State *L )
+{
+    geo_tracker_t *t = luaL_checkudata( L, 1, MODULE_MT );
+
+    lua_pushboolean( L, geo_tracker_remove( t, lauxh_checkinteger( L, 2 ) ) );
+
+    return 1;
+}
+
+
+static int ncell_lua( lua_State *L )
+{
+    geo_tracker_t *t = luaL_checkudata( L, 1, MODULE_MT );
+
+    lua_pushinteger( L, (lua_Integer)t->ncell );
+
+    return 1;
+}
+
+
+static int len_lua( lua_State *L )
+{
+    geo_tracker_t *t = luaL_checkudata( L, 1, MODULE_MT );
+
+    lua_pushinteger( L, (lua_Integer)t->len );
+
+    return 1;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    lua_pushfstring( L, MODULE_MT ": %p", lua_touserdata( L, 1 ) );
+    return 1;
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    geo_tracker_free( (geo_tracker_t*)lua_touserdata( L, 1 ) );
+    return 0;
+}
+
+
+static int new_lua( lua_State *L )
+{
+    lua_Integer precision = lauxh_optinteger( L, 1, GEO_TRACKER_PRECISION );
+    geo_tracker_t *t = NULL;
+
+    lauxh_argcheck(
+        L, precision > 0 && precision <= GEO_TRACKER_MAX_PRECISION, 1,
+        "1 to %d expected, got %d", GEO_TRACKER_MAX_PRECISION, (int)precision
+    );
+
+    t = lua_newuserdata( L, sizeof( geo_tracker_t ) );
+    if( geo_tracker_init( t, (uint8_t)precision ) != 0 ){
+        lua_pushnil( L );
+        lua_pushstring( L, strerror( errno ) );
+        return 2;
+    }
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+
+    return 1;
+}
+
+
+LUALIB_API int luaopen_geo_tracker( lua_State *L )
+{
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__tostring", tostring_lua },
+        { "__len", len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "update", update_lua },
+        { "update_batch", update_batch_lua },
+        { "remove", remove_lua },
+        { "get", get_lua },
+        { "within_radius", within_radius_lua },
+        { "ncell", ncell_lua },
+        { "len", len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg *ptr = mmethod;
+
+    geo_hash_kernel_init();
+
+    // create metatable
+    luaL_newmetatable( L, MODULE_MT );
+    for(; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    // create method table
+    lua_pushstring( L, "__index" );
+    lua_newtable( L );
+    for( ptr = method; ptr->name; ptr++ ){
+        lauxh_pushfn2tbl( L, ptr->name, ptr->func );
+    }
+    lua_rawset( L, -3 );
+    lua_pop( L, 1 );
+
+    lua_createtable( L, 0, 1 );
+    lauxh_pushfn2tbl( L, "new", new_lua );
+
+    return 1;
+}
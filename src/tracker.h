@@ -0,0 +1,534 @@
+/*
+ *  Copyright (C) 2026 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/tracker.h
+ *  lua-geo
+ *
+ *  index of the moving objects that bucketed by the geohash cell.
+ */
+
+#ifndef geo_tracker_h
+#define geo_tracker_h
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "geohash.h"
+
+
+// number of bits of the key of the object.
+// the key is the 62 bits integer geohash of the position.
+#define GEO_TRACKER_KEY_BITS        GEO_HASH_INT_MAX_BITS
+// default and max precision of the cells
+#define GEO_TRACKER_PRECISION       6
+#define GEO_TRACKER_MAX_PRECISION   12
+// max number of cells of the cover that used to find the candidates
+#define GEO_TRACKER_COVER_CELLS     64
+// initial capacity of the pools and the hash tables
+#define GEO_TRACKER_MIN_CAPACITY    64
+// terminator of the lists
+#define GEO_TRACKER_NIL             UINT32_MAX
+
+// object in the pool. the free object is linked by the next.
+typedef struct {
+    int64_t id;
+    double lat;
+    double lon;
+    uint64_t key;
+    // cell that contains the object, or GEO_TRACKER_NIL if it is free
+    uint32_t cell;
+    // intrusive list of the objects of the cell
+    uint32_t prev;
+    uint32_t next;
+    // chain of the id hash table
+    uint32_t chain;
+} geo_tracker_obj_t;
+
+// cell in the pool. the free cell is linked by the chain.
+typedef struct {
+    uint64_t code;
+    // head of the list of the objects
+    uint32_t head;
+    uint32_t count;
+    // chain of the code hash table
+    uint32_t chain;
+} geo_tracker_cell_t;
+
+// pool of the fixed size items that addressed by the index, so the pool can
+// be grown without updating the links.
+typedef struct {
+    void *items;
+    uint32_t used;
+    uint32_t cap;
+    uint32_t free;
+} geo_tracker_pool_t;
+
+typedef struct {
+    uint8_t precision;
+    // number of bits of the key to get the cell code
+    int shift;
+    size_t len;
+    size_t ncell;
+    geo_tracker_pool_t objs;
+    geo_tracker_pool_t cells;
+    // heads of the chains of the hash tables
+    uint32_t *idheads;
+    uint32_t idmask;
+    uint32_t *cellheads;
+    uint32_t cellmask;
+} geo_tracker_t;
+
+// called for each object in the candidate cells
+typedef void (*geo_tracker_scan_t)( void *ctx, const geo_tracker_obj_t *obj );
+
+
+#define GEO_TRACKER_OBJ(t,i)    ( (geo_tracker_obj_t*)(t)->objs.items + (i) )
+#define GEO_TRACKER_CELL(t,i)   ( (geo_tracker_cell_t*)(t)->cells.items + (i) )
+
+
+static inline uint32_t geo_tracker_hash( uint64_t v, uint32_t mask )
+{
+    return (uint32_t)( ( v * 0x9E3779B97F4A7C15ULL ) >> 32 ) & mask;
+}
+
+
+static inline uint32_t *geo_tracker_heads( uint32_t n )
+{
+    uint32_t *heads = malloc( sizeof( uint32_t ) * n );
+
+    if( heads ){
+        memset( heads, 0xFF, sizeof( uint32_t ) * n );
+    }
+    return heads;
+}
+
+
+static inline int geo_tracker_init( geo_tracker_t *t, uint8_t precision )
+{
+    *t = (geo_tracker_t){
+        .precision = precision,
+        .shift = GEO_TRACKER_KEY_BITS - precision * 5,
+        .objs = { NULL, 0, 0, GEO_TRACKER_NIL },
+        .cells = { NULL, 0, 0, GEO_TRACKER_NIL },
+        .idmask = GEO_TRACKER_MIN_CAPACITY - 1,
+        .cellmask = GEO_TRACKER_MIN_CAPACITY - 1
+    };
+    t->idheads = geo_tracker_heads( GEO_TRACKER_MIN_CAPACITY );
+    t->cellheads = geo_tracker_heads( GEO_TRACKER_MIN_CAPACITY );
+    if( !t->idheads || !t->cellheads ){
+        free( t->idheads );
+        free( t->cellheads );
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static inline void geo_tracker_free( geo_tracker_t *t )
+{
+    free( t->objs.items );
+    free( t->cells.items );
+    free( t->idheads );
+    free( t->cellheads );
+    *t = (geo_tracker_t){ 0 };
+}
+
+
+// allocates the item from the free list or the end of the pool.
+// the free list is linked by the uint32_t at the offset of the item.
+static inline uint32_t geo_tracker_pool_alloc( geo_tracker_pool_t *pool,
+                                               size_t size, size_t offset )
+{
+    uint32_t i = pool->free;
+
+    if( i != GEO_TRACKER_NIL ){
+        pool->free = *(uint32_t*)( (char*)pool->items + size * i + offset );
+        return i;
+    }
+    else if( pool->used == pool->cap )
+    {
+        uint32_t cap = pool->cap ? pool->cap * 2 : GEO_TRACKER_MIN_CAPACITY;
+        void *items = NULL;
+
+        if( pool->cap >= GEO_TRACKER_NIL / 2 ){
+            errno = ENOMEM;
+            return GEO_TRACKER_NIL;
+        }
+        else if( !( items = realloc( pool->items, size * cap ) ) ){
+            return GEO_TRACKER_NIL;
+        }
+        pool->items = items;
+        pool->cap = cap;
+    }
+
+    return pool->used++;
+}
+
+
+static inline void geo_tracker_pool_release( geo_tracker_pool_t *pool,
+                                             size_t size, size_t offset,
+                                             uint32_t i )
+{
+    *(uint32_t*)( (char*)pool->items + size * i + offset ) = pool->free;
+    pool->free = i;
+}
+
+
+// doubles the buckets of the hash table if the number of the items exceeds
+// the number of the buckets. the current table is kept if the allocation
+// fails since it still works with the longer chains.
+static inline uint32_t *geo_tracker_grow( uint32_t *mask, size_t nitem )
+{
+    uint32_t n = *mask + 1;
+    uint32_t *heads = NULL;
+
+    if( nitem > n && n < ( (uint32_t)1 << 31 ) &&
+        ( heads = geo_tracker_heads( n * 2 ) ) ){
+        *mask = n * 2 - 1;
+    }
+
+    return heads;
+}
+
+
+static inline void geo_tracker_rehash_ids( geo_tracker_t *t )
+{
+    uint32_t *heads = geo_tracker_grow( &t->idmask, t->len );
+    uint32_t i = 0;
+
+    if( !heads ){
+        return;
+    }
+    free( t->idheads );
+    t->idheads = heads;
+    for(; i < t->objs.used; i++ )
+    {
+        geo_tracker_obj_t *obj = GEO_TRACKER_OBJ( t, i );
+
+        if( obj->cell != GEO_TRACKER_NIL ){
+            uint32_t h = geo_tracker_hash( (uint64_t)obj->id, t->idmask );
+            obj->chain = heads[h];
+            heads[h] = i;
+        }
+    }
+}
+
+
+static inline void geo_tracker_rehash_cells( geo_tracker_t *t )
+{
+    uint32_t *heads = geo_tracker_grow( &t->cellmask, t->ncell );
+    uint32_t i = 0;
+
+    if( !heads ){
+        return;
+    }
+    free( t->cellheads );
+    t->cellheads = heads;
+    for(; i < t->cells.used; i++ )
+    {
+        geo_tracker_cell_t *cell = GEO_TRACKER_CELL( t, i );
+
+        if( cell->count ){
+            uint32_t h = geo_tracker_hash( cell->code, t->cellmask );
+            cell->chain = heads[h];
+            heads[h] = i;
+        }
+    }
+}
+
+
+static inline uint32_t geo_tracker_find( const geo_tracker_t *t, int64_t id )
+{
+    uint32_t i = t->idheads[geo_tracker_hash( (uint64_t)id, t->idmask )];
+
+    while( i != GEO_TRACKER_NIL && GEO_TRACKER_OBJ( t, i )->id != id ){
+        i = GEO_TRACKER_OBJ( t, i )->chain;
+    }
+
+    return i;
+}
+
+
+static inline uint32_t geo_tracker_find_cell( const geo_tracker_t *t,
+                                              uint64_t code )
+{
+    uint32_t i = t->cellheads[geo_tracker_hash( code, t->cellmask )];
+
+    while( i != GEO_TRACKER_NIL && GEO_TRACKER_CELL( t, i )->code != code ){
+        i = GEO_TRACKER_CELL( t, i )->chain;
+    }
+
+    return i;
+}
+
+
+// links the object to the head of the list of the cell of the code.
+static inline int geo_tracker_link( geo_tracker_t *t, uint32_t i,
+                                    uint64_t code )
+{
+    uint32_t c = geo_tracker_find_cell( t, code );
+    geo_tracker_obj_t *obj = NULL;
+    geo_tracker_cell_t *cell = NULL;
+
+    if( c == GEO_TRACKER_NIL )
+    {
+        uint32_t h = 0;
+
+        c = geo_tracker_pool_alloc( &t->cells, sizeof( geo_tracker_cell_t ),
+                                    offsetof( geo_tracker_cell_t, chain ) );
+        if( c == GEO_TRACKER_NIL ){
+            return -1;
+        }
+        h = geo_tracker_hash( code, t->cellmask );
+        *GEO_TRACKER_CELL( t, c ) = (geo_tracker_cell_t){
+            code, GEO_TRACKER_NIL, 0, t->cellheads[h]
+        };
+        t->cellheads[h] = c;
+        t->ncell++;
+    }
+
+    obj = GEO_TRACKER_OBJ( t, i );
+    cell = GEO_TRACKER_CELL( t, c );
+    obj->cell = c;
+    obj->prev = GEO_TRACKER_NIL;
+    obj->next = cell->head;
+    if( cell->head != GEO_TRACKER_NIL ){
+        GEO_TRACKER_OBJ( t, cell->head )->prev = i;
+    }
+    cell->head = i;
+    if( cell->count++ == 0 ){
+        geo_tracker_rehash_cells( t );
+    }
+
+    return 0;
+}
+
+
+// unlinks the object from the list of its cell, and releases the cell if it
+// becomes empty.
+static inline void geo_tracker_unlink( geo_tracker_t *t, uint32_t i )
+{
+    geo_tracker_obj_t *obj = GEO_TRACKER_OBJ( t, i );
+    uint32_t c = obj->cell;
+    geo_tracker_cell_t *cell = GEO_TRACKER_CELL( t, c );
+
+    if( obj->prev != GEO_TRACKER_NIL ){
+        GEO_TRACKER_OBJ( t, obj->prev )->next = obj->next;
+    }
+    else {
+        cell->head = obj->next;
+    }
+    if( obj->next != GEO_TRACKER_NIL ){
+        GEO_TRACKER_OBJ( t, obj->next )->prev = obj->prev;
+    }
+
+    if( --cell->count == 0 )
+    {
+        uint32_t *link = t->cellheads +
+                         geo_tracker_hash( cell->code, t->cellmask );
+
+        while( *link != c ){
+            link = &GEO_TRACKER_CELL( t, *link )->chain;
+        }
+        *link = cell->chain;
+        geo_tracker_pool_release( &t->cells, sizeof( geo_tracker_cell_t ),
+                                  offsetof( geo_tracker_cell_t, chain ), c );
+        t->ncell--;
+    }
+}
+
+
+// updates the position of the object of the id, or adds the new object.
+// the object is moved to the other cell only if the prefix of the key that
+// represents the cell is changed.
+// the coordinates must be validated, and the key must be the integer geohash
+// of GEO_TRACKER_KEY_BITS bits of the coordinates.
+// returns 1 if the object is moved or added, 0 if it stays in the same cell,
+// or -1 on failure.
+static inline int geo_tracker_update( geo_tracker_t *t, int64_t id,
+                                      double lat, double lon, uint64_t key )
+{
+    uint32_t i = geo_tracker_find( t, id );
+    geo_tracker_obj_t *obj = NULL;
+
+    if( i != GEO_TRACKER_NIL )
+    {
+        obj = GEO_TRACKER_OBJ( t, i );
+        obj->lat = lat;
+        obj->lon = lon;
+        if( ( ( obj->key ^ key ) >> t->shift ) == 0 ){
+            obj->key = key;
+            return 0;
+        }
+        obj->key = key;
+        geo_tracker_unlink( t, i );
+        if( geo_tracker_link( t, i, key >> t->shift ) != 0 ){
+            // relink to the old cell cannot be done without the allocation
+            // either, so the object is removed
+            uint32_t *link = t->idheads + geo_tracker_hash( (uint64_t)id,
+                                                            t->idmask );
+            while( *link != i ){
+                link = &GEO_TRACKER_OBJ( t, *link )->chain;
+            }
+            *link = obj->chain;
+            obj->cell = GEO_TRACKER_NIL;
+            geo_tracker_pool_release( &t->objs, sizeof( geo_tracker_obj_t ),
+                                      offsetof( geo_tracker_obj_t, next ), i );
+            t->len--;
+            return -1;
+        }
+        return 1;
+    }
+
+    i = geo_tracker_pool_alloc( &t->objs, sizeof( geo_tracker_obj_t ),
+                                offsetof( geo_tracker_obj_t, next ) );
+    if( i == GEO_TRACKER_NIL ){
+        return -1;
+    }
+    obj = GEO_TRACKER_OBJ( t, i );
+    *obj = (geo_tracker_obj_t){
+        .id = id,
+        .lat = lat,
+        .lon = lon,
+        .key = key,
+        .cell = GEO_TRACKER_NIL
+    };
+    if( geo_tracker_link( t, i, key >> t->shift ) != 0 ){
+        geo_tracker_pool_release( &t->objs, sizeof( geo_tracker_obj_t ),
+                                  offsetof( geo_tracker_obj_t, next ), i );
+        return -1;
+    }
+    else
+    {
+        uint32_t h = geo_tracker_hash( (uint64_t)id, t->idmask );
+
+        obj->chain = t->idheads[h];
+        t->idheads[h] = i;
+        t->len++;
+        geo_tracker_rehash_ids( t );
+    }
+
+    return 1;
+}
+
+
+// removes the object of the id. returns 0 if the object is not found.
+static inline int geo_tracker_remove( geo_tracker_t *t, int64_t id )
+{
+    uint32_t *link = t->idheads + geo_tracker_hash( (uint64_t)id, t->idmask );
+    geo_tracker_obj_t *obj = NULL;
+    uint32_t i = 0;
+
+    while( *link != GEO_TRACKER_NIL &&
+           GEO_TRACKER_OBJ( t, *link )->id != id ){
+        link = &GEO_TRACKER_OBJ( t, *link )->chain;
+    }
+    if( ( i = *link ) == GEO_TRACKER_NIL ){
+        return 0;
+    }
+
+    obj = GEO_TRACKER_OBJ( t, i );
+    *link = obj->chain;
+    geo_tracker_unlink( t, i );
+    obj->cell = GEO_TRACKER_NIL;
+    geo_tracker_pool_release( &t->objs, sizeof( geo_tracker_obj_t ),
+                              offsetof( geo_tracker_obj_t, next ), i );
+    t->len--;
+
+    return 1;
+}
+
+
+static inline void geo_tracker_scan_cell( const geo_tracker_t *t, uint32_t c,
+                                          geo_tracker_scan_t fn, void *ctx )
+{
+    uint32_t i = GEO_TRACKER_CELL( t, c )->head;
+
+    for(; i != GEO_TRACKER_NIL; i = GEO_TRACKER_OBJ( t, i )->next ){
+        fn( ctx, GEO_TRACKER_OBJ( t, i ) );
+    }
+}
+
+
+// calls the function for each object that may be in the region.
+// the cells of the cover at the precision of the tracker are looked up
+// directly, or all the cells are classified if there are fewer cells than
+// the cells to be looked up.
+static inline void geo_tracker_query( const geo_tracker_t *t,
+                                      geo_hash_cell_t *cells,
+                                      geo_cover_classify_t classify,
+                                      const void *region,
+                                      geo_tracker_scan_t fn, void *ctx )
+{
+    size_t ncover = geo_hash_cover( cells, GEO_TRACKER_COVER_CELLS,
+                                    t->precision, classify, region );
+    uint64_t nprobe = 0;
+    size_t i = 0;
+
+    for(; i < ncover && nprobe <= t->ncell; i++ ){
+        int depth = ( t->precision - cells[i].len ) * 5;
+
+        nprobe += depth >= 40 ? UINT64_MAX / 2 : (uint64_t)1 << depth;
+    }
+
+    if( nprobe <= t->ncell )
+    {
+        for( i = 0; i < ncover; i++ )
+        {
+            uint64_t hi, lo, code, end;
+
+            geo_hash_interleave( cells[i].qlat, cells[i].qlon, &hi, &lo );
+            code = hi >> ( 64 - t->precision * 5 );
+            end = code + ( (uint64_t)1 << ( ( t->precision - cells[i].len ) *
+                                            5 ) );
+            for(; code < end; code++ )
+            {
+                uint32_t c = geo_tracker_find_cell( t, code );
+
+                if( c != GEO_TRACKER_NIL ){
+                    geo_tracker_scan_cell( t, c, fn, ctx );
+                }
+            }
+        }
+        return;
+    }
+
+    for( i = 0; i < t->cells.used; i++ )
+    {
+        const geo_tracker_cell_t *cell = GEO_TRACKER_CELL( t, i );
+        geo_hash_cell_t hc = { 0, 0, t->precision };
+        double minlat, minlon, maxlat, maxlon;
+
+        if( !cell->count ){
+            continue;
+        }
+        geo_hash_int2axis( cell->code, t->precision * 5, &hc.qlat, &hc.qlon );
+        geo_hash_cell_bounds( &hc, &minlat, &minlon, &maxlat, &maxlon );
+        if( classify( region, minlat, minlon, maxlat,
+                      maxlon ) != GEO_COVER_OUTSIDE ){
+            geo_tracker_scan_cell( t, i, fn, ctx );
+        }
+    }
+}
+
+
+#endif
@@ -0,0 +1,89 @@
+local helper = require('test.helper');
+local pack = helper.pack;
+local unpack = helper.unpack;
+local geo = require('geo');
+local geohash = require('geo.geohash');
+local quadkeys = require('geo.quadkeys');
+local index = require('geo.index');
+local random = math.random;
+local buf = ifNil( geo.buffer() );
+local packed = {};
+
+math.randomseed( 1 );
+ifNotEqual( #buf, 0 );
+ifNotEqual( tostring( buf ):find( '^geo.buffer: ' ), 1 );
+
+-- amortized appends
+for i = 1, 1000 do
+    local lat = random() * 180 - 90;
+    local lon = random() * 360 - 180;
+
+    ifNotEqual( buf:push( lat, lon ), i );
+    packed[i] = pack( '=dd', lat, lon );
+end
+packed = table.concat( packed );
+ifNotEqual( #buf, 1000 );
+ifNotEqual( buf:len(), 1000 );
+ifTrue( buf:cap() < 1000 );
+do
+    local lat, lon, id = buf:get( 10 );
+
+    ifNotEqual( lat, unpack( '=d', packed, 9 * 16 + 1 ) );
+    ifNotNil( id );
+    buf:set( 10, 1, 2 );
+    ifNotEqual( select( 2, buf:get( 10 ) ), 2 );
+    buf:set( 10, lat, lon );
+end
+
+-- the batch functions accept the buffer
+ifNotEqual( geohash.encode_batch( buf, 12 ), geohash.encode_batch( packed, 12 ) );
+ifNotEqual( quadkeys.encode_batch( buf, 16 ), quadkeys.encode_batch( packed, 16 ) );
+ifNotEqual( quadkeys.pyramid( buf, 4, 8 )[4].counts,
+            quadkeys.pyramid( packed, 4, 8 )[4].counts );
+do
+    local a = geo.distance_many( 35, 139, buf );
+    local b = geo.distance_many( 35, 139, packed );
+
+    for i = 1, #b do
+        ifNotEqual( a[i], b[i] );
+    end
+end
+
+-- append the packed coordinates and the buffer itself
+ifNotEqual( buf:append( packed ), 2000 );
+ifNotEqual( buf:append( buf ), 4000 );
+ifNotEqual( geohash.encode_batch( buf, 8 ), geohash.encode_batch( packed:rep( 4 ), 8 ) );
+
+-- resize and clear
+ifNil( buf:resize( 10 ) );
+ifNotEqual( #buf, 10 );
+ifNil( buf:resize( 12 ) );
+ifNotEqual( select( 1, buf:get( 12 ) ), 0 );
+buf:clear();
+ifNotEqual( #buf, 0 );
+ifTrue( pcall( buf.get, buf, 1 ) );
+
+-- identifiers are used by the index
+do
+    local ibuf = geo.buffer( 4, true );
+    local idx;
+
+    ibuf:push( 35.6, 139.7, 100 );
+    ibuf:push( 35.7, 139.8, 200 );
+    ifNotEqual( select( 3, ibuf:get( 2 ) ), 200 );
+    ifNotEqual( select( '#', ibuf:pointers() ), 3 );
+    idx = ifNil( index.new( ibuf ) );
+    ifNotEqual( idx:knn( 35.71, 139.81, 1 )[1], 200 );
+    -- the ids table takes precedence
+    idx = ifNil( index.new( ibuf, { 1, 2 } ) );
+    ifNotEqual( idx:knn( 35.71, 139.81, 1 )[1], 2 );
+end
+
+-- raw pointers
+do
+    local lat, lon, ids = buf:pointers();
+
+    ifNotEqual( type( lat ), 'userdata' );
+    ifNotEqual( type( lon ), 'userdata' );
+    ifNotNil( ids );
+end
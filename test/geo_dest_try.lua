@@ -0,0 +1,74 @@
+local geo = require('geo');
+local unpack = require('test.helper').unpack;
+local R = 6378137.0;
+local rad = math.pi / 180;
+
+-- reference implementation of the destination on the sphere
+local function destination( lat, lon, dist, angle )
+    local d = dist / R;
+    local lat1 = lat * rad;
+    local a = angle * rad;
+    local lat2 = math.asin( math.sin( lat1 ) * math.cos( d ) +
+                            math.cos( lat1 ) * math.sin( d ) * math.cos( a ) );
+    local lon2 = lon * rad + math.atan( math.sin( a ) * math.sin( d ) *
+                                        math.cos( lat1 ),
+                                        math.cos( d ) - math.sin( lat1 ) *
+                                        math.sin( lat2 ) );
+    lon2 = ( lon2 + math.pi ) % ( math.pi * 2 ) - math.pi;
+    return lat2 / rad, lon2 / rad;
+end
+
+local function near( a, b )
+    return math.abs( a - b ) < 1e-9 or math.abs( math.abs( a - b ) - 360 ) < 1e-9;
+end
+
+ifNotNil( geo.dest( 91, 0 ) );
+ifNotNil( geo.dest( 0, 181 ) );
+
+local dest = ifNil( geo.dest( 35.6, 139.7, 1000, 90 ) );
+local lat, lon, dist, angle = dest:get();
+local elat, elon = destination( 35.6, 139.7, 1000, 90 );
+ifFalse( near( lat, elat ) );
+ifFalse( near( lon, elon ) );
+ifNotEqual( dist, 1000 );
+ifNotEqual( angle, 90 );
+
+-- incremental updates
+for _, v in ipairs({
+    { 35.6, 139.7, 5000, 45 },
+    { 35.6, 139.7, 5000, 300 },
+    { 35.6, 139.7, 2000000, 300 },
+    { -80, 170, 2000000, 300 },
+    { -80, 170, 2000000, 90 },
+}) do
+    dest:set_pivot( v[1], v[2] );
+    dest:set_distance( v[3] );
+    lat, lon = dest:set_angle( v[4] );
+    elat, elon = destination( v[1], v[2], v[3], v[4] );
+    ifFalse( near( lat, elat ) );
+    ifFalse( near( lon, elon ) );
+end
+
+-- across the pole and the antimeridian
+dest = geo.dest( 89, 179.5, 300000, 0 );
+lat, lon = dest:get();
+elat, elon = destination( 89, 179.5, 300000, 0 );
+ifFalse( near( lat, elat ) );
+ifFalse( near( lon, elon ) );
+
+-- ring of bearings
+dest = geo.dest( 35.6, 139.7, 10000, 15 );
+local n = 360;
+local ring = dest:ring( n );
+ifNotEqual( #ring, n * 16 );
+for i = 0, n - 1 do
+    lat, lon = unpack( '=dd', ring, i * 16 + 1 );
+    elat, elon = destination( 35.6, 139.7, 10000, 15 + i * 360 / n );
+    ifFalse( near( lat, elat ) );
+    ifFalse( near( lon, elon ) );
+end
+-- the current bearing is kept
+ifNotEqual( select( 4, dest:get() ), 15 );
+elat, elon = destination( 35.6, 139.7, 10000, 15 );
+ifFalse( near( dest:get(), elat ) );
+ifTrue( pcall( dest.ring, dest, 0 ) );
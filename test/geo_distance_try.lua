@@ -0,0 +1,97 @@
+local geo = require('geo');
+local pack = require('test.helper').pack;
+local coords = {};
+local points = {};
+
+-- reference implementation of the hubeny's formula
+local function hubeny( lat1, lon1, lat2, lon2 )
+    local rad = math.pi / 180;
+    local ave = ( lat1 + lat2 ) * rad / 2;
+    local w = math.sqrt( 1 - 0.006694379990197 * math.sin( ave ) ^ 2 );
+    local dlon = ( lon1 - lon2 ) * rad;
+
+    if dlon > math.pi then
+        dlon = dlon - math.pi * 2;
+    elseif dlon < -math.pi then
+        dlon = dlon + math.pi * 2;
+    end
+    return math.sqrt(
+        ( ( lat1 - lat2 ) * rad * 6335439.327292464877011 / w ^ 3 ) ^ 2 +
+        ( dlon * 6378137.0 / w * math.cos( ave ) ) ^ 2
+    );
+end
+
+local function near( a, b )
+    return math.abs( a - b ) <= b * 1e-12 + 1e-9;
+end
+
+-- tokyo station to shin-osaka station
+ifTrue( math.abs( geo.distance( 35.681236, 139.767125, 34.733713, 135.500224 ) -
+                  403000 ) > 1000 );
+ifNotEqual( geo.distance( 10, 20, 10, 20 ), 0 );
+-- across the antimeridian
+ifFalse( near( geo.distance( 0, 179.5, 0, -179.5 ),
+               geo.distance( 0, -0.5, 0, 0.5 ) ) );
+ifNotNil( geo.distance( 91, 0, 0, 0 ) );
+ifNotNil( geo.distance( 0, 0, 0, 181 ) );
+
+for lat = -90, 90, 7.3 do
+    for lon = -180, 180, 11.9 do
+        coords[#coords + 1] = pack( '=dd', lat, lon );
+        points[#points + 1] = { lat, lon };
+    end
+end
+coords = table.concat( coords );
+
+for _, origin in ipairs({ { 35.6, 139.7 }, { -89.9, -179.9 }, { 0, 180 } }) do
+    local dists = ifNil( geo.distance_many( origin[1], origin[2], coords ) );
+
+    ifNotEqual( #dists, #points );
+    for i, p in ipairs( points ) do
+        ifFalse( near( dists[i], hubeny( origin[1], origin[2], p[1], p[2] ) ) );
+        ifFalse( near( dists[i], geo.distance( origin[1], origin[2], p[1], p[2] ) ) );
+    end
+end
+
+-- invalid arguments
+local dists, err, idx = geo.distance_many( 0, 0, pack( '=dddd', 1, 1, 1, 200 ) );
+ifNotNil( dists );
+ifNil( err );
+ifNotEqual( idx, 2 );
+ifNotNil( geo.distance_many( 95, 0, coords ) );
+ifTrue( pcall( geo.distance_many, 0, 0, coords:sub( 2 ) ) );
+ifNotEqual( #geo.distance_many( 0, 0, '' ), 0 );
+
+-- distance models
+local flinders = { -( 37 + 57 / 60 + 3.72030 / 3600 ), 144 + 25 / 60 + 29.52440 / 3600 };
+local buninyong = { -( 37 + 39 / 60 + 10.15610 / 3600 ), 143 + 55 / 60 + 35.38390 / 3600 };
+local d = geo.distance( flinders[1], flinders[2], buninyong[1], buninyong[2], 'vincenty' );
+ifTrue( math.abs( d - 54972.271 ) > 0.001 );
+ifNotEqual( geo.distance( 1, 2, 1, 2, 'vincenty' ), 0 );
+-- vincenty does not converge for the nearly antipodal points
+do
+    local dist, err = geo.distance( 0, 0, 0.5, 179.7, 'vincenty' );
+
+    ifNotNil( dist );
+    ifNil( err );
+    dists, err, idx = geo.distance_many( 0, 0, pack( '=dddddd', 1, 1, 0.5, 179.7, 2, 2 ),
+                                         'vincenty' );
+    ifNotNil( dists );
+    ifNil( err );
+    ifNotEqual( idx, 2 );
+end
+for _, model in ipairs({ 'equirect', 'haversine', 'hubeny' }) do
+    local v = geo.distance( flinders[1], flinders[2], buninyong[1], buninyong[2], model );
+    ifTrue( math.abs( v - d ) / d > 0.006 );
+end
+ifTrue( pcall( geo.distance, 0, 0, 1, 1, 'unknown' ) );
+
+for _, model in ipairs({ 'equirect', 'haversine', 'hubeny', 'vincenty' }) do
+    local dists = ifNil( geo.distance_many( 35.6, 139.7, coords, model ) );
+
+    ifNotEqual( #dists, #points );
+    for i, p in ipairs( points ) do
+        local v = geo.distance( 35.6, 139.7, p[1], p[2], model );
+        ifFalse( v ~= v and dists[i] ~= dists[i] or near( dists[i], v ) );
+    end
+end
@@ -0,0 +1,123 @@
+local concat = table.concat;
+local geo = require('geo');
+local geohash = require('geo.geohash');
+local random = math.random;
+local lines = {};
+local json = {};
+local points = {};
+
+-- reads all the rows of the reader
+local function readall( rd )
+    local rows = {};
+
+    for buf in rd do
+        for i = 1, #buf do
+            rows[#rows + 1] = { buf:get( i ) };
+        end
+    end
+
+    return rows;
+end
+
+local function verify( rows )
+    ifNotEqual( #rows, #points );
+    for i, p in ipairs( points ) do
+        ifNotEqual( rows[i][1], p[1] );
+        ifNotEqual( rows[i][2], p[2] );
+        ifNotEqual( rows[i][3], p[3] );
+    end
+end
+
+math.randomseed( 1 );
+for i = 1, 5000 do
+    local lat = tonumber( ( '%.6f' ):format( random() * 180 - 90 ) );
+    local lon = tonumber( ( '%.17g' ):format( random() * 360 - 180 ) );
+    local id = random( -1e12, 1e12 );
+
+    points[i] = { lat, lon, id };
+    lines[i] = ( '%d,%.6f,%.17g' ):format( id, lat, lon );
+    json[i] = ( '{"id": %d, "name": "lat", "lat": %.6f, "lon":%.17g}' ):format( id, lat, lon );
+end
+
+-- csv string with the CRLF, the empty lines and no newline at the end
+verify( readall( geo.reader( concat( lines, '\r\n', 1, 2500 ) .. '\n\n' ..
+                             concat( lines, '\n', 2501 ), { rows = 333 } ) ) );
+-- ndjson
+verify( readall( geo.reader( concat( json, '\n' ), { format = 'ndjson' } ) ) );
+-- header and the column numbers
+do
+    local csv = { 'name,lon,lat' };
+    local rows;
+
+    for i, p in ipairs( points ) do
+        csv[i + 1] = ( 'p%d, %.17g , %.6f' ):format( i, p[2], p[1] );
+    end
+    rows = readall( geo.reader( concat( csv, '\n' ), { header = true, id = 0, lat = 3, lon = 2 } ) );
+    ifNotEqual( #rows, #points );
+    ifNotEqual( rows[10][1], points[10][1] );
+    ifNotEqual( rows[10][3], 10 );
+end
+
+-- file descriptor with the small read buffer
+do
+    local path = os.tmpname();
+    local f = assert( io.open( path, 'w' ) );
+    local ok, fd;
+
+    f:write( concat( lines, '\n' ), '\n' );
+    f:close();
+    ok, fd = pcall( function()
+        return require('posix.fcntl').open( path, require('posix.fcntl').O_RDONLY );
+    end );
+    if ok and fd then
+        local rd = geo.reader( fd, { bufsize = 100, rows = 1000 } );
+
+        verify( readall( rd ) );
+        ifNotEqual( rd:lineno(), #lines );
+        require('posix.unistd').close( fd );
+    end
+    os.remove( path );
+end
+
+-- the buffer feeds the batch encoder
+do
+    local rd = geo.reader( concat( lines, '\n' ), { rows = 1000 } );
+    local buf = ifNil( rd:read() );
+
+    ifNotEqual( #buf, 1000 );
+    ifNotEqual( #ifNil( geohash.encode_batch( buf, 8 ) ), 8000 );
+end
+
+-- invalid line
+do
+    local rd = geo.reader( '1,1,1\n2,x,2\n3,3,3\n4,5,x\n' );
+    local buf, err, lineno = rd:read();
+
+    -- the rows before the invalid line
+    ifNotEqual( #buf, 1 );
+    ifNotEqual( select( 3, buf:get( 1 ) ), 1 );
+    ifNotEqual( rd:lineno(), 1 );
+    -- the invalid line is skipped
+    buf, err, lineno = rd:read();
+    ifNotNil( buf );
+    ifNil( err );
+    ifNotEqual( lineno, 2 );
+    ifNotEqual( rd:lineno(), 2 );
+    buf = rd:read();
+    ifNotEqual( #buf, 1 );
+    ifNotEqual( select( 3, buf:get( 1 ) ), 3 );
+    buf, err, lineno = rd:read();
+    ifNotNil( buf );
+    ifNil( err );
+    ifNotEqual( lineno, 4 );
+    ifNotNil( rd:read() );
+    ifNotEqual( rd:lineno(), 4 );
+    ifTrue( pcall( readall, geo.reader( '1,2\n' ) ) );
+    ifTrue( pcall( readall, geo.reader( '{"lat":1}', { format = 'ndjson' } ) ) );
+end
+
+-- invalid arguments
+ifTrue( pcall( geo.reader, {} ) );
+ifTrue( pcall( geo.reader, '', { format = 'xml' } ) );
+ifTrue( pcall( geo.reader, '', { rows = 0 } ) );
+ifTrue( pcall( geo.reader, '', { lat = 0 } ) );
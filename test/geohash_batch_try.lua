@@ -0,0 +1,73 @@
+local helper = require('test.helper');
+local pack = helper.pack;
+local unpack = helper.unpack;
+local concat = table.concat;
+local geo = require('geo.geohash');
+local incr = 0.7;
+local LAT_MAX = 90.0;
+local LON_MAX = 180.0;
+local coords = {};
+local points = {};
+local buf, hashes, latlon, err, idx;
+
+for lat = -LAT_MAX, LAT_MAX, incr do
+    for lon = -LON_MAX, LON_MAX, incr do
+        coords[#coords + 1] = pack( '=dd', lat, lon );
+        points[#points + 1] = { lat, lon };
+    end
+end
+buf = concat( coords );
+
+for precision = 1, 16 do
+    hashes = ifNil( geo.encode_batch( buf, precision ) );
+    ifNotEqual( #hashes, #points * precision );
+    latlon = ifNil( geo.decode_batch( hashes, precision ) );
+    ifNotEqual( #latlon, #buf );
+
+    for i, p in ipairs( points ) do
+        local hash = hashes:sub( ( i - 1 ) * precision + 1, i * precision );
+        local lat, lon = unpack( '=dd', latlon, ( i - 1 ) * 16 + 1 );
+        local dlat, dlon = geo.decode( hash );
+
+        ifNotEqual( hash, geo.encode( p[1], p[2], precision ) );
+        ifNotEqual( lat, dlat );
+        ifNotEqual( lon, dlon );
+    end
+end
+
+-- empty buffer
+ifNotEqual( ifNil( geo.encode_batch( '', 8 ) ), '' );
+ifNotEqual( ifNil( geo.decode_batch( '', 8 ) ), '' );
+
+-- invalid coordinates
+hashes, err, idx = geo.encode_batch( buf .. pack( '=dd', 0, 181 ), 8 );
+ifNotNil( hashes );
+ifNil( err );
+ifNotEqual( idx, #points + 1 );
+
+-- invalid hash
+latlon, err, idx = geo.decode_batch( 'xn76gnjuxn76gnja', 8 );
+ifNotNil( latlon );
+ifNil( err );
+ifNotEqual( idx, 2 );
+
+-- worker threads
+hashes = ifNil( geo.encode_batch( buf, 12 ) );
+ifNotEqual( geo.encode_batch( buf, 12, 4 ), hashes );
+ifNotEqual( geo.encode_batch( buf, 12, 0 ), hashes );
+ifNotEqual( geo.decode_batch( hashes, 12, 4 ), geo.decode_batch( hashes, 12 ) );
+-- the first invalid coordinate is reported
+hashes, err, idx = geo.encode_batch( buf:sub( 1, 16 * 100000 ) .. pack( '=dd', 91, 0 ) ..
+                                     buf:sub( 16 * 100000 + 1 ) .. pack( '=dd', 91, 0 ), 8, 4 );
+ifNotNil( hashes );
+ifNil( err );
+ifNotEqual( idx, 100001 );
+
+-- invalid arguments
+ifTrue( pcall( geo.encode_batch, buf, 8, -1 ) );
+ifTrue( pcall( geo.encode_batch, buf .. 'x', 8 ) );
+ifTrue( pcall( geo.encode_batch, buf, 17 ) );
+ifTrue( pcall( geo.decode_batch, 'xn76gnj', 8 ) );
+
+-- name of the batch kernel
+ifNil( ({ avx2 = true, ['sse4.1'] = true, scalar = true })[geo.kernel] );
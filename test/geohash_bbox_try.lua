@@ -0,0 +1,55 @@
+local geo = require('geo.geohash');
+local floor = math.floor;
+local random = math.random;
+
+math.randomseed( 1 );
+for _ = 1, 20000 do
+    local lat = random() * 180 - 90;
+    local lon = random() * 360 - 180;
+    local precision = random( 1, 16 );
+    local hash = ifNil( geo.encode( lat, lon, precision ) );
+    local minlat, minlon, maxlat, maxlon, laterr, lonerr = geo.decode_bbox( hash );
+    local clat, clon = geo.decode( hash );
+
+    ifNil( minlat, minlon );
+    -- the cell contains the coordinate and its center
+    ifFalse( minlat <= lat and lat <= maxlat );
+    ifFalse( minlon <= lon and lon <= maxlon );
+    ifNotEqual( ( minlat + maxlat ) / 2, clat );
+    ifNotEqual( ( minlon + maxlon ) / 2, clon );
+    ifNotEqual( maxlat - minlat, laterr * 2 );
+    ifNotEqual( maxlon - minlon, lonerr * 2 );
+    -- the number of bits of each axis
+    ifNotEqual( 180 / ( maxlat - minlat ), 2 ^ ( floor( precision * 5 / 2 ) ) );
+    ifNotEqual( 360 / ( maxlon - minlon ), 2 ^ ( precision * 5 - floor( precision * 5 / 2 ) ) );
+    -- case insensitive
+    ifNotEqual( select( 3, geo.decode_bbox( hash:upper() ) ), maxlat );
+end
+
+-- whole cells of the first character
+do
+    local minlat, minlon, maxlat, maxlon, laterr, lonerr = geo.decode_bbox( '0' );
+
+    ifNotEqual( minlat, -90 );
+    ifNotEqual( minlon, -180 );
+    ifNotEqual( maxlat, -45 );
+    ifNotEqual( maxlon, -135 );
+    ifNotEqual( laterr, 22.5 );
+    ifNotEqual( lonerr, 22.5 );
+    minlat, minlon, maxlat, maxlon = geo.decode_bbox( 'z' );
+    ifNotEqual( maxlat, 90 );
+    ifNotEqual( maxlon, 180 );
+end
+
+-- invalid hash
+do
+    local minlat, minlon, maxlat, maxlon, laterr, lonerr, err = geo.decode_bbox( 'xn7a' );
+
+    ifNotNil( minlat );
+    ifNotNil( minlon );
+    ifNotNil( lonerr );
+    ifNil( err );
+    ifNotEqual( select( '#', geo.decode_bbox( 'xn7a' ) ), 7 );
+end
+ifNotNil( geo.decode_bbox( '' ) );
+ifNotNil( geo.decode_bbox( ( 'x' ):rep( 17 ) ) );
@@ -0,0 +1,127 @@
+local geohash = require('geo.geohash');
+local polygon = require('geo.polygon');
+local random = math.random;
+local helper = require('test.helper');
+
+math.randomseed( 1 );
+
+local function pack( ring )
+    local buf = {};
+
+    for i = 1, #ring, 2 do
+        buf[#buf + 1] = helper.pack( '=dd', ring[i], ring[i + 1] );
+    end
+    return table.concat( buf );
+end
+
+local function join( ... )
+    local arr = {};
+
+    for i = 1, select( '#', ... ) do
+        arr[i] = tostring( ( select( i, ... ) ) );
+    end
+    return table.concat( arr, ',' );
+end
+
+-- same results as the uncached functions
+do
+    local c = ifNil( geohash.cache( 64 ) );
+    local hits, misses, evictions;
+
+    ifNotEqual( #c, 0 );
+    for _ = 1, 2 do
+        for _, hash in ipairs( { 'xn76urx4', 'u', 'zzzzzz', 'bpbpbp', 'xn76urx4u09whhxh' } ) do
+            ifNotEqual( join( c:neighbors( hash ) ),
+                        join( geohash.neighbors( hash ) ) );
+            ifNotEqual( join( c:decode_bbox( hash ) ),
+                        join( geohash.decode_bbox( hash ) ) );
+        end
+        for _, code in ipairs( { 0, 12345, 2 ^ 40 - 1 } ) do
+            ifNotEqual( join( c:neighbors_int( code, 40 ) ),
+                        join( geohash.neighbors_int( code, 40 ) ) );
+        end
+    end
+    -- the hashes longer than 12 characters are not cached
+    hits, misses, evictions = c:stats();
+    ifNotEqual( hits, 11 );
+    ifNotEqual( misses, 11 );
+    ifNotEqual( evictions, 0 );
+    ifNotEqual( #c, 11 );
+
+    -- north of the pole
+    ifNotNil( c:neighbors( 'zzzz' ) );
+    ifNil( select( 3, c:neighbors( 'zzzz' ) ) );
+
+    ifNotNil( c:neighbors( 'xn7a' ) );
+    ifNotNil( c:decode_bbox( '' ) );
+    ifNil( select( 7, c:decode_bbox( 'xn7a' ) ) );
+    ifTrue( pcall( c.neighbors_int, c, 2 ^ 40, 40 ) );
+
+    c:clear();
+    ifNotEqual( #c, 0 );
+    ifNotEqual( select( 1, c:stats() ), 0 );
+end
+
+-- bounded by the CLOCK eviction
+do
+    local c = ifNil( geohash.cache( 16 ) );
+    local hits, misses, evictions;
+
+    for i = 1, 1000 do
+        c:neighbors_int( i, 20 );
+    end
+    ifNotEqual( #c, 16 );
+    hits, misses, evictions = c:stats();
+    ifNotEqual( hits, 0 );
+    ifNotEqual( misses, 1000 );
+    ifNotEqual( evictions, 1000 - 16 );
+
+    -- the entries used repeatedly survive
+    c:clear();
+    for _ = 1, 3 do
+        for i = 1, 4 do
+            c:neighbors_int( i, 20 );
+        end
+    end
+    for i = 100, 200 do
+        c:neighbors_int( i, 20 );
+        c:neighbors_int( 1 + i % 4, 20 );
+    end
+    hits = c:stats();
+    ifFalse( hits > 8 + 90 );
+end
+
+-- polygon membership
+do
+    local ring = {};
+
+    for i = 0, 99 do
+        local a = i * math.pi / 50;
+        local r = i % 2 == 0 and 0.5 or 0.3;
+
+        ring[#ring + 1] = 35.68 + r * math.sin( a );
+        ring[#ring + 1] = 139.76 + r * math.cos( a );
+    end
+
+    local p = ifNil( polygon.new( pack( ring ), 0 ) );
+    local q = ifNil( polygon.new( pack( { 35.6, 139.6, 35.8, 139.6, 35.7, 139.9 } ) ) );
+    local c = ifNil( geohash.cache( 4096, 6 ) );
+    local points = {};
+
+    for i = 1, 200 do
+        points[i] = { 35.1 + random() * 1.2, 139.1 + random() * 1.3 };
+    end
+    for _ = 1, 5 do
+        for _, pt in ipairs( points ) do
+            ifNotEqual( p:contains( pt[1], pt[2], c ), p:contains( pt[1], pt[2] ) );
+            ifNotEqual( q:contains( pt[1], pt[2], c ), q:contains( pt[1], pt[2] ) );
+        end
+    end
+    ifFalse( select( 1, c:stats() ) > 1500 );
+    ifNotEqual( p:contains( 91, 0, c ), false );
+    ifTrue( pcall( p.contains, p, 0, 0, {} ) );
+end
+
+-- invalid arguments
+ifTrue( pcall( geohash.cache, 0 ) );
+ifTrue( pcall( geohash.cache, 16, 13 ) );
@@ -0,0 +1,102 @@
+local geo = require('geo.geohash');
+local random = math.random;
+local sin = math.sin;
+local cos = math.cos;
+local asin = math.asin;
+local atan = math.atan;
+local rad = math.rad;
+local deg = math.deg;
+local R = 6378137;
+
+-- returns true if the hash of the point is covered by the cells
+local function covered( cells, lat, lon )
+    local hash = geo.encode( lat, lon, 16 );
+
+    for _, cell in ipairs( cells ) do
+        if hash:sub( 1, #cell ) == cell then
+            return true;
+        end
+    end
+
+    return false;
+end
+
+-- returns the point of the distance and bearing from the origin
+local function dest( lat, lon, dist, bearing )
+    local d = dist / R;
+    local lat1 = asin( sin( rad( lat ) ) * cos( d ) +
+                       cos( rad( lat ) ) * sin( d ) * cos( bearing ) );
+    local lon1 = rad( lon ) + atan( sin( bearing ) * sin( d ) * cos( rad( lat ) ),
+                                    cos( d ) - sin( rad( lat ) ) * sin( lat1 ) );
+
+    lon1 = ( deg( lon1 ) + 540 ) % 360 - 180;
+    return deg( lat1 ), lon1;
+end
+
+math.randomseed( 1 );
+for _ = 1, 200 do
+    local minlat = random() * 180 - 90;
+    local maxlat = minlat + random() * ( 90 - minlat ) * random() ^ 4;
+    local minlon = random() * 360 - 180;
+    local maxlon = minlon + random() * 40 * random() ^ 4;
+    local max_cells = random( 1, 128 );
+    local cells;
+
+    if maxlon > 180 then
+        maxlon = maxlon - 360;
+    end
+    cells = ifNil( geo.cover( minlat, minlon, maxlat, maxlon, max_cells ) );
+    ifTrue( #cells > max_cells and #cells > 32, 'too many cells' );
+
+    -- corners and random points inside the bbox
+    for _, p in ipairs({
+        { minlat, minlon }, { minlat, maxlon }, { maxlat, minlon },
+        { maxlat, maxlon }
+    }) do
+        ifFalse( covered( cells, p[1], p[2] ), 'not covered' );
+    end
+    for _ = 1, 50 do
+        local lon = minlon + random() * ( ( maxlon - minlon ) % 360 );
+
+        if lon > 180 then
+            lon = lon - 360;
+        end
+        ifFalse( covered( cells, minlat + random() * ( maxlat - minlat ), lon ),
+                 'not covered' );
+    end
+
+    -- sorted in ascending order
+    for i = 2, #cells do
+        ifFalse( cells[i - 1] < cells[i], 'not sorted' );
+    end
+end
+
+for _ = 1, 200 do
+    local lat = random() * 180 - 90;
+    local lon = random() * 360 - 180;
+    local radius = 10 ^ ( random() * 6 );
+    local max_cells = random( 1, 128 );
+    local cells = ifNil( geo.cover_radius( lat, lon, radius, max_cells ) );
+
+    ifTrue( #cells > max_cells and #cells > 32, 'too many cells' );
+    ifFalse( covered( cells, lat, lon ), 'not covered' );
+    for _ = 1, 50 do
+        local dlat, dlon = dest( lat, lon, radius * 0.99 * random() ^ 0.1,
+                                 random() * 2 * math.pi );
+
+        ifFalse( covered( cells, dlat, dlon ), 'not covered' );
+    end
+end
+
+-- whole world
+ifNotEqual( #geo.cover( -90, -180, 90, 180, 1 ), 32 );
+-- coarse cells are kept
+ifNotEqual( table.concat( geo.cover( 0, 0, 44.9, 44.9, 1 ) ), 's' );
+-- single point
+ifNotEqual( table.concat( geo.cover( 35.673343, 139.710388, 35.673343,
+                                     139.710388, 100, 8 ) ), 'xn76gnju' );
+
+-- invalid arguments
+ifTrue( pcall( geo.cover, 10, 0, 0, 10, 8 ) );
+ifTrue( pcall( geo.cover, 0, 0, 10, 10, 0 ) );
+ifTrue( pcall( geo.cover_radius, 0, 0, -1, 8 ) );
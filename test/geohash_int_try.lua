@@ -0,0 +1,46 @@
+local floor = math.floor;
+local geo = require('geo.geohash');
+-- lua_Number of Lua 5.1 and LuaJIT represents the integers up to 53 bits
+local MAX_BITS = math.type and 62 or 53;
+-- right shift that is exact for the 64 bits integer of Lua 5.3 or later
+local rshift = math.type and load( 'return function( a, n ) return a >> n end' )() or
+               function( a, n ) return floor( a / 2 ^ n ); end;
+local incr = 0.7;
+local LAT_MAX = 90.0;
+local LON_MAX = 180.0;
+
+for lat = -LAT_MAX, LAT_MAX, incr do
+    for lon = -LON_MAX, LON_MAX, incr do
+        for precision = 1, floor( MAX_BITS / 5 ) do
+            local bits = precision * 5;
+            local hash = ifNil( geo.encode( lat, lon, precision ) );
+            local code = ifNil( geo.encode_int( lat, lon, bits ) );
+            local hcode, hbits = geo.hash2int( hash );
+            local dlat, dlon = geo.decode( hash );
+            local ilat, ilon = geo.decode_int( code, bits );
+
+            ifNotEqual( geo.int2hash( code, bits ), hash );
+            ifNotEqual( hcode, code );
+            ifNotEqual( hbits, bits );
+            ifNotEqual( ilat, dlat );
+            ifNotEqual( ilon, dlon );
+        end
+
+        -- prefix of the code of more bits
+        local code = geo.encode_int( lat, lon, MAX_BITS );
+        for bits = 1, MAX_BITS - 1 do
+            ifNotEqual( geo.encode_int( lat, lon, bits ),
+                        rshift( code, MAX_BITS - bits ) );
+        end
+    end
+end
+
+-- invalid coordinates
+ifNotNil( geo.encode_int( 91, 0 ) );
+ifNotNil( geo.encode_int( 0, -181 ) );
+-- invalid hash
+ifNotNil( geo.hash2int( 'xn76a' ) );
+-- invalid arguments
+ifTrue( pcall( geo.encode_int, 0, 0, 63 ) );
+ifTrue( pcall( geo.int2hash, 1, 62 ) );
+ifTrue( pcall( geo.decode_int, 2 ^ 10, 10 ) );
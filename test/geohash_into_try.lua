@@ -0,0 +1,101 @@
+local geo = require('geo');
+local geohash = require('geo.geohash');
+local pack = require('test.helper').pack;
+
+-- decode into the table
+do
+    local t = { foo = 'bar' };
+    local res = geo.decode( 'xn76urx4' );
+
+    ifNotEqual( geo.decode_into( 'xn76urx4', t ), t );
+    ifNotEqual( t.lat, res.lat );
+    ifNotEqual( t.lon, res.lon );
+    ifNotEqual( t.foo, 'bar' );
+
+    local ok, err = geo.decode_into( 'xn76ura!', t );
+    ifNotNil( ok );
+    ifNil( err );
+    ifNotEqual( t.lat, res.lat );
+end
+
+-- decode into the buffer
+do
+    local buf = geo.buffer();
+    local lat, lon = geohash.decode( 'xn76urx4' );
+
+    ifNotEqual( geo.decode_into( 'xn76urx4', buf ), buf );
+    ifNotEqual( geo.decode_into( 'u4pruydq', buf ), buf );
+    ifNotEqual( #buf, 2 );
+    ifNotEqual( select( 1, buf:get( 1 ) ), lat );
+    geo.decode_into( 'xn76urx4', buf, 2 );
+    ifNotEqual( select( 2, buf:get( 2 ) ), lon );
+    ifNotEqual( #buf, 2 );
+    ifTrue( pcall( geo.decode_into, 'xn76urx4', buf, 4 ) );
+    ifTrue( pcall( geo.decode_into, 'xn76urx4', 'str' ) );
+end
+
+-- encode into the hash buffer
+do
+    local hb = geohash.buffer( 8 );
+    local coords = {};
+
+    ifNotEqual( #hb, 0 );
+    ifNotEqual( hb:data(), '' );
+    ifNotEqual( hb:encode( 35.681236, 139.767125 ), 1 );
+    ifNotEqual( hb:encode( 48.858093, 2.294694 ), 2 );
+    ifNotEqual( hb:get( 1 ), geohash.encode( 35.681236, 139.767125, 8 ) );
+    ifNotEqual( hb:get( 2 ), geohash.encode( 48.858093, 2.294694, 8 ) );
+    -- overwrite
+    ifNotEqual( hb:encode( 0, 0, 1 ), 1 );
+    ifNotEqual( hb:get( 1 ), geohash.encode( 0, 0, 8 ) );
+    ifNotEqual( select( 1, hb:decode( 2 ) ), select( 1, geohash.decode( hb:get( 2 ) ) ) );
+    ifTrue( pcall( hb.get, hb, 3 ) );
+    ifTrue( pcall( hb.encode, hb, 0, 0, 4 ) );
+    ifNotNil( hb:encode( 91, 0 ) );
+    ifNotEqual( #hb, 2 );
+
+    -- same hashes as encode_batch
+    for i = 1, 100 do
+        coords[i] = pack( '=dd', i * 0.7 - 35, i * 3.1 - 155 );
+    end
+    coords = table.concat( coords );
+    hb:clear();
+    ifNotEqual( hb:encode_batch( coords ), 100 );
+    ifNotEqual( hb:encode_batch( coords ), 200 );
+    ifNotEqual( hb:data(), string.rep( geohash.encode_batch( coords, 8 ), 2 ) );
+    ifFalse( hb:pointer() ~= nil );
+
+    local n, err, idx = hb:encode_batch( pack( '=dddd', 1, 1, 1, 181 ) );
+    ifNotNil( n );
+    ifNil( err );
+    ifNotEqual( idx, 2 );
+    ifNotEqual( #hb, 201 );
+
+    ifTrue( pcall( geohash.buffer, 17 ) );
+end
+
+-- the loop does not allocate in steady state
+do
+    local hb = geohash.buffer( 12, 1 );
+    local buf = geo.buffer( 1 );
+    local t = {};
+    local hash = geohash.encode( 35.681236, 139.767125, 12 );
+    local before;
+
+    geo.decode_into( hash, t );
+    hb:encode( 0, 0, 1 );
+    collectgarbage();
+    collectgarbage( 'stop' );
+    before = collectgarbage( 'count' );
+    for i = 1, 10000 do
+        local lat, lon = geohash.decode( hash );
+
+        hb:encode( lat + i * 1e-6, lon, 1 );
+        lat, lon = hb:decode( 1 );
+        geo.decode_into( hash, t );
+        buf:clear();
+        geo.decode_into( hash, buf );
+    end
+    ifNotEqual( collectgarbage( 'count' ), before );
+    collectgarbage( 'restart' );
+end
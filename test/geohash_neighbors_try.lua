@@ -0,0 +1,81 @@
+local floor = math.floor;
+local geo = require('geo.geohash');
+local DIRS = { 'n', 'ne', 'e', 'se', 's', 'sw', 'w', 'nw' };
+local DELTA = {
+    n = { 1, 0 }, ne = { 1, 1 }, e = { 0, 1 }, se = { -1, 1 },
+    s = { -1, 0 }, sw = { -1, -1 }, w = { 0, -1 }, nw = { 1, -1 }
+};
+
+-- returns the neighbor by decode and re-encode
+local function neighbor( hash, dir )
+    local lat, lon = geo.decode( hash );
+    local bits = #hash * 5;
+    local dlat = 180 / 2 ^ floor( bits / 2 );
+    local dlon = 360 / 2 ^ ( bits - floor( bits / 2 ) );
+
+    lat = lat + DELTA[dir][1] * dlat;
+    lon = lon + DELTA[dir][2] * dlon;
+    if lat > 90 or lat < -90 then
+        return nil;
+    elseif lon > 180 then
+        lon = lon - 360;
+    elseif lon < -180 then
+        lon = lon + 360;
+    end
+
+    return geo.encode( lat, lon, #hash );
+end
+
+for lat = -90, 90, 1.3 do
+    for lon = -180, 180, 1.3 do
+        for precision = 1, 16 do
+            local hash = geo.encode( lat, lon, precision );
+            local list = { geo.neighbors( hash ) };
+
+            for i, dir in ipairs( DIRS ) do
+                local exp = neighbor( hash, dir );
+
+                ifNotEqual( list[i], exp );
+                ifNotEqual( geo.adjacent( hash, dir ), exp );
+            end
+
+            if precision <= 12 then
+                local bits = precision * 5;
+                local code = geo.encode_int( lat, lon, bits );
+                local ilist = { geo.neighbors_int( code, bits ) };
+
+                for i = 1, 8 do
+                    ifNotEqual( ilist[i] and geo.int2hash( ilist[i], bits ), list[i] );
+                end
+            end
+        end
+    end
+end
+
+-- known neighbors
+local n, ne, e, se, s, sw, w, nw = geo.neighbors( 'ezs42' );
+ifNotEqual( n, 'ezs48' );
+ifNotEqual( ne, 'ezs49' );
+ifNotEqual( e, 'ezs43' );
+ifNotEqual( se, 'ezs41' );
+ifNotEqual( s, 'ezs40' );
+ifNotEqual( sw, 'ezefp' );
+ifNotEqual( w, 'ezefr' );
+ifNotEqual( nw, 'ezefx' );
+
+-- antimeridian
+ifNotEqual( geo.adjacent( 'zzz', 'e' ), 'bpb' );
+ifNotEqual( geo.adjacent( 'bpb', 'w' ), 'zzz' );
+-- poles
+ifNotNil( geo.adjacent( 'zzz', 'n' ) );
+ifNotNil( geo.adjacent( 'zzz', 'ne' ) );
+ifNotNil( geo.adjacent( '000', 's' ) );
+ifNotEqual( geo.adjacent( '000', 'n' ), '002' );
+-- case insensitive
+ifNotEqual( geo.adjacent( 'EZS42', 'n' ), 'ezs48' );
+
+-- invalid hash
+local v, err = geo.neighbors( 'ezs4a' );
+ifNotNil( v );
+ifNil( err );
+ifTrue( pcall( geo.adjacent, 'ezs42', 'up' ) );
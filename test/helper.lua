@@ -0,0 +1,181 @@
+-- subset of string.pack and string.unpack for the tests that run on Lua 5.1
+-- and LuaJIT as well as Lua 5.3 or later.
+--
+-- the format is '=' followed by the options of 'd' (native double), 'i4',
+-- 'I4', 'i8' and 'I8' in the little-endian byte order of the host.
+local floor = math.floor;
+local log = math.log;
+local huge = math.huge;
+local byte = string.byte;
+local char = string.char;
+local concat = table.concat;
+local unpackarr = unpack or table.unpack;
+local LOG2 = log( 2 );
+local INT32 = 4294967296;
+local SIGN32 = 2147483648;
+
+local function optiter( fmt )
+    local pos = 1;
+
+    if fmt:sub( 1, 1 ) == '=' then
+        pos = 2;
+    end
+
+    return function()
+        local opt, size;
+
+        if pos > #fmt then
+            return nil;
+        end
+        opt = fmt:sub( pos, pos );
+        if opt == 'd' then
+            pos = pos + 1;
+            return opt, 8;
+        elseif opt == 'i' or opt == 'I' then
+            size = tonumber( fmt:sub( pos + 1, pos + 1 ) );
+            if size == 4 or size == 8 then
+                pos = pos + 2;
+                return opt, size;
+            end
+        end
+        error( 'unsupported format: ' .. fmt, 3 );
+    end
+end
+
+
+-- bytes of the integer in [0, 2^32)
+local function packuint32( v, arr )
+    for _ = 1, 4 do
+        arr[#arr + 1] = char( v % 256 );
+        v = floor( v / 256 );
+    end
+end
+
+
+local function unpackuint32( s, pos )
+    local b1, b2, b3, b4 = byte( s, pos, pos + 3 );
+
+    return ( ( b4 * 256 + b3 ) * 256 + b2 ) * 256 + b1;
+end
+
+
+local function packdouble( x, arr )
+    local sign = 0;
+    local e, m;
+
+    if x < 0 or ( x == 0 and 1 / x < 0 ) then
+        sign = 0x80;
+        x = -x;
+    end
+
+    if x ~= x then
+        e, m = 0x7ff, 2 ^ 51;
+    elseif x == huge then
+        e, m = 0x7ff, 0;
+    elseif x == 0 then
+        e, m = 0, 0;
+    else
+        e = floor( log( x ) / LOG2 );
+        -- correct the rounding error of the logarithm
+        while e > -1074 and 2 ^ e > x do
+            e = e - 1;
+        end
+        while 2 ^ ( e + 1 ) <= x do
+            e = e + 1;
+        end
+        if e < -1022 then
+            -- subnormal
+            e, m = 0, x / 2 ^ -1074;
+        else
+            e, m = e + 1023, ( x / 2 ^ e - 1 ) * 2 ^ 52;
+        end
+    end
+
+    -- 52 bits of the mantissa, 11 bits of the exponent and the sign bit
+    packuint32( m % INT32, arr );
+    packuint32( floor( m / INT32 ) + e * 2 ^ 20 + sign * 2 ^ 24, arr );
+end
+
+
+local function unpackdouble( s, pos )
+    local lo = unpackuint32( s, pos );
+    local hi = unpackuint32( s, pos + 4 );
+    local sign = hi >= SIGN32 and -1 or 1;
+    local e = floor( hi / 2 ^ 20 ) % 0x800;
+    local m = ( hi % 2 ^ 20 ) * INT32 + lo;
+
+    if e == 0x7ff then
+        return m == 0 and sign * huge or 0 / 0;
+    elseif e == 0 then
+        return sign * m * 2 ^ -1074;
+    end
+
+    return sign * ( 1 + m / 2 ^ 52 ) * 2 ^ ( e - 1023 );
+end
+
+
+local function pack( fmt, ... )
+    local arr = {};
+    local i = 0;
+
+    for opt, size in optiter( fmt ) do
+        local v;
+
+        i = i + 1;
+        v = select( i, ... );
+        if opt == 'd' then
+            packdouble( v, arr );
+        elseif size == 4 then
+            packuint32( v % INT32, arr );
+        else
+            -- the integer of Lua 5.3 or later is packed exactly since the
+            -- low 32 bits are removed before the division
+            local lo = v % INT32;
+
+            packuint32( lo, arr );
+            packuint32( ( ( v - lo ) / INT32 ) % INT32, arr );
+        end
+    end
+
+    return concat( arr );
+end
+
+
+-- returns the values and the position of the next byte
+local function unpack( fmt, s, pos )
+    local res = {};
+
+    pos = pos or 1;
+    for opt, size in optiter( fmt ) do
+        local v;
+
+        if opt == 'd' then
+            v = unpackdouble( s, pos );
+        elseif size == 4 then
+            v = unpackuint32( s, pos );
+            if opt == 'i' and v >= SIGN32 then
+                v = v - INT32;
+            end
+        else
+            -- exact with the integer of Lua 5.3 or later, and rounded once
+            -- to the nearest double on Lua 5.1 and LuaJIT
+            local hi = unpackuint32( s, pos + 4 );
+
+            if opt == 'i' and hi >= SIGN32 then
+                hi = hi - INT32;
+            end
+            v = hi * INT32 + unpackuint32( s, pos );
+        end
+        res[#res + 1] = v;
+        pos = pos + size;
+    end
+    res[#res + 1] = pos;
+
+    return unpackarr( res );
+end
+
+
+return {
+    pack = pack;
+    unpack = unpack;
+};
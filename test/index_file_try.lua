@@ -0,0 +1,78 @@
+local concat = table.concat;
+local index = require('geo.index');
+local geohash = require('geo.geohash');
+local helper = require('test.helper');
+local path = os.tmpname();
+local coords = {};
+
+for i = 1, 200 do
+    coords[i] = helper.pack( '=dd', ( i * 7919 ) % 170 - 85,
+                             ( i * 104729 ) % 350 - 175 );
+end
+coords = concat( coords );
+
+-- build offline and save
+local idx = ifNil( index.new( coords ) );
+ifNotEqual( idx:save( path ), true );
+
+-- open the mapped index
+local mapped = ifNil( index.open( path ) );
+ifNotEqual( #mapped, #idx );
+for _, q in ipairs( {
+    { 35, 139, 3000000 },
+    { -60, -170, 5000000 },
+} ) do
+    local a, ad = idx:within_radius( q[1], q[2], q[3] );
+    local b, bd = mapped:within_radius( q[1], q[2], q[3] );
+
+    ifNotEqual( concat( a, ',' ), concat( b, ',' ) );
+    ifNotEqual( concat( ad, ',' ), concat( bd, ',' ) );
+    ifNotEqual( concat( idx:knn( q[1], q[2], 5 ), ',' ),
+                concat( mapped:knn( q[1], q[2], 5 ), ',' ) );
+end
+
+-- keys on disk match the integer geohash
+local f = assert( io.open( path, 'rb' ) );
+local data = f:read( '*a' );
+local hdr = 8 + 4 + 4 + 8 + 8;
+local n = #idx;
+
+f:close();
+ifNotEqual( helper.unpack( '=I8', data, 8 + 4 + 4 + 8 + 1 ), n );
+for i = 1, n do
+    local key = helper.unpack( '=i8', data, hdr + ( i - 1 ) * 8 + 1 );
+    local lat = helper.unpack( '=d', data, hdr + n * 8 + ( i - 1 ) * 8 + 1 );
+    local lon = helper.unpack( '=d', data, hdr + n * 16 + ( i - 1 ) * 8 + 1 );
+
+    ifNotEqual( key, geohash.encode_int( lat, lon, 62 ) );
+end
+
+-- mapped index is read-only
+local ok, err = mapped:add( 0, 0, 1 );
+ifNotEqual( ok, false );
+ifNil( err );
+
+-- save over the opened index
+do
+    local other = ifNil( index.new( coords:sub( 1, 100 * 16 ) ) );
+
+    ifNotEqual( mapped:save( path ), true );
+    ifNotEqual( other:save( path ), true );
+    -- the opened index keeps the old file
+    ifNotEqual( #mapped, n );
+    ifNotEqual( concat( mapped:knn( 35, 139, 5 ), ',' ),
+                concat( idx:knn( 35, 139, 5 ), ',' ) );
+    ifNotEqual( concat( mapped:within_radius( -60, -170, 5000000 ), ',' ),
+                concat( idx:within_radius( -60, -170, 5000000 ), ',' ) );
+    ifNotEqual( #ifNil( index.open( path ) ), 100 );
+    mapped = nil;
+    collectgarbage();
+end
+
+-- invalid file
+f = assert( io.open( path, 'wb' ) );
+f:write( data:sub( 1, #data - 1 ) );
+f:close();
+ifNotNil( index.open( path ) );
+ifNotNil( index.open( path .. '.notfound' ) );
+os.remove( path );
@@ -0,0 +1,70 @@
+local concat = table.concat;
+local index = require('geo.index');
+local helper = require('test.helper');
+local name = 'geo-index-test-' .. tostring( os.time() ) .. '-' ..
+             tostring( math.random( 1e6 ) );
+
+local function pack( n, seed )
+    local coords = {};
+
+    for i = 1, n do
+        coords[i] = helper.pack( '=dd', ( i * seed ) % 170 - 85,
+                                 ( i * 104729 ) % 350 - 175 );
+    end
+    return concat( coords );
+end
+
+-- not published yet
+local idx, err = index.attach( name );
+ifNotNil( idx );
+ifNil( err );
+ifNotNil( index.attach( 'invalid/name' ) );
+
+-- publish the first snapshot
+local src = ifNil( index.new( pack( 200, 7919 ) ) );
+ifNotEqual( src:publish( name ), 1 );
+local reader = ifNil( index.attach( name ) );
+local other = ifNil( index.attach( name ) );
+ifNotEqual( reader:generation(), 1 );
+ifNotEqual( #reader, #src );
+for _, q in ipairs( {
+    { 35, 139, 3000000 },
+    { -60, -170, 5000000 },
+} ) do
+    ifNotEqual( concat( src:within_radius( q[1], q[2], q[3] ), ',' ),
+                concat( reader:within_radius( q[1], q[2], q[3] ), ',' ) );
+    ifNotEqual( concat( src:knn( q[1], q[2], 5 ), ',' ),
+                concat( reader:knn( q[1], q[2], 5 ), ',' ) );
+    ifNotEqual( concat( src:within_bbox( q[1] - 10, q[2] - 10, q[1] + 10, q[2] + 10 ), ',' ),
+                concat( reader:within_bbox( q[1] - 10, q[2] - 10, q[1] + 10, q[2] + 10 ), ',' ) );
+end
+
+-- the readers are read-only
+local ok;
+ok, err = reader:add( 0, 0, 1 );
+ifNotEqual( ok, false );
+ifNil( err );
+
+-- the readers switch to the new snapshot before the next query
+local src2 = ifNil( index.new( pack( 300, 15485863 ) ) );
+ifNotEqual( src2:publish( name ), 2 );
+ifNotEqual( #reader, 300 );
+ifNotEqual( reader:generation(), 2 );
+ifNotEqual( concat( src2:knn( 10, 20, 7 ), ',' ), concat( reader:knn( 10, 20, 7 ), ',' ) );
+-- skip the generations that replaced before the reader maps them
+ifNotEqual( src:publish( name ), 3 );
+ifNotEqual( src2:publish( name ), 4 );
+ifNotEqual( #other, 300 );
+ifNotEqual( other:generation(), 4 );
+-- the reader can publish its snapshot
+ifNotEqual( other:publish( name ), 5 );
+ifNotEqual( #reader, 300 );
+
+-- unlink the shared index
+ifNotEqual( index.unlink( name ), true );
+ifNotNil( index.attach( name ) );
+ok, err = index.unlink( name );
+ifNotEqual( ok, false );
+ifNil( err );
+-- the mapped snapshot is still available
+ifNotEqual( #reader, 300 );
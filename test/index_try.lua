@@ -0,0 +1,130 @@
+local index = require('geo.index');
+local helper = require('test.helper');
+local unpack = unpack or table.unpack;
+local incr = 0.9;
+local coords = {};
+local points = {};
+
+-- grid points around the antimeridian and the equator
+for lat = -10, 10, incr do
+    for lon = 170, 190, incr do
+        local lo = lon > 180 and lon - 360 or lon;
+
+        coords[#coords + 1] = helper.pack( '=dd', lat, lo );
+        points[#points + 1] = { lat, lo };
+    end
+end
+coords = table.concat( coords );
+
+local function distance( lat1, lon1, lat2, lon2 )
+    local rad = math.pi / 180;
+    local ave = ( lat1 + lat2 ) * rad / 2;
+    local w = math.sqrt( 1 - 0.006694379990197 * math.sin( ave ) ^ 2 );
+    local dlon = math.fmod( ( lon1 - lon2 ) * rad, math.pi * 2 );
+
+    if dlon > math.pi then
+        dlon = dlon - math.pi * 2;
+    elseif dlon < -math.pi then
+        dlon = dlon + math.pi * 2;
+    end
+
+    return math.sqrt( ( ( lat1 - lat2 ) * rad * 6335439.327292464877011 / w ^ 3 ) ^ 2 +
+                      ( dlon * 6378137.0 / w * math.cos( ave ) ) ^ 2 );
+end
+
+local function sorted( list )
+    local copy = { unpack( list ) };
+
+    table.sort( copy );
+    return table.concat( copy, ',' );
+end
+
+-- invalid arguments
+local idx, err, pos = index.new( helper.pack( '=dddd', 1, 1, 91, 1 ) );
+ifNotNil( idx );
+ifNil( err );
+ifNotEqual( pos, 2 );
+ifTrue( pcall( index.new, coords, { 1, 2 } ) );
+ifTrue( pcall( index.new, coords:sub( 2 ) ) );
+
+idx = ifNil( index.new( coords ) );
+ifNotEqual( #idx, #points );
+ifNotEqual( idx:len(), #points );
+ifTrue( pcall( idx.within_radius, idx, 91, 0, 100 ) );
+ifTrue( pcall( idx.knn, idx, 0, 0, -1 ) );
+
+-- bbox across the antimeridian
+for _, bbox in ipairs( {
+    { -3.3, 175.5, 4.1, -176.2 },
+    { -10, 170, 10, 180 },
+    { 0, 0, 1, 1 },
+} ) do
+    local expect = {};
+
+    for i, p in ipairs( points ) do
+        if p[1] >= bbox[1] and p[1] <= bbox[3] and
+           ( bbox[2] <= bbox[4] and ( p[2] >= bbox[2] and p[2] <= bbox[4] ) or
+             ( bbox[2] > bbox[4] and ( p[2] >= bbox[2] or p[2] <= bbox[4] ) ) ) then
+            expect[#expect + 1] = i;
+        end
+    end
+    ifNotEqual( sorted( idx:within_bbox( unpack( bbox ) ) ), sorted( expect ) );
+end
+
+-- radius and knn
+for _, q in ipairs( {
+    { 0.3, 179.9, 250000 },
+    { -9.5, -171.2, 100000 },
+    { 5, 175, 0 },
+    { 45, 0, 10000 },
+} ) do
+    local expect = {};
+    local dists = {};
+    local order = {};
+    local ids, ds;
+
+    for i, p in ipairs( points ) do
+        local d = distance( q[1], q[2], p[1], p[2] );
+
+        dists[i] = d;
+        if d <= q[3] then
+            expect[#expect + 1] = i;
+        end
+    end
+    ids, ds = idx:within_radius( q[1], q[2], q[3] );
+    ifNotEqual( #ids, #ds );
+    ifNotEqual( sorted( ids ), sorted( expect ) );
+    for i, id in ipairs( ids ) do
+        ifTrue( math.abs( ds[i] - dists[id] ) > 1e-6 );
+    end
+
+    for i = 1, #points do
+        order[i] = i;
+    end
+    table.sort( order, function( a, b )
+        return dists[a] < dists[b] or dists[a] == dists[b] and a < b;
+    end );
+    ids, ds = idx:knn( q[1], q[2], 7 );
+    ifNotEqual( #ids, 7 );
+    for i = 1, 7 do
+        ifTrue( math.abs( ds[i] - dists[order[i]] ) > 1e-6 );
+    end
+end
+
+-- incremental add
+idx = ifNil( index.new() );
+ifNotEqual( #idx:knn( 0, 0, 3 ), 0 );
+ifNotEqual( idx:add( 35.6, 139.7, 100 ), true );
+ifNotEqual( idx:add( 35.7, 139.8, 200 ), true );
+ifNotEqual( idx:add( -33.9, 151.2, 300 ), true );
+do
+    local ids = idx:knn( 35.65, 139.75, 5 );
+
+    ifNotEqual( #ids, 3 );
+    ifNotEqual( ids[3], 300 );
+    ifNotEqual( sorted( idx:within_radius( 35.65, 139.75, 20000 ) ), '100,200' );
+end
+
+-- custom ids
+idx = ifNil( index.new( helper.pack( '=dddd', 1, 2, 3, 4 ), { 10, 20 } ) );
+ifNotEqual( idx:knn( 3, 4, 1 )[1], 20 );
@@ -0,0 +1,140 @@
+local polygon = require('geo.polygon');
+local geohash = require('geo.geohash');
+local random = math.random;
+local helper = require('test.helper');
+
+math.randomseed( 1 );
+
+local function pack( ring )
+    local buf = {};
+
+    for i = 1, #ring, 2 do
+        buf[#buf + 1] = helper.pack( '=dd', ring[i], ring[i + 1] );
+    end
+    return table.concat( buf );
+end
+
+-- ray casting by the even-odd rule
+local function contains( rings, lat, lon )
+    local inside = false;
+
+    for _, ring in ipairs( rings ) do
+        local n = math.floor( #ring / 2 );
+
+        for i = 1, n do
+            local j = i % n + 1;
+            local lat0, lon0 = ring[i * 2 - 1], ring[i * 2];
+            local lat1, lon1 = ring[j * 2 - 1], ring[j * 2];
+
+            if ( lat0 > lat ) ~= ( lat1 > lat ) and
+               lon < lon0 + ( lat - lat0 ) * ( ( lon1 - lon0 ) / ( lat1 - lat0 ) ) then
+                inside = not inside;
+            end
+        end
+    end
+    return inside;
+end
+
+-- star shaped polygon with the hole and the separated part
+local rings = {};
+do
+    local star = {};
+
+    for i = 0, 199 do
+        local r = i % 2 == 0 and 0.5 or 0.2 + random() * 0.1;
+        local a = i * math.pi / 100;
+
+        star[#star + 1] = 35.68 + r * math.sin( a );
+        star[#star + 1] = 139.76 + r * math.cos( a );
+    end
+    rings[1] = star;
+end
+rings[2] = { 35.66, 139.74, 35.70, 139.74, 35.70, 139.78, 35.66, 139.78 };
+rings[3] = { 36.5, 140.5, 36.6, 140.5, 36.55, 140.6 };
+
+do
+    local packed = {};
+    for i, ring in ipairs( rings ) do
+        packed[i] = pack( ring );
+    end
+
+    local exact = ifNil( polygon.new( packed, 0 ) );
+    local raster = ifNil( polygon.new( packed ) );
+    local coarse = ifNil( polygon.new( packed, 64, 5 ) );
+    local hashes, inside = raster:cells();
+    local ninside = 0;
+
+    ifNotEqual( #exact, 200 + 4 + 3 );
+    ifNotEqual( #raster, #exact );
+    ifNotEqual( #exact:cells(), 0 );
+    ifFalse( #hashes > 0 and #hashes <= 256 );
+    for i, hash in ipairs( hashes ) do
+        -- cells are sorted and the inside cells are in the polygon
+        ifFalse( i == 1 or hashes[i - 1] < hash );
+        if inside[i] then
+            local lat, lon = geohash.decode( hash );
+
+            ninside = ninside + 1;
+            ifFalse( contains( rings, lat, lon ) );
+        end
+    end
+    ifFalse( ninside > 0 );
+    for _, hash in ipairs( coarse:cells() ) do
+        ifFalse( #hash <= 5 );
+    end
+
+    -- bounding box of the vertices
+    local minlat, minlon, maxlat, maxlon = raster:bbox();
+    ifFalse( minlat >= 35.18 and minlat <= 35.19 );
+    ifNotEqual( maxlat, 36.6 );
+    ifFalse( minlon >= 139.25 and minlon <= 139.27 );
+    ifNotEqual( maxlon, 140.6 );
+
+    -- same result as the ray casting
+    for _ = 1, 20000 do
+        local lat = 35.1 + random() * 1.6;
+        local lon = 139.2 + random() * 1.5;
+        local expect = contains( rings, lat, lon );
+
+        ifNotEqual( exact:contains( lat, lon ), expect );
+        ifNotEqual( raster:contains( lat, lon ), expect );
+        ifNotEqual( coarse:contains( lat, lon ), expect );
+    end
+    ifTrue( raster:contains( 35.68, 139.76 ) );
+    ifFalse( raster:contains( 35.68, 139.61 ) );
+    ifFalse( raster:contains( 36.55, 140.55 ) );
+    ifTrue( raster:contains( -35.68, 139.61 ) );
+end
+
+-- a ring and the coordinate buffer
+do
+    local geo = require('geo');
+    local buf = geo.buffer();
+
+    buf:push( 0, 0 );
+    buf:push( 10, 0 );
+    buf:push( 10, 10 );
+    buf:push( 0, 10 );
+    -- repeated first vertex
+    buf:push( 0, 0 );
+
+    local p = ifNil( polygon.new( buf ) );
+    ifFalse( p:contains( 5, 5 ) );
+    ifTrue( p:contains( 5, 10.5 ) );
+    ifTrue( p:contains( -0.5, 5 ) );
+    p = ifNil( polygon.new( pack( { 0, 0, 10, 0, 10, 10, 0, 10 } ) ) );
+    ifFalse( p:contains( 9.99, 0.01 ) );
+end
+
+-- invalid rings
+do
+    local p, err = polygon.new( pack( { 0, 0, 1, 1 } ) );
+    ifNotNil( p );
+    ifNil( err );
+    p, err = polygon.new( pack( { 0, 0, 91, 1, 0, 1 } ) );
+    ifNotNil( p );
+    ifNil( err );
+    ifTrue( pcall( polygon.new, {} ) );
+    ifTrue( pcall( polygon.new, { 1 } ) );
+    ifTrue( pcall( polygon.new, pack( { 0, 0, 1, 1, 0, 1 } ), 16, 13 ) );
+end
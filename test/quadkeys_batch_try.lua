@@ -0,0 +1,70 @@
+local helper = require('test.helper');
+local pack = helper.pack;
+local unpack = helper.unpack;
+local concat = table.concat;
+local quadkeys = require('geo.quadkeys');
+local random = math.random;
+local coords = {};
+local points = {};
+local buf, tiles, codes;
+
+math.randomseed( 1 );
+for _ = 1, 5000 do
+    local lat = random() * 180 - 90;
+    local lon = random() * 360 - 180;
+
+    coords[#coords + 1] = pack( '=dd', lat, lon );
+    points[#points + 1] = { lat, lon };
+end
+-- out of range and tile boundary coordinates
+for _, p in ipairs({
+    { 90, 180 }, { -90, -180 }, { 0, 0 }, { 85.05112878, 0 },
+    { -85.05112878, 0 }, { 0 / 0, 0 / 0 }, { 66.51326044311186, 90 },
+    { 40.97989806962013, -135 }, { -40.97989806962013, 45 },
+}) do
+    coords[#coords + 1] = pack( '=dd', p[1], p[2] );
+    points[#points + 1] = p;
+end
+buf = concat( coords );
+
+for lv = 1, 23 do
+    tiles = ifNil( quadkeys.encode_batch( buf, lv ) );
+    ifNotEqual( #tiles, #points * 8 );
+    codes = ifNil( quadkeys.encode_batch( buf, lv, 'morton' ) );
+    ifNotEqual( #codes, #points * 8 );
+
+    for i, p in ipairs( points ) do
+        local tx, ty = unpack( '=I4I4', tiles, ( i - 1 ) * 8 + 1 );
+        local x, y = quadkeys.encode2tile( p[1], p[2], lv );
+        local code = unpack( '=I8', codes, ( i - 1 ) * 8 + 1 );
+        local key = quadkeys.encode( p[1], p[2], lv );
+        local mkey = {};
+
+        ifNotEqual( tx, x );
+        ifNotEqual( ty, y );
+        -- each quadkey digit is the two bits of the morton code
+        for j = lv - 1, 0, -1 do
+            mkey[#mkey + 1] = math.floor( code / 4 ^ j ) % 4;
+        end
+        ifNotEqual( concat( mkey ), key );
+    end
+end
+
+-- worker threads
+do
+    local large = buf:rep( 10 );
+
+    ifNotEqual( quadkeys.encode_batch( large, 18, 'tile', 4 ),
+                quadkeys.encode_batch( large, 18 ) );
+    ifNotEqual( quadkeys.encode_batch( large, 18, 'morton', 4 ),
+                quadkeys.encode_batch( large, 18, 'morton' ) );
+end
+
+-- empty
+ifNotEqual( quadkeys.encode_batch( '', 10 ), '' );
+-- invalid arguments
+ifTrue( pcall( quadkeys.encode_batch, 'abc', 10 ) );
+ifTrue( pcall( quadkeys.encode_batch, buf, 0 ) );
+ifTrue( pcall( quadkeys.encode_batch, buf, 24 ) );
+ifTrue( pcall( quadkeys.encode_batch, buf, 10, 'foo' ) );
+ifNil( quadkeys.kernel );
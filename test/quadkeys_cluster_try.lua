@@ -0,0 +1,101 @@
+local geo = require('geo');
+local quadkeys = require('geo.quadkeys');
+local random = math.random;
+local helper = require('test.helper');
+
+math.randomseed( 1 );
+
+local function unpack_all( fmt, str )
+    local arr = {};
+    local pos = 1;
+
+    while pos <= #str do
+        arr[#arr + 1], pos = helper.unpack( fmt, str, pos );
+    end
+    return arr;
+end
+
+-- clusters of the points around the cities
+do
+    local centers = {
+        { 35.681236, 139.767125 }, { 34.702485, 135.495951 },
+        { 43.068661, 141.350755 }, { 33.590355, 130.401716 }
+    };
+    local lat, lon, pairs = {}, {}, {};
+    local n = 20000;
+
+    for i = 1, n do
+        local c = centers[random( #centers )];
+
+        lat[i] = c[1] + ( random() - 0.5 ) * 0.2;
+        lon[i] = c[2] + ( random() - 0.5 ) * 0.2;
+        pairs[i] = helper.pack( '=dd', lat[i], lon[i] );
+    end
+
+    for _, lv in ipairs( { 4, 10, 14 } ) do
+        local radius = 40;
+        local res = quadkeys.cluster( table.concat( pairs ), lv, radius );
+        local centroids = unpack_all( '=d', res.coords );
+        local counts = unpack_all( '=I8', res.counts );
+        local offsets = unpack_all( '=I8', res.offsets );
+        local ids = unpack_all( '=i8', res.ids );
+        local seen = {};
+        local total = 0;
+
+        ifNotEqual( #ids, n );
+        ifNotEqual( #centroids, #counts * 2 );
+        ifNotEqual( #offsets, #counts );
+        for c = 1, #counts do
+            local slat, slon = 0, 0;
+
+            ifNotEqual( offsets[c], total );
+            total = total + counts[c];
+            for k = offsets[c] + 1, offsets[c] + counts[c] do
+                local id = ids[k];
+
+                ifNotNil( seen[id] );
+                seen[id] = true;
+                slat = slat + lat[id];
+                slon = slon + lon[id];
+            end
+            -- the centroid is the mean of the members
+            ifFalse( math.abs( slat / counts[c] - centroids[c * 2 - 1] ) < 1e-9 );
+            ifFalse( math.abs( slon / counts[c] - centroids[c * 2] ) < 1e-9 );
+        end
+        ifNotEqual( total, n );
+        if lv == 4 then
+            ifFalse( #counts <= #centers );
+        elseif lv == 14 then
+            ifFalse( #counts > 1000 );
+        end
+    end
+end
+
+-- ids of the coordinate buffer
+do
+    local buf = geo.buffer( 4, true );
+
+    buf:push( 35.0, 139.0, 100 );
+    buf:push( -35.0, -139.0, 200 );
+    buf:push( 35.0000001, 139.0000001, 300 );
+    buf:push( -35.0000001, -139.0000001, 400 );
+
+    local res = quadkeys.cluster( buf, 10 );
+    local counts = unpack_all( '=I8', res.counts );
+    local ids = unpack_all( '=i8', res.ids );
+
+    ifNotEqual( #counts, 2 );
+    ifNotEqual( counts[1], 2 );
+    ifNotEqual( counts[2], 2 );
+    ifNotEqual( ids[1] + ids[2], 400 );
+    ifNotEqual( ids[3] + ids[4], 600 );
+
+    -- empty buffer
+    res = quadkeys.cluster( '', 10 );
+    ifNotEqual( res.coords, '' );
+    ifNotEqual( res.ids, '' );
+end
+
+-- invalid arguments
+ifTrue( pcall( quadkeys.cluster, '', 24 ) );
+ifTrue( pcall( quadkeys.cluster, '', 10, 0 ) );
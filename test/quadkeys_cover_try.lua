@@ -0,0 +1,67 @@
+local quadkeys = require('geo.quadkeys');
+local random = math.random;
+
+-- returns true if the quadkey of the point is covered by the tiles
+local function covered( cells, lat, lon, lv )
+    local key = quadkeys.encode( lat, lon, lv );
+
+    for _, cell in ipairs( cells ) do
+        if key:sub( 1, #cell ) == cell then
+            return true;
+        end
+    end
+
+    return false;
+end
+
+math.randomseed( 1 );
+for _ = 1, 500 do
+    local minlat = random() * 170 - 85;
+    local maxlat = minlat + random() * ( 85 - minlat ) * random() ^ 4;
+    local minlon = random() * 360 - 180;
+    local maxlon = minlon + random() * 360 * random() ^ 4;
+    local max_cells = random( 1, 128 );
+    local lv = random( 1, 23 );
+    local cells;
+
+    if maxlon > 180 then
+        maxlon = maxlon - 360;
+    end
+    cells = ifNil( quadkeys.cover( minlat, minlon, maxlat, maxlon, max_cells, lv ) );
+    ifTrue( #cells > max_cells and #cells > 4, 'too many cells' );
+
+    for _ = 1, 50 do
+        local lon = minlon + random() * ( ( maxlon - minlon ) % 360 );
+
+        if lon > 180 then
+            lon = lon - 360;
+        end
+        ifFalse( covered( cells, minlat + random() * ( maxlat - minlat ), lon, lv ),
+                 'not covered' );
+    end
+
+    -- sorted in ascending order
+    for i = 2, #cells do
+        ifFalse( cells[i - 1] < cells[i], 'not sorted' );
+    end
+end
+
+-- whole world
+ifNotEqual( table.concat( quadkeys.cover( -90, -180, 90, 180, 1 ), ',' ),
+            '0,1,2,3' );
+-- coarse tiles are kept
+ifNotEqual( table.concat( quadkeys.cover( 1, 1, 80, 179, 1, 10 ) ), '1' );
+-- single point
+ifNotEqual( table.concat( quadkeys.cover( 35.673343, 139.710388, 35.673343,
+                                          139.710388, 100, 18 ) ),
+            quadkeys.encode( 35.673343, 139.710388, 18 ) );
+-- crosses the antimeridian
+local cells = quadkeys.cover( -10, 90, 10, -90, 64, 8 );
+ifTrue( covered( cells, 5, 45, 8 ), 'gap is covered' );
+ifFalse( covered( cells, 5, 170, 8 ), 'not covered' );
+ifFalse( covered( cells, 5, -170, 8 ), 'not covered' );
+
+-- invalid arguments
+ifTrue( pcall( quadkeys.cover, 10, 0, 0, 10, 8 ) );
+ifTrue( pcall( quadkeys.cover, 0, 0, 10, 10, 0 ) );
+ifTrue( pcall( quadkeys.cover, 0, 0, 10, 10, 8, 24 ) );
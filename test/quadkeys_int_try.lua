@@ -0,0 +1,85 @@
+local quadkeys = require('geo.quadkeys');
+local random = math.random;
+local root = quadkeys.key2int( '' );
+
+math.randomseed( 1 );
+
+-- root tile
+ifNotEqual( quadkeys.level( root ), 0 );
+ifNotEqual( quadkeys.int2key( root ), '' );
+ifNotNil( quadkeys.parent( root ) );
+
+for _ = 1, 2000 do
+    local lat = random() * 170 - 85;
+    local lon = random() * 360 - 180;
+    local lv = random( 1, 23 );
+    local key = quadkeys.encode( lat, lon, lv );
+    local code = quadkeys.encode_int( lat, lon, lv );
+    local tx, ty = quadkeys.decode2tile( key );
+    local x, y, l = quadkeys.int2tile( code );
+    local parent = quadkeys.parent( code );
+    local children = { quadkeys.children( code ) };
+
+    -- conversions
+    ifNotEqual( quadkeys.key2int( key ), code );
+    ifNotEqual( quadkeys.int2key( code ), key );
+    ifNotEqual( quadkeys.tile2int( tx, ty, lv ), code );
+    ifNotEqual( x, tx );
+    ifNotEqual( y, ty );
+    ifNotEqual( l, lv );
+    ifNotEqual( quadkeys.tile2key( x, y, l ), key );
+    ifNotEqual( quadkeys.level( code ), lv );
+
+    -- hierarchy
+    ifNotEqual( quadkeys.int2key( parent ), key:sub( 1, lv - 1 ) );
+    ifFalse( quadkeys.contains( parent, code ) );
+    ifTrue( quadkeys.contains( code, parent ) );
+    ifFalse( quadkeys.contains( root, code ) );
+    ifFalse( quadkeys.contains( code, code ) );
+    for l = 0, lv do
+        ifNotEqual( quadkeys.int2key( quadkeys.parent( code, l ) ),
+                    key:sub( 1, l ) );
+    end
+    if lv == 23 then
+        ifNotEqual( #children, 0 );
+    else
+        ifNotEqual( #children, 4 );
+        for i, child in ipairs( children ) do
+            ifNotEqual( quadkeys.int2key( child ), key .. ( i - 1 ) );
+            ifNotEqual( quadkeys.parent( child ), code );
+            ifFalse( quadkeys.contains( code, child ) );
+            -- children are sorted in the order of the quadkey strings
+            if i > 1 then
+                ifFalse( child > children[i - 1] );
+            end
+        end
+    end
+end
+
+-- the codes of the same level are sorted in the same order as the quadkey
+-- strings
+for lv = 1, 23 do
+    local keys = {};
+    local codes = {};
+
+    for i = 1, 100 do
+        keys[i] = quadkeys.encode( random() * 170 - 85, random() * 360 - 180,
+                                   lv );
+    end
+    table.sort( keys );
+    for i, key in ipairs( keys ) do
+        codes[i] = quadkeys.key2int( key );
+    end
+    table.sort( codes );
+    for i, code in ipairs( codes ) do
+        ifNotEqual( quadkeys.int2key( code ), keys[i] );
+    end
+end
+
+-- invalid
+ifNotNil( quadkeys.key2int( '0124' ) );
+ifTrue( pcall( quadkeys.level, 0 ) );
+ifTrue( pcall( quadkeys.level, 2 ) );
+ifTrue( pcall( quadkeys.int2key, 2 ^ 47 ) );
+ifTrue( pcall( quadkeys.tile2int, 2, 0, 1 ) );
+ifTrue( pcall( quadkeys.parent, quadkeys.key2int( '01' ), 3 ) );
@@ -0,0 +1,80 @@
+local helper = require('test.helper');
+local pack = helper.pack;
+local unpack = helper.unpack;
+local concat = table.concat;
+local quadkeys = require('geo.quadkeys');
+local random = math.random;
+local coords = {};
+local values = {};
+local points = {};
+local res;
+
+math.randomseed( 1 );
+for i = 1, 3000 do
+    -- clustered points to aggregate many points into the same tile
+    local lat = 35 + random() * random() * 10;
+    local lon = 139 + random() * random() * 10;
+
+    if i % 10 == 0 then
+        lat, lon = random() * 170 - 85, random() * 360 - 180;
+    end
+    coords[i] = pack( '=dd', lat, lon );
+    values[i] = pack( '=d', i );
+    points[i] = { lat, lon, i };
+end
+
+res = ifNil( quadkeys.pyramid( concat( coords ), 3, 18, concat( values ) ) );
+for lv = 1, 23 do
+    local lvres = res[lv];
+
+    if lv < 3 or lv > 18 then
+        ifNotNil( lvres );
+    else
+        local counts = {};
+        local sums = {};
+        local n = 0;
+        local prev;
+
+        for _, p in ipairs( points ) do
+            -- ancestor of the tile at the deepest level
+            local code = quadkeys.parent( quadkeys.encode_int( p[1], p[2], 18 ), lv );
+
+            counts[code] = ( counts[code] or 0 ) + 1;
+            sums[code] = ( sums[code] or 0 ) + p[3];
+        end
+
+        ifNotEqual( #lvres.codes, #lvres.counts );
+        ifNotEqual( #lvres.codes, #lvres.sums );
+        for i = 1, #lvres.codes, 8 do
+            local code = unpack( '=i8', lvres.codes, i );
+
+            ifNotEqual( quadkeys.level( code ), lv );
+            ifNotEqual( unpack( '=I8', lvres.counts, i ), counts[code] );
+            ifNotEqual( unpack( '=d', lvres.sums, i ), sums[code] );
+            -- sorted
+            ifTrue( prev and prev >= code );
+            prev = code;
+            n = n + 1;
+        end
+        for _ in pairs( counts ) do
+            n = n - 1;
+        end
+        ifNotEqual( n, 0 );
+    end
+end
+
+-- without values
+res = ifNil( quadkeys.pyramid( concat( coords ), 18, 18 ) );
+ifNil( res[18].counts );
+ifNotNil( res[18].sums );
+
+-- empty
+res = ifNil( quadkeys.pyramid( '', 1, 2, '' ) );
+ifNotEqual( res[1].codes, '' );
+ifNotEqual( res[2].sums, '' );
+
+-- invalid arguments
+ifTrue( pcall( quadkeys.pyramid, concat( coords ), 5, 4 ) );
+ifTrue( pcall( quadkeys.pyramid, concat( coords ), 0, 4 ) );
+ifTrue( pcall( quadkeys.pyramid, concat( coords ), 1, 24 ) );
+ifTrue( pcall( quadkeys.pyramid, concat( coords ), 1, 4, 'abc' ) );
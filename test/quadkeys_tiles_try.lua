@@ -0,0 +1,80 @@
+local quadkeys = require('geo.quadkeys');
+local random = math.random;
+
+-- returns the tiles of the bounding box by the brute force
+local function tiles( minlat, minlon, maxlat, maxlon, lv )
+    local x0, y0 = quadkeys.encode2tile( maxlat, minlon, lv );
+    local x1, y1 = quadkeys.encode2tile( minlat, maxlon, lv );
+    local res = {};
+
+    for y = y0, y1 do
+        if x0 <= x1 then
+            for x = x0, x1 do
+                res[#res + 1] = quadkeys.tile2int( x, y, lv );
+            end
+        else
+            -- crosses the antimeridian
+            for x = 0, x1 do
+                res[#res + 1] = quadkeys.tile2int( x, y, lv );
+            end
+            for x = x0, 2 ^ lv - 1 do
+                res[#res + 1] = quadkeys.tile2int( x, y, lv );
+            end
+        end
+    end
+    table.sort( res );
+
+    return res;
+end
+
+math.randomseed( 1 );
+for _ = 1, 300 do
+    local lv = random( 1, 23 );
+    local minlat = random() * 170 - 85;
+    local minlon = random() * 360 - 180;
+    local span = 360 / 2 ^ lv * random( 0, 20 ) * random();
+    local maxlat = math.min( minlat + span, 90 );
+    local maxlon = minlon + span;
+    local expect, n, prev;
+
+    if maxlon > 180 then
+        maxlon = maxlon - 360;
+    end
+    expect = tiles( minlat, minlon, maxlat, maxlon, lv );
+    n = 0;
+    for tx, ty, code in quadkeys.tiles_in_bbox( minlat, minlon, maxlat, maxlon, lv ) do
+        n = n + 1;
+        ifNotEqual( code, expect[n] );
+        ifNotEqual( quadkeys.tile2int( tx, ty, lv ), code );
+        -- Morton order
+        ifTrue( prev and prev >= code );
+        prev = code;
+    end
+    ifNotEqual( n, #expect );
+end
+
+-- crosses the antimeridian
+for lv = 1, 12 do
+    local expect = tiles( -10, 175, 12, -172, lv );
+    local n = 0;
+
+    for _, _, code in quadkeys.tiles_in_bbox( -10, 175, 12, -172, lv ) do
+        n = n + 1;
+        ifNotEqual( code, expect[n] );
+    end
+    ifNotEqual( n, #expect );
+end
+
+-- whole world
+do
+    local n = 0;
+
+    for _ in quadkeys.tiles_in_bbox( -90, -180, 90, 180, 8 ) do
+        n = n + 1;
+    end
+    ifNotEqual( n, 2 ^ 16 );
+end
+
+-- invalid arguments
+ifTrue( pcall( quadkeys.tiles_in_bbox, 10, 0, 0, 10, 5 ) );
+ifTrue( pcall( quadkeys.tiles_in_bbox, 0, 0, 10, 10, 24 ) );
@@ -0,0 +1,121 @@
+local geo = require('geo');
+local tracker = require('geo.tracker');
+local random = math.random;
+local pack = require('test.helper').pack;
+
+math.randomseed( 1 );
+
+local function distance( lat0, lon0, lat1, lon1 )
+    return geo.distance( lat0, lon0, lat1, lon1 );
+end
+
+local function brute( objs, lat, lon, radius )
+    local ids = {};
+
+    for id, o in pairs( objs ) do
+        if distance( lat, lon, o[1], o[2] ) <= radius then
+            ids[#ids + 1] = id;
+        end
+    end
+    table.sort( ids );
+    return table.concat( ids, ',' );
+end
+
+local function sorted( ids )
+    table.sort( ids );
+    return table.concat( ids, ',' );
+end
+
+-- moving objects
+do
+    local t = ifNil( tracker.new() );
+    local objs = {};
+    local n = 3000;
+
+    ifNotEqual( #t, 0 );
+    for id = 1, n do
+        local lat = 35.5 + random() * 0.4;
+        local lon = 139.5 + random() * 0.4;
+
+        ifNotEqual( t:update( id, lat, lon ), true );
+        objs[id] = { lat, lon };
+    end
+    ifNotEqual( #t, n );
+    ifFalse( t:ncell() > 1 and t:ncell() <= n );
+
+    -- small moves stay in the same cell
+    ifNotEqual( t:update( 1, objs[1][1], objs[1][2] ), false );
+    for step = 1, 5 do
+        for id, o in pairs( objs ) do
+            o[1] = o[1] + ( random() - 0.5 ) * 0.01;
+            o[2] = o[2] + ( random() - 0.5 ) * 0.01;
+            ifNil( t:update( id, o[1], o[2] ) );
+        end
+        -- remove some objects
+        for id = step, n, 50 do
+            if objs[id] then
+                ifNotEqual( t:remove( id ), true );
+                objs[id] = nil;
+            end
+        end
+    end
+    ifNotEqual( t:remove( 1 ), false );
+    ifNotEqual( t:get( 1 ), nil );
+    local lat, lon = t:get( 7 );
+    ifNotEqual( lat, objs[7][1] );
+    ifNotEqual( lon, objs[7][2] );
+
+    for _, q in ipairs( {
+        { 35.7, 139.7, 500 },
+        { 35.7, 139.7, 5000 },
+        { 35.6, 139.8, 20000 },
+        -- larger than the cells of the tracker
+        { 35.0, 139.0, 2000000 },
+        { -35.0, -139.0, 1000 },
+    } ) do
+        local ids, dists = t:within_radius( q[1], q[2], q[3] );
+
+        ifNotEqual( #ids, #dists );
+        for i, id in ipairs( ids ) do
+            ifFalse( dists[i] <= q[3] );
+            ifFalse( math.abs( dists[i] - distance( q[1], q[2], objs[id][1], objs[id][2] ) ) < 1e-6 );
+        end
+        ifNotEqual( sorted( ids ), brute( objs, q[1], q[2], q[3] ) );
+    end
+end
+
+-- batch update
+do
+    local t = ifNil( tracker.new( 8 ) );
+    local buf = geo.buffer( 200, true );
+
+    for id = 1, 200 do
+        buf:push( 10 + id * 0.001, 20, id * 10 );
+    end
+    ifNotEqual( t:update_batch( buf ), 200 );
+    ifNotEqual( #t, 200 );
+    ifNotEqual( t:get( 1000 ), 10.1 );
+    -- same positions stay in the same cells
+    ifNotEqual( t:update_batch( buf ), 0 );
+
+    -- the identifiers of the table
+    local ids = {};
+    for i = 1, 200 do
+        ids[i] = 10000 + i;
+    end
+    ifNotEqual( t:update_batch( buf, ids ), 200 );
+    ifNotEqual( #t, 400 );
+
+    -- invalid coordinate
+    local n, err, pos = t:update_batch( pack( '=dddd', 1, 1, 91, 1 ), { 1, 2 } );
+    ifNotNil( n );
+    ifNil( err );
+    ifNotEqual( pos, 2 );
+    ifNotEqual( t:get( 1 ), 1 );
+end
+
+-- invalid arguments
+ifTrue( pcall( tracker.new, 0 ) );
+ifTrue( pcall( tracker.new, 13 ) );
+ifTrue( pcall( tracker.new().update_batch, tracker.new(), pack( '=dd', 1, 1 ) ) );
+ifTrue( pcall( tracker.new().update, tracker.new(), 1, 91, 0 ) );